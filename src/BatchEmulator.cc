@@ -0,0 +1,701 @@
+// System headers
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// User headers
+#include "BatchEmulator.hh"
+#include "Emulator.hh"
+#include "Timings.hh"
+
+namespace {
+
+// Register file rows, see BatchEmulator::RegisterFile
+constexpr unsigned ROW_B = 0;
+constexpr unsigned ROW_D = 2;
+constexpr unsigned ROW_H = 4;
+constexpr unsigned ROW_L = 5;
+constexpr unsigned ROW_F = 6;
+constexpr unsigned ROW_A = 7;
+constexpr unsigned ROW_SP = 8;
+
+// Operand that is the byte after the opcode instead of a register
+constexpr byte_t IMMEDIATE = 0xFF;
+
+/**
+ *  What an instruction that can run in lockstep does. Each kind mirrors the
+ *  InstructionDecoder helper or handler used for its opcodes, including
+ *  which flags it leaves alone.
+ */
+enum class LockstepKind : uint8_t {
+    None,  // Runs on the InstructionDecoder only
+    Nop,
+    Copy,          // LD r, r' and LD r, d8
+    LoadPair,      // LD rr, d16
+    Increment,     // INC r without flags
+    Decrement,     // DEC r without flags
+    IncrementZNH,  // incrementRegister()
+    DecrementZNH,  // decrementRegister()
+    IncrementPair,
+    DecrementPair,
+    AddToHL,  // ADD HL, rr without flags
+    Rlca,
+    Rrca,
+    Rla,
+    Rra,
+    Cpl,
+    Scf,
+    Ccf,
+    Add,     // addRegisters()
+    AddRaw,  // ADD A, d8 without flags
+    Adc,
+    Sub,
+    Sbc,
+    And,
+    Xor,
+    Or,
+    Cp,
+    Jr,
+    Jp,
+    JpHL,
+    LoadSPFromHL,
+    LoadHLFromSP,
+};
+
+struct LockstepOp {
+    LockstepKind kind { LockstepKind::None };
+
+    // Register file rows; the high row of a pair
+    byte_t target { 0 };
+    byte_t source { 0 };
+
+    // Bytes including the opcode
+    byte_t length { 1 };
+
+    // Jumps are only taken when (F & condition_mask) == condition_value
+    byte_t condition_mask { 0 };
+    byte_t condition_value { 0 };
+};
+
+std::array<LockstepOp, NUMBER_OF_INSTRUCTIONS> makeLockstepOps() {
+    std::array<LockstepOp, NUMBER_OF_INSTRUCTIONS> ops {};
+
+    auto set = [&ops](opcode_t opcode, LockstepKind kind, byte_t target = 0,
+                      byte_t source = 0, byte_t length = 1) {
+        ops[opcode] = { kind, target, source, length, 0, 0 };
+    };
+
+    set(0x00, LockstepKind::Nop);
+
+    // LD r, r' for every pair of registers
+    for (unsigned opcode = 0x40; opcode < 0x80; ++opcode) {
+        unsigned target = (opcode >> 3) & 7, source = opcode & 7;
+        if (target == ROW_F || source == ROW_F) continue;
+        set(opcode, LockstepKind::Copy, target, source);
+    }
+
+    for (unsigned row = 0; row < 8; ++row) {
+        if (row == ROW_F) continue;
+        opcode_t column = row << 3;
+
+        set(column | 0x06, LockstepKind::Copy, row, IMMEDIATE, 2);
+        set(column | 0x04, LockstepKind::Increment, row);
+        set(column | 0x05, LockstepKind::Decrement, row);
+    }
+    set(0x04, LockstepKind::IncrementZNH, ROW_B);
+    set(0x05, LockstepKind::DecrementZNH, ROW_B);
+
+    const byte_t pairs[] = { ROW_B, ROW_D, ROW_H, ROW_SP };
+    for (unsigned i = 0; i < 4; ++i) {
+        opcode_t column = i << 4;
+        set(column | 0x01, LockstepKind::LoadPair, pairs[i], 0, 3);
+        set(column | 0x03, LockstepKind::IncrementPair, pairs[i]);
+        set(column | 0x09, LockstepKind::AddToHL, ROW_H, pairs[i]);
+        set(column | 0x0B, LockstepKind::DecrementPair, pairs[i]);
+    }
+
+    set(0x07, LockstepKind::Rlca);
+    set(0x0F, LockstepKind::Rrca);
+    set(0x17, LockstepKind::Rla);
+    set(0x1F, LockstepKind::Rra);
+    set(0x2F, LockstepKind::Cpl);
+    set(0x37, LockstepKind::Scf);
+    set(0x3F, LockstepKind::Ccf);
+
+    // ALU operations on A, with a register and with d8
+    const LockstepKind alu[] = { LockstepKind::Add, LockstepKind::Adc,
+                                 LockstepKind::Sub, LockstepKind::Sbc,
+                                 LockstepKind::And, LockstepKind::Xor,
+                                 LockstepKind::Or,  LockstepKind::Cp };
+    for (unsigned i = 0; i < 8; ++i) {
+        for (unsigned source = 0; source < 8; ++source) {
+            if (source == ROW_F) continue;
+            set(0x80 | i << 3 | source, alu[i], ROW_A, source);
+        }
+        set(0xC6 | i << 3, alu[i], ROW_A, IMMEDIATE, 2);
+    }
+    set(0xC6, LockstepKind::AddRaw, ROW_A, IMMEDIATE, 2);
+
+    // AND A and OR A are no-ops in the handlers
+    set(0xA7, LockstepKind::Nop);
+    set(0xB7, LockstepKind::Nop);
+
+    set(0x18, LockstepKind::Jr, 0, 0, 2);
+    set(0x20, LockstepKind::Jr, 0, 0, 2);
+    ops[0x20].condition_mask = bit_z;
+
+    set(0xC3, LockstepKind::Jp, 0, 0, 3);
+    const opcode_t conditional_jumps[] = { 0xC2, 0xCA, 0xD2, 0xDA };
+    for (opcode_t opcode : conditional_jumps) {
+        set(opcode, LockstepKind::Jp, 0, 0, 3);
+        ops[opcode].condition_mask = (opcode & 0x10) ? bit_c : bit_z;
+        ops[opcode].condition_value =
+            (opcode & 0x08) ? ops[opcode].condition_mask : 0;
+    }
+
+    set(0xE9, LockstepKind::JpHL);
+    set(0xF9, LockstepKind::LoadSPFromHL);
+    set(0xF8, LockstepKind::LoadHLFromSP, 0, 0, 2);
+
+    return ops;
+}
+
+const std::array<LockstepOp, NUMBER_OF_INSTRUCTIONS> LOCKSTEP_OPS =
+    makeLockstepOps();
+
+// One byte per lane. Masks have 0xFF in the selected lanes.
+
+#ifdef __SSE2__
+
+struct Lanes {
+    __m128i v;
+};
+
+Lanes load(const byte_t *row) {
+    return { _mm_load_si128(reinterpret_cast<const __m128i *>(row)) };
+}
+
+void store(byte_t *row, Lanes x) {
+    _mm_store_si128(reinterpret_cast<__m128i *>(row), x.v);
+}
+
+Lanes splat(byte_t value) { return { _mm_set1_epi8((char)value) }; }
+
+Lanes operator+(Lanes a, Lanes b) { return { _mm_add_epi8(a.v, b.v) }; }
+Lanes operator-(Lanes a, Lanes b) { return { _mm_sub_epi8(a.v, b.v) }; }
+Lanes operator&(Lanes a, Lanes b) { return { _mm_and_si128(a.v, b.v) }; }
+Lanes operator|(Lanes a, Lanes b) { return { _mm_or_si128(a.v, b.v) }; }
+Lanes operator^(Lanes a, Lanes b) { return { _mm_xor_si128(a.v, b.v) }; }
+
+Lanes equal(Lanes a, Lanes b) { return { _mm_cmpeq_epi8(a.v, b.v) }; }
+
+/**
+ *  Mask of the lanes where a + b carries out of the byte.
+ */
+Lanes carries(Lanes a, Lanes b) {
+    return equal(Lanes { _mm_adds_epu8(a.v, b.v) }, a + b) ^ splat(0xFF);
+}
+
+/**
+ *  Mask of the lanes where a < b, unsigned.
+ */
+Lanes below(Lanes a, Lanes b) {
+    return equal(Lanes { _mm_max_epu8(a.v, b.v) }, a) ^ splat(0xFF);
+}
+
+Lanes shiftRight(Lanes a) {
+    return Lanes { _mm_srli_epi16(a.v, 1) } & splat(0x7F);
+}
+
+uint32_t bits(Lanes mask) { return _mm_movemask_epi8(mask.v); }
+
+#else
+
+struct Lanes {
+    alignas(16) std::array<byte_t, BatchEmulator::MAX_LANES> v;
+};
+
+template <typename Function>
+Lanes each(Function function) {
+    Lanes result {};
+    for (unsigned i = 0; i < BatchEmulator::MAX_LANES; ++i) {
+        result.v[i] = function(i);
+    }
+    return result;
+}
+
+Lanes load(const byte_t *row) {
+    return each([row](unsigned i) { return row[i]; });
+}
+
+void store(byte_t *row, Lanes x) {
+    std::copy(x.v.begin(), x.v.end(), row);
+}
+
+Lanes splat(byte_t value) {
+    return each([value](unsigned) { return value; });
+}
+
+Lanes operator+(Lanes a, Lanes b) {
+    return each([&](unsigned i) { return (byte_t)(a.v[i] + b.v[i]); });
+}
+Lanes operator-(Lanes a, Lanes b) {
+    return each([&](unsigned i) { return (byte_t)(a.v[i] - b.v[i]); });
+}
+Lanes operator&(Lanes a, Lanes b) {
+    return each([&](unsigned i) { return (byte_t)(a.v[i] & b.v[i]); });
+}
+Lanes operator|(Lanes a, Lanes b) {
+    return each([&](unsigned i) { return (byte_t)(a.v[i] | b.v[i]); });
+}
+Lanes operator^(Lanes a, Lanes b) {
+    return each([&](unsigned i) { return (byte_t)(a.v[i] ^ b.v[i]); });
+}
+
+Lanes equal(Lanes a, Lanes b) {
+    return each([&](unsigned i) { return a.v[i] == b.v[i] ? 0xFF : 0; });
+}
+
+Lanes carries(Lanes a, Lanes b) {
+    return each([&](unsigned i) { return a.v[i] + b.v[i] > 0xFF ? 0xFF : 0; });
+}
+
+Lanes below(Lanes a, Lanes b) {
+    return each([&](unsigned i) { return a.v[i] < b.v[i] ? 0xFF : 0; });
+}
+
+Lanes shiftRight(Lanes a) {
+    return each([&](unsigned i) { return (byte_t)(a.v[i] >> 1); });
+}
+
+uint32_t bits(Lanes mask) {
+    uint32_t result = 0;
+    for (unsigned i = 0; i < BatchEmulator::MAX_LANES; ++i) {
+        if (mask.v[i]) result |= 1u << i;
+    }
+    return result;
+}
+
+#endif
+
+Lanes laneMask(uint32_t lanes) {
+    alignas(16) byte_t mask[BatchEmulator::MAX_LANES];
+    for (unsigned i = 0; i < BatchEmulator::MAX_LANES; ++i) {
+        mask[i] = (lanes >> i & 1) ? 0xFF : 0;
+    }
+    return load(mask);
+}
+
+/**
+ *  Mask of the lanes where (x & flag) is set.
+ */
+Lanes flagSet(Lanes x, byte_t flag) {
+    return equal(x & splat(flag), splat(flag));
+}
+
+/**
+ *  flag in the lanes of mask, 0 elsewhere.
+ */
+Lanes flagIf(Lanes mask, byte_t flag) { return mask & splat(flag); }
+
+}  // namespace
+
+BatchEmulator::BatchEmulator(Emulator &prototype, unsigned count) {
+    if (count == 0 || count > MAX_LANES) {
+        throw std::runtime_error("A batch has 1 to " +
+                                 std::to_string(MAX_LANES) + " lanes");
+    }
+
+    for (unsigned i = 0; i < count; ++i) lanes.push_back(prototype.clone());
+}
+
+void BatchEmulator::runFrame(const byte_t *buttons) {
+    active = 0;
+    for (unsigned i = 0; i < lanes.size(); ++i) {
+        Emulator &lane = *lanes[i];
+        Processor &cpu = *lane.processor;
+
+        lane.setButtons(buttons[i]);
+        cpu.joypad->setButtons(buttons[i]);
+        cpu.ppu->setOutputWanted(output_wanted);
+
+        start_frame[i] = cpu.ppu->getFrameCount();
+        end_cycle[i] = cpu.clock_cycles + LCD::DOTS_PER_FRAME;
+        clock[i] = cpu.clock_cycles;
+        registers.PC[i] = cpu.PC->getValue();
+        updateLimit(i);
+
+        active |= 1u << i;
+    }
+
+    try {
+        while (active) {
+            unsigned leader = lowestLane();
+            uint32_t group = lanesAt(registers.PC[leader]);
+            if (group != 1u << leader) {
+                if (stepLockstep(leader, group)) continue;
+
+                // Step the lanes one by one, they stay together
+                for (; group; group &= group - 1) {
+                    stepScalar(__builtin_ctz(group));
+                }
+                continue;
+            }
+
+            // Run the lane on its own until it gets to where another one is
+            register16_t others = PC_MAX;
+            for (uint32_t rest = active & ~(1u << leader); rest;
+                 rest &= rest - 1) {
+                others = std::min(others, registers.PC[__builtin_ctz(rest)]);
+            }
+
+            do {
+                if (stepScalar(leader)) break;
+            } while (registers.PC[leader] < others);
+        }
+    } catch (...) {
+        // Lanes that fail stay in the state the decoder left them in
+        for (unsigned i = 0; i < lanes.size(); ++i) {
+            if (in_registers >> i & 1) storeLane(i);
+        }
+        throw;
+    }
+}
+
+unsigned BatchEmulator::lockstepLength(opcode_t opcode) {
+    const LockstepOp &op = LOCKSTEP_OPS[opcode];
+    return op.kind == LockstepKind::None ? 0 : op.length;
+}
+
+uint32_t BatchEmulator::lanesAt(register16_t pc) const {
+    const register16_t *pcs = registers.PC.data();
+
+#if defined(__AVX2__)
+    __m256i equal = _mm256_cmpeq_epi16(
+        _mm256_load_si256(reinterpret_cast<const __m256i *>(pcs)),
+        _mm256_set1_epi16((short)pc));
+    __m128i packed = _mm_packs_epi16(_mm256_castsi256_si128(equal),
+                                     _mm256_extracti128_si256(equal, 1));
+    return _mm_movemask_epi8(packed) & active;
+#elif defined(__SSE2__)
+    __m128i value = _mm_set1_epi16((short)pc);
+    __m128i low = _mm_cmpeq_epi16(
+        _mm_load_si128(reinterpret_cast<const __m128i *>(pcs)), value);
+    __m128i high = _mm_cmpeq_epi16(
+        _mm_load_si128(reinterpret_cast<const __m128i *>(pcs + 8)), value);
+    return _mm_movemask_epi8(_mm_packs_epi16(low, high)) & active;
+#else
+    uint32_t lanes_at_pc = 0;
+    for (unsigned i = 0; i < MAX_LANES; ++i) {
+        if (pcs[i] == pc) lanes_at_pc |= 1u << i;
+    }
+    return lanes_at_pc & active;
+#endif
+}
+
+unsigned BatchEmulator::lowestLane() const {
+    unsigned lowest = __builtin_ctz(active);
+    for (uint32_t rest = active & (active - 1); rest; rest &= rest - 1) {
+        unsigned i = __builtin_ctz(rest);
+        if (registers.PC[i] < registers.PC[lowest]) lowest = i;
+    }
+    return lowest;
+}
+
+bool BatchEmulator::stepLockstep(unsigned leader, uint32_t group) {
+    register16_t pc = registers.PC[leader];
+
+    // Code in IO, OAM and high RAM is left to the decoder, operands too
+    if (pc >= 0xFE00 - 2) return false;
+
+    const Memory &memory = *lanes[leader]->processor->program_memory;
+    opcode_t opcode = memory.peek(pc);
+    const LockstepOp &op = LOCKSTEP_OPS[opcode];
+    if (op.kind == LockstepKind::None) return false;
+
+    byte_t low = memory.peek(pc + 1), high = memory.peek(pc + 2);
+    unsigned cycles = Timings::opcode_machine_cycles[opcode] * 4;
+
+    // Leave out lanes with other code at this PC, and lanes that would
+    // reach a scheduler event or the end of the frame
+    for (uint32_t rest = group; rest; rest &= rest - 1) {
+        unsigned i = __builtin_ctz(rest);
+        const Memory &lane_memory = *lanes[i]->processor->program_memory;
+
+        bool same = lane_memory.peek(pc) == opcode &&
+                    (op.length < 2 || lane_memory.peek(pc + 1) == low) &&
+                    (op.length < 3 || lane_memory.peek(pc + 2) == high);
+        if (!same || clock[i] + cycles >= limit[i]) group &= ~(1u << i);
+    }
+    if (!(group & 1u << leader) || !(group & (group - 1))) return false;
+
+    for (uint32_t rest = group & ~in_registers; rest; rest &= rest - 1) {
+        loadLane(__builtin_ctz(rest));
+    }
+
+    auto &rows = registers.rows;
+    Lanes mask = laneMask(group);
+    auto row = [&rows](unsigned index) { return load(rows[index].data()); };
+    Lanes kept = mask ^ splat(0xFF);
+    auto write = [&](unsigned index, Lanes value) {
+        store(rows[index].data(), (value & mask) | (row(index) & kept));
+    };
+
+    Lanes a = row(ROW_A), f = row(ROW_F);
+    Lanes operand = op.source == IMMEDIATE ? splat(low) : row(op.source);
+    Lanes zero = splat(0), carry_in = flagSet(f, bit_c);
+    const byte_t znhc = bit_z | bit_n | bit_h | bit_c;
+
+    register16_t next = pc + op.length;
+    register16_t target = next;
+    Lanes taken = splat(0xFF);
+
+    switch (op.kind) {
+        case LockstepKind::None:
+        case LockstepKind::Nop:
+            break;
+        case LockstepKind::Copy:
+            write(op.target, operand);
+            break;
+        case LockstepKind::LoadPair:
+            write(op.target, splat(high));
+            write(op.target + 1, splat(low));
+            break;
+        case LockstepKind::Increment:
+            write(op.target, row(op.target) + splat(1));
+            break;
+        case LockstepKind::Decrement:
+            write(op.target, row(op.target) - splat(1));
+            break;
+        case LockstepKind::IncrementZNH:
+        case LockstepKind::DecrementZNH: {
+            bool increment = op.kind == LockstepKind::IncrementZNH;
+            Lanes result = increment ? row(op.target) + splat(1)
+                                     : row(op.target) - splat(1);
+            write(op.target, result);
+
+            // H follows bit 4 of the result, C is left alone
+            Lanes flags = (f & splat(~(bit_z | bit_n | bit_h) & 0xFF)) |
+                          flagIf(equal(result, zero), bit_z) |
+                          flagIf(flagSet(result, 0x10), bit_h);
+            write(ROW_F, increment ? flags : flags | splat(bit_n));
+            break;
+        }
+        case LockstepKind::IncrementPair: {
+            Lanes result = row(op.target + 1) + splat(1);
+            write(op.target + 1, result);
+            write(op.target, row(op.target) - equal(result, zero));
+            break;
+        }
+        case LockstepKind::DecrementPair: {
+            Lanes borrow = equal(row(op.target + 1), zero);
+            write(op.target + 1, row(op.target + 1) - splat(1));
+            write(op.target, row(op.target) + borrow);
+            break;
+        }
+        case LockstepKind::AddToHL: {
+            Lanes h = row(ROW_H), l = row(ROW_L);
+            Lanes source_high = row(op.source), source_low = row(op.source + 1);
+            write(ROW_L, l + source_low);
+            write(ROW_H, h + source_high - carries(l, source_low));
+            break;
+        }
+        case LockstepKind::Rlca:
+        case LockstepKind::Rla:
+        case LockstepKind::Rrca:
+        case LockstepKind::Rra: {
+            bool left = op.kind == LockstepKind::Rlca ||
+                        op.kind == LockstepKind::Rla;
+            bool through_carry = op.kind == LockstepKind::Rla ||
+                                 op.kind == LockstepKind::Rra;
+
+            Lanes out = left ? flagSet(a, 0x80) : flagSet(a, 0x01);
+            Lanes in = through_carry ? carry_in : out;
+            Lanes result = left ? (a + a) | (in & splat(0x01))
+                                : shiftRight(a) | (in & splat(0x80));
+            write(ROW_A, result);
+            write(ROW_F, (f & splat(~znhc & 0xFF)) |
+                             flagIf(equal(result, zero), bit_z) |
+                             flagIf(out, bit_c));
+            break;
+        }
+        case LockstepKind::Cpl:
+            write(ROW_A, a ^ splat(0xFF));
+            write(ROW_F, f | splat(bit_n | bit_h));
+            break;
+        case LockstepKind::Scf:
+            write(ROW_F, (f & splat(~(bit_n | bit_h) & 0xFF)) | splat(bit_c));
+            break;
+        case LockstepKind::Ccf:
+            write(ROW_F, (f ^ splat(bit_c)) & splat(~(bit_n | bit_h) & 0xFF));
+            break;
+        case LockstepKind::Add: {
+            Lanes result = a + operand;
+            write(ROW_A, result);
+            write(ROW_F, (f & splat(~znhc & 0xFF)) |
+                             flagIf(equal(result, zero), bit_z) |
+                             flagIf(carries(a, operand), bit_c) |
+                             flagIf(flagSet(result, 0x10), bit_h));
+            break;
+        }
+        case LockstepKind::AddRaw:
+            write(ROW_A, a + operand);
+            break;
+        case LockstepKind::Adc: {
+            // Only ever sets C
+            Lanes sum = a + operand;
+            Lanes carry_out = carries(a, operand) |
+                              (carry_in & equal(sum, splat(0xFF)));
+            write(ROW_A, sum - carry_in);
+            write(ROW_F, f | flagIf(carry_out, bit_c));
+            break;
+        }
+        case LockstepKind::Sub:
+            write(ROW_A, a - operand);
+            write(ROW_F, f | splat(bit_n));
+            break;
+        case LockstepKind::Sbc:
+            write(ROW_A, a - operand + carry_in);
+            write(ROW_F, f | splat(bit_n));
+            break;
+        case LockstepKind::And:
+            write(ROW_A, a & operand);
+            break;
+        case LockstepKind::Xor:
+            write(ROW_A, a ^ operand);
+            break;
+        case LockstepKind::Or:
+            write(ROW_A, a | operand);
+            break;
+        case LockstepKind::Cp:
+            write(ROW_F, (f & splat(~(bit_z | bit_n | bit_c) & 0xFF)) |
+                             flagIf(equal(a, operand), bit_z) |
+                             splat(bit_n) |
+                             flagIf(below(a, operand), bit_c));
+            break;
+        case LockstepKind::Jr:
+            // The decoder adds the offset to the address of the offset
+            target = pc + 1 + (int8_t)low;
+            break;
+        case LockstepKind::Jp:
+            target = low | high << 8;
+            break;
+        case LockstepKind::JpHL:
+            for (uint32_t rest = group; rest; rest &= rest - 1) {
+                unsigned i = __builtin_ctz(rest);
+                registers.PC[i] = rows[ROW_H][i] << 8 | rows[ROW_L][i];
+            }
+            break;
+        case LockstepKind::LoadSPFromHL:
+            write(ROW_SP, row(ROW_H));
+            write(ROW_SP + 1, row(ROW_L));
+            break;
+        case LockstepKind::LoadHLFromSP: {
+            Lanes sp_high = row(ROW_SP), sp_low = row(ROW_SP + 1);
+            Lanes sign = splat((low & 0x80) ? 0xFF : 0);
+            write(ROW_L, sp_low + splat(low));
+            write(ROW_H, sp_high + sign - carries(sp_low, splat(low)));
+            break;
+        }
+    }
+
+    if (op.condition_mask) {
+        taken = equal(f & splat(op.condition_mask), splat(op.condition_value));
+    }
+
+    uint32_t jumped = bits(taken);
+    for (uint32_t rest = group; rest; rest &= rest - 1) {
+        unsigned i = __builtin_ctz(rest);
+        if (op.kind != LockstepKind::JpHL) {
+            registers.PC[i] = (jumped >> i & 1) ? target : next;
+        }
+        clock[i] += cycles;
+        ++steps[i];
+    }
+
+    ++stats.lockstep_steps;
+    stats.lockstep_lanes += __builtin_popcount(group);
+    return true;
+}
+
+bool BatchEmulator::stepScalar(unsigned i) {
+    if (in_registers >> i & 1) storeLane(i);
+
+    Emulator &lane = *lanes[i];
+    Processor &cpu = *lane.processor;
+    lane.instruction_decoder->step();
+    ++stats.scalar_steps;
+
+    clock[i] = cpu.clock_cycles;
+    registers.PC[i] = cpu.PC->getValue();
+
+    if (cpu.ppu->getFrameCount() != start_frame[i] ||
+        (!cpu.ppu->lcdEnabled() && cpu.clock_cycles >= end_cycle[i])) {
+        active &= ~(1u << i);
+        return true;
+    }
+
+    updateLimit(i);
+    return false;
+}
+
+void BatchEmulator::updateLimit(unsigned i) {
+    Processor &cpu = *lanes[i]->processor;
+
+    // These all need the decoder's checks around the next instruction
+    if (cpu.halted || cpu.interrupt_enable_pending ||
+        (cpu.interrupts_enabled && cpu.pendingInterrupts())) {
+        limit[i] = 0;
+        return;
+    }
+
+    limit[i] = cpu.scheduler.nextEventCycle();
+    if (!cpu.ppu->lcdEnabled()) limit[i] = std::min(limit[i], end_cycle[i]);
+}
+
+void BatchEmulator::loadLane(unsigned i) {
+    const Processor &cpu = *lanes[i]->processor;
+    auto &rows = registers.rows;
+
+    const ptr<Register8bit> *eight_bit[] = { &cpu.B, &cpu.C, &cpu.D, &cpu.E,
+                                             &cpu.H, &cpu.L, &cpu.F, &cpu.A };
+    for (unsigned row = 0; row < 8; ++row) {
+        rows[row][i] = (*eight_bit[row])->getValue();
+    }
+
+    register16_t sp = cpu.SP->getValue();
+    rows[ROW_SP][i] = sp >> 8;
+    rows[ROW_SP + 1][i] = sp & 0xFF;
+
+    steps[i] = 0;
+    in_registers |= 1u << i;
+}
+
+void BatchEmulator::storeLane(unsigned i) {
+    Processor &cpu = *lanes[i]->processor;
+    const auto &rows = registers.rows;
+
+    const ptr<Register8bit> *eight_bit[] = { &cpu.B, &cpu.C, &cpu.D, &cpu.E,
+                                             &cpu.H, &cpu.L, &cpu.F, &cpu.A };
+    for (unsigned row = 0; row < 8; ++row) {
+        (*eight_bit[row])->setValue(rows[row][i]);
+    }
+
+    cpu.SP->setValue(rows[ROW_SP][i] << 8 | rows[ROW_SP + 1][i]);
+    cpu.PC->setValue(registers.PC[i]);
+
+    uint64_t elapsed = clock[i] - cpu.clock_cycles;
+    cpu.clock_cycles = clock[i];
+    cpu.machine_cycles += elapsed / 4;
+    cpu.executed_instructions += steps[i];
+
+    steps[i] = 0;
+    in_registers &= ~(1u << i);
+}
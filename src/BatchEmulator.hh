@@ -0,0 +1,155 @@
+#pragma once
+
+// System headers
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// User headers
+#include "Constants.hh"
+
+class Emulator;
+
+/**
+ *  Runs up to MAX_LANES instances of the same game side by side, one frame
+ *  at a time, for searches and training that step many of them at once.
+ *
+ *  The register files of all lanes are kept in structure-of-arrays form, a
+ *  row of one byte per lane for every register. While lanes are at the same
+ *  PC and the instruction there only works on registers (loads between
+ *  registers, ALU operations, jumps, ...), it is executed once for all of
+ *  them with SIMD operations on the rows, with the same semantics as the
+ *  InstructionDecoder handlers. Anything else, such as memory accesses,
+ *  scheduler events and interrupts, falls back to stepping each lane with
+ *  its own InstructionDecoder, so lanes that diverge simply run one by one
+ *  until they meet again.
+ *
+ *  Lanes run like Emulator::runFrame() without frame skipping; debugging,
+ *  profiling, rewind, run-ahead and movies of the lane emulators are not
+ *  used by runFrame().
+ */
+class BatchEmulator {
+   public:
+    static constexpr unsigned MAX_LANES = 16;
+
+    /**
+     *  Numbers of steps taken, to see how much of a workload runs in
+     *  lockstep.
+     */
+    struct Stats {
+        // Instructions run for a group of lanes at once, and the lane
+        // instructions that covers
+        uint64_t lockstep_steps { 0 };
+        uint64_t lockstep_lanes { 0 };
+
+        // Instructions run for a single lane
+        uint64_t scalar_steps { 0 };
+    };
+
+    /**
+     *  Creates lanes clones of prototype (see Emulator::clone()), which
+     *  must be idle meanwhile. Throws std::runtime_error unless there are 1
+     *  to MAX_LANES lanes.
+     */
+    BatchEmulator(Emulator &prototype, unsigned lanes);
+
+    // Weffc++
+    BatchEmulator(const BatchEmulator &) = delete;
+    void operator=(const BatchEmulator &) = delete;
+
+    unsigned size() const { return lanes.size(); }
+
+    /**
+     *  Whether the lanes render the frames they run. Off for workloads that
+     *  only look at memory.
+     */
+    void setOutputWanted(bool wanted) { output_wanted = wanted; }
+
+    /**
+     *  Runs one frame on every lane, with buttons[i] (Buttons bits) held on
+     *  lane i. Only call while none of the lanes runs elsewhere.
+     */
+    void runFrame(const byte_t *buttons);
+
+    const Stats &getStats() const { return stats; }
+
+    /**
+     *  Bytes of the instruction if opcode runs in lockstep, 0 if it is left
+     *  to the decoder. Lets tests check every lockstep kernel against the
+     *  InstructionDecoder handler it mirrors.
+     */
+    static unsigned lockstepLength(opcode_t opcode);
+
+    std::vector<ptr<Emulator>> lanes {};
+
+   private:
+    // Rows of the register file, in the operand order of the opcodes, with
+    // F in place of (HL), followed by the two halves of SP
+    static constexpr unsigned ROWS = 10;
+
+    struct alignas(32) RegisterFile {
+        std::array<std::array<byte_t, MAX_LANES>, ROWS> rows;
+        std::array<register16_t, MAX_LANES> PC;
+    };
+
+    RegisterFile registers {};
+
+    // Clock cycles of every lane, ahead of the processor's while its
+    // registers are in the register file
+    std::array<uint64_t, MAX_LANES> clock {};
+
+    // Lanes may run in lockstep while this stays above their clock: the
+    // next scheduler event or the end of the frame. 0 while a lane can't,
+    // e.g. while halted or with an interrupt about to be dispatched.
+    std::array<uint64_t, MAX_LANES> limit {};
+
+    // Instructions run in lockstep since the lane's registers were loaded
+    std::array<uint32_t, MAX_LANES> steps {};
+
+    // Frame count at the start of the frame, and when a frame with the LCD
+    // off ends
+    std::array<uint64_t, MAX_LANES> start_frame {};
+    std::array<uint64_t, MAX_LANES> end_cycle {};
+
+    // Bits of the lanes still running the frame, and of the lanes whose
+    // registers currently live in the register file
+    uint32_t active { 0 };
+    uint32_t in_registers { 0 };
+
+    bool output_wanted { true };
+
+    Stats stats {};
+
+    /**
+     *  Bits of the active lanes at pc.
+     */
+    uint32_t lanesAt(register16_t pc) const;
+
+    /**
+     *  The active lane with the lowest PC. Running it first lets lanes that
+     *  took different branches meet again where the branches join.
+     */
+    unsigned lowestLane() const;
+
+    /**
+     *  Runs the instruction at the PC of leader for it and the lanes in
+     *  group, which are at the same PC, if it can be run in lockstep. Lanes
+     *  that can't take part are left out of the step. Returns false if
+     *  nothing was run.
+     */
+    bool stepLockstep(unsigned leader, uint32_t group);
+
+    /**
+     *  Steps lane with its InstructionDecoder. Returns true if that ended
+     *  its frame.
+     */
+    bool stepScalar(unsigned lane);
+
+    void updateLimit(unsigned lane);
+
+    /**
+     *  Moves the registers of lane into and out of the register file.
+     */
+    void loadLane(unsigned lane);
+    void storeLane(unsigned lane);
+};
@@ -0,0 +1,320 @@
+// System headers
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+
+// User headers
+#include "BreakCondition.hh"
+#include "Processor.hh"
+
+namespace {
+
+const char *const REGISTER8_NAMES[] = { "A", "B", "C", "D",
+                                        "E", "F", "H", "L" };
+const char *const REGISTER16_NAMES[] = { "AF", "BC", "DE", "HL", "SP", "PC" };
+const char *const FLAG_NAMES[] = { "FZ", "FN", "FH", "FC" };
+const byte_t FLAG_BITS[] = { bit_z, bit_n, bit_h, bit_c };
+
+}  // namespace
+
+BreakCondition::BreakCondition(const std::string &expression)
+    : expression { expression } {
+    parseOr();
+
+    skipSpace();
+    if (position != expression.size()) fail("unexpected input");
+    if (max_depth > MAX_STACK_DEPTH) fail("expression is too deep");
+}
+
+bool BreakCondition::evaluate(const Processor &processor) const {
+    // Depth was checked when compiling, so the stack can't overflow
+    std::array<int64_t, MAX_STACK_DEPTH> stack;
+    size_t top = 0;
+
+    for (const Instruction &instruction : code) {
+        switch (instruction.op) {
+            case Op::Constant:
+                stack[top++] = instruction.operand;
+                break;
+            case Op::Register8: {
+                const Register8bit *registers[] = {
+                    processor.A.get(), processor.B.get(), processor.C.get(),
+                    processor.D.get(), processor.E.get(), processor.F.get(),
+                    processor.H.get(), processor.L.get()
+                };
+                stack[top++] = registers[instruction.operand]->getValue();
+                break;
+            }
+            case Op::Register16: {
+                const Register16bit *registers[] = {
+                    processor.AF.get(), processor.BC.get(), processor.DE.get(),
+                    processor.HL.get(), processor.SP.get(), processor.PC.get()
+                };
+                stack[top++] = registers[instruction.operand]->getValue();
+                break;
+            }
+            case Op::Flag:
+                stack[top++] =
+                    (processor.F->getValue() & instruction.operand) != 0;
+                break;
+            case Op::Frame:
+                stack[top++] = processor.ppu->getFrameCount();
+                break;
+            case Op::Cycles:
+                stack[top++] = processor.clock_cycles;
+                break;
+            case Op::Load:
+                // Peek, so that evaluating has no side effects on IO
+                stack[top - 1] = processor.program_memory->peek(
+                    (register16_t)stack[top - 1]);
+                break;
+            case Op::Not:
+                stack[top - 1] = !stack[top - 1];
+                break;
+            case Op::Negate:
+                stack[top - 1] = -stack[top - 1];
+                break;
+            case Op::Complement:
+                stack[top - 1] = ~stack[top - 1];
+                break;
+            default: {
+                int64_t right = stack[--top];
+                int64_t &left = stack[top - 1];
+
+                switch (instruction.op) {
+                    case Op::Add: left = left + right; break;
+                    case Op::Subtract: left = left - right; break;
+                    case Op::BitAnd: left = left & right; break;
+                    case Op::BitOr: left = left | right; break;
+                    case Op::BitXor: left = left ^ right; break;
+                    case Op::Equal: left = left == right; break;
+                    case Op::NotEqual: left = left != right; break;
+                    case Op::Less: left = left < right; break;
+                    case Op::LessEqual: left = left <= right; break;
+                    case Op::Greater: left = left > right; break;
+                    case Op::GreaterEqual: left = left >= right; break;
+                    case Op::LogicalAnd: left = left && right; break;
+                    case Op::LogicalOr: left = left || right; break;
+                    default: break;
+                }
+            }
+        }
+    }
+
+    return top > 0 && stack[top - 1] != 0;
+}
+
+void BreakCondition::emit(Op op, int64_t operand) {
+    code.push_back({ op, operand });
+
+    // Track stack depth: operands push, binary operators pop one
+    if (op <= Op::Cycles) {
+        ++depth;
+    } else if (op >= Op::Add) {
+        --depth;
+    }
+    max_depth = std::max(max_depth, depth);
+}
+
+void BreakCondition::parseOr() {
+    parseAnd();
+    while (accept("||")) {
+        parseAnd();
+        emit(Op::LogicalOr);
+    }
+}
+
+void BreakCondition::parseAnd() {
+    parseComparison();
+    while (accept("&&")) {
+        parseComparison();
+        emit(Op::LogicalAnd);
+    }
+}
+
+void BreakCondition::parseComparison() {
+    parseBitwise();
+
+    // Two character operators first, so "<=" isn't taken as "<"
+    static const std::pair<const char *, Op> operators[] = {
+        { "==", Op::Equal },     { "!=", Op::NotEqual },
+        { "<=", Op::LessEqual }, { ">=", Op::GreaterEqual },
+        { "<", Op::Less },       { ">", Op::Greater },
+    };
+
+    for (const auto &entry : operators) {
+        if (accept(entry.first)) {
+            parseBitwise();
+            emit(entry.second);
+            return;
+        }
+    }
+}
+
+void BreakCondition::parseBitwise() {
+    parseSum();
+
+    for (;;) {
+        skipSpace();
+        if (position >= expression.size()) return;
+
+        char c = expression[position];
+        char next = position + 1 < expression.size() ? expression[position + 1]
+                                                      : '\0';
+
+        // Single & and | only, the doubled ones are logical operators
+        Op op;
+        if (c == '&' && next != '&') {
+            op = Op::BitAnd;
+        } else if (c == '|' && next != '|') {
+            op = Op::BitOr;
+        } else if (c == '^') {
+            op = Op::BitXor;
+        } else {
+            return;
+        }
+
+        ++position;
+        parseSum();
+        emit(op);
+    }
+}
+
+void BreakCondition::parseSum() {
+    parseUnary();
+    for (;;) {
+        if (accept("+")) {
+            parseUnary();
+            emit(Op::Add);
+        } else if (accept("-")) {
+            parseUnary();
+            emit(Op::Subtract);
+        } else {
+            return;
+        }
+    }
+}
+
+void BreakCondition::parseUnary() {
+    // Every nested operand comes through here
+    if (++nesting > MAX_NESTING) fail("expression is nested too deeply");
+
+    skipSpace();
+    if (position < expression.size() && expression[position] == '!' &&
+        (position + 1 >= expression.size() ||
+         expression[position + 1] != '=')) {
+        ++position;
+        parseUnary();
+        emit(Op::Not);
+    } else if (accept("-")) {
+        parseUnary();
+        emit(Op::Negate);
+    } else if (accept("~")) {
+        parseUnary();
+        emit(Op::Complement);
+    } else {
+        parsePrimary();
+    }
+
+    --nesting;
+}
+
+void BreakCondition::parsePrimary() {
+    skipSpace();
+    if (position >= expression.size()) fail("expected an operand");
+
+    if (accept("(")) {
+        parseOr();
+        expect(")");
+    } else if (accept("[")) {
+        parseOr();
+        expect("]");
+        emit(Op::Load);
+    } else if (std::isdigit((unsigned char)expression[position]) ||
+               expression[position] == '$') {
+        parseNumber();
+    } else if (std::isalpha((unsigned char)expression[position])) {
+        parseName();
+    } else {
+        fail("expected an operand");
+    }
+}
+
+void BreakCondition::parseNumber() {
+    int base = 10;
+    if (accept("$")) {
+        base = 16;
+    } else if (accept("0x") || accept("0X")) {
+        base = 16;
+    }
+
+    size_t start = position;
+    uint64_t value = 0;
+    while (position < expression.size() &&
+           std::isxdigit((unsigned char)expression[position])) {
+        char c = expression[position];
+        int digit = std::isdigit((unsigned char)c)
+                        ? c - '0'
+                        : std::toupper((unsigned char)c) - 'A' + 10;
+        if (digit >= base) break;
+
+        // Checked every digit, so value can't overflow
+        value = value * base + digit;
+        if (value > MAX_CONSTANT) fail("number is larger than 2^48");
+        ++position;
+    }
+
+    if (position == start) fail("expected a number");
+    emit(Op::Constant, value);
+}
+
+void BreakCondition::parseName() {
+    std::string name {};
+    while (position < expression.size() &&
+           std::isalnum((unsigned char)expression[position])) {
+        name += (char)std::toupper((unsigned char)expression[position]);
+        ++position;
+    }
+
+    for (int i = 0; i < 8; ++i) {
+        if (name == REGISTER8_NAMES[i]) return emit(Op::Register8, i);
+    }
+    for (int i = 0; i < 6; ++i) {
+        if (name == REGISTER16_NAMES[i]) return emit(Op::Register16, i);
+    }
+    for (int i = 0; i < 4; ++i) {
+        if (name == FLAG_NAMES[i]) return emit(Op::Flag, FLAG_BITS[i]);
+    }
+    if (name == "FRAME") return emit(Op::Frame);
+    if (name == "CYCLES") return emit(Op::Cycles);
+
+    position -= name.size();
+    fail("unknown name '" + name + "'");
+}
+
+void BreakCondition::skipSpace() {
+    while (position < expression.size() &&
+           std::isspace((unsigned char)expression[position])) {
+        ++position;
+    }
+}
+
+bool BreakCondition::accept(const char *token) {
+    skipSpace();
+
+    size_t length = std::strlen(token);
+    if (expression.compare(position, length, token) != 0) return false;
+
+    position += length;
+    return true;
+}
+
+void BreakCondition::expect(const char *token) {
+    if (!accept(token)) fail(std::string("expected '") + token + "'");
+}
+
+void BreakCondition::fail(const std::string &message) const {
+    throw std::runtime_error("Condition error at " + std::to_string(position) +
+                             ": " + message);
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+// System headers
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// User headers
+#include "Constants.hh"
+
+class Processor;
+
+/**
+ *  Condition of a conditional breakpoint, such as
+ *
+ *      A==0x3F && [HL]>0x10 && frame>200
+ *
+ *  The expression is parsed once and compiled to a small stack bytecode, so
+ *  evaluating it on a hit is a short loop over a few instructions with a
+ *  fixed size stack, and never allocates.
+ *
+ *  Operands: numbers up to 2^48 (decimal, 0x or $ hex), registers (A-L,
+ *  AF, BC, DE, HL, SP, PC), flags (fZ, fN, fH, fC), frame, cycles and
+ *  [expr] for the byte at an address. Operators, from lowest precedence:
+ *  ||, &&, == != < <= > >=, | ^ &, + -, and unary ! - ~.
+ */
+class BreakCondition {
+   public:
+    /**
+     *  Compiles the expression. Throws std::runtime_error with the position
+     *  of the problem if it can't be parsed.
+     */
+    explicit BreakCondition(const std::string &expression);
+
+    bool evaluate(const Processor &processor) const;
+
+    const std::string &getExpression() const { return expression; }
+
+   private:
+    enum class Op : uint8_t {
+        Constant,
+        Register8,
+        Register16,
+        Flag,
+        Frame,
+        Cycles,
+        Load,
+        Not,
+        Negate,
+        Complement,
+        Add,
+        Subtract,
+        BitAnd,
+        BitOr,
+        BitXor,
+        Equal,
+        NotEqual,
+        Less,
+        LessEqual,
+        Greater,
+        GreaterEqual,
+        LogicalAnd,
+        LogicalOr
+    };
+
+    struct Instruction {
+        Op op;
+        int64_t operand;
+    };
+
+    static constexpr size_t MAX_STACK_DEPTH = 32;
+
+    // Large enough for any frame or cycle count, small enough that sums of
+    // a few can't overflow the int64_t operands
+    static constexpr uint64_t MAX_CONSTANT = uint64_t(1) << 48;
+
+    // Parentheses and unary operators nested deeper than this are refused,
+    // which bounds the recursion of the parser
+    static constexpr size_t MAX_NESTING = 64;
+
+    std::string expression;
+    std::vector<Instruction> code {};
+
+    // Parser state, only used while compiling
+    size_t position { 0 };
+    size_t depth { 0 };
+    size_t max_depth { 0 };
+    size_t nesting { 0 };
+
+    void emit(Op op, int64_t operand = 0);
+
+    void parseOr();
+    void parseAnd();
+    void parseComparison();
+    void parseBitwise();
+    void parseSum();
+    void parseUnary();
+    void parsePrimary();
+    void parseNumber();
+    void parseName();
+
+    void skipSpace();
+    bool accept(const char *token);
+    void expect(const char *token);
+    [[noreturn]] void fail(const std::string &message) const;
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+// System headers
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+// User headers
+#include "BreakCondition.hh"
+#include "Constants.hh"
+
+/**
+ *  Execute breakpoints as one bit per address. Testing an address is a
+ *  single load and bit test, and the run loops only test at all when
+ *  any() is true.
+ *
+ *  Words are atomic so the GUI can toggle breakpoints while the emulation
+ *  thread runs; relaxed loads cost the same as plain ones. Conditions are
+ *  only looked up when the bit is set, and may only be changed while
+ *  nothing runs.
+ */
+class Breakpoints {
+   public:
+    Breakpoints() = default;
+
+    // Weffc++
+    Breakpoints(const Breakpoints &) = delete;
+    void operator=(const Breakpoints &) = delete;
+
+    bool test(register16_t address) const {
+        uint64_t word = bits[address >> 6].load(std::memory_order_relaxed);
+        return (word >> (address & 63)) & 1;
+    }
+
+    void set(register16_t address) {
+        uint64_t bit = uint64_t(1) << (address & 63);
+        if (!(bits[address >> 6].fetch_or(bit) & bit)) count++;
+    }
+
+    void clear(register16_t address) {
+        uint64_t bit = uint64_t(1) << (address & 63);
+        if (bits[address >> 6].fetch_and(~bit) & bit) count--;
+    }
+
+    void toggle(register16_t address) {
+        if (test(address)) {
+            clear(address);
+        } else {
+            set(address);
+        }
+    }
+
+    /**
+     *  Sets a breakpoint that only triggers when the expression (see
+     *  BreakCondition) is true. Throws std::runtime_error, without changing
+     *  anything, if the expression doesn't compile.
+     */
+    void setConditional(register16_t address, const std::string &expression) {
+        BreakCondition condition { expression };
+        conditions.erase(address);
+        conditions.emplace(address, std::move(condition));
+        set(address);
+    }
+
+    /**
+     *  Clears the breakpoint and its condition.
+     */
+    void remove(register16_t address) {
+        clear(address);
+        conditions.erase(address);
+    }
+
+    /**
+     *  Drops the conditions of breakpoints that were toggled off while
+     *  running, so toggling one on again doesn't bring its condition back.
+     *  Only call while nothing runs.
+     */
+    void dropClearedConditions() {
+        for (auto it = conditions.begin(); it != conditions.end();) {
+            it = test(it->first) ? std::next(it) : conditions.erase(it);
+        }
+    }
+
+    const BreakCondition *getCondition(register16_t address) const {
+        auto it = conditions.find(address);
+        return it == conditions.end() ? nullptr : &it->second;
+    }
+
+    /**
+     *  Whether execution should stop at address: the breakpoint is set and
+     *  its condition, if any, holds.
+     */
+    bool shouldBreak(register16_t address, const Processor &processor) const {
+        if (!test(address)) return false;
+
+        auto it = conditions.find(address);
+        return it == conditions.end() || it->second.evaluate(processor);
+    }
+
+    /**
+     *  Whether any breakpoint is set.
+     */
+    bool any() const { return count.load(std::memory_order_relaxed) != 0; }
+
+   private:
+    // The address space is flat (no bank switching), so one bit per address
+    // covers every location an instruction can be fetched from
+    std::array<std::atomic<uint64_t>, (PC_MAX + 1) / 64> bits {};
+    std::atomic<unsigned> count { 0 };
+
+    std::unordered_map<register16_t, BreakCondition> conditions {};
+};
@@ -0,0 +1,141 @@
+// System headers
+#include <algorithm>
+#include <map>
+
+// User headers
+#include "CallProfiler.hh"
+#include "Processor.hh"
+
+CallProfiler::CallProfiler(const Processor &processor)
+    : processor { processor } {}
+
+void CallProfiler::start() {
+    register16_t pc = processor.PC->getValue();
+
+    nodes.assign(1, { pc, 0, 0 });
+    children.clear();
+    functions.assign(PC_MAX + 1, {});
+    active.assign(PC_MAX + 1, 0);
+
+    stack.assign(1, { pc, PC_MAX + 1, 0, processor.clock_cycles, 0 });
+    active[pc] = 1;
+
+    running = true;
+}
+
+void CallProfiler::stop() {
+    if (!running) return;
+
+    while (!stack.empty()) closeFrame(processor.clock_cycles);
+    running = false;
+}
+
+void CallProfiler::enter(register16_t function, register16_t return_slot) {
+    uint64_t now = processor.clock_cycles;
+
+    // Frames whose return address is at or below the new one were abandoned
+    while (stack.size() > 1 && stack.back().return_slot <= return_slot) {
+        closeFrame(now);
+    }
+    if (stack.size() >= MAX_DEPTH) {
+        while (stack.size() > 1) closeFrame(now);
+    }
+
+    uint32_t node = childNode(stack.back().node, function);
+    stack.push_back({ function, return_slot, node, now, 0 });
+
+    functions[function].calls++;
+    active[function]++;
+}
+
+void CallProfiler::leave(register16_t return_slot) {
+    // Returning through an address the code pushed itself, without a call
+    // at that slot, is a jump and leaves the frames as they are
+    if (stack.size() <= 1 || stack.back().return_slot > return_slot) return;
+
+    uint64_t now = processor.clock_cycles;
+    while (stack.size() > 1 && stack.back().return_slot <= return_slot) {
+        closeFrame(now);
+    }
+}
+
+uint32_t CallProfiler::childNode(uint32_t parent, register16_t function) {
+    uint64_t key = (uint64_t)parent << 16 | function;
+
+    auto it = children.find(key);
+    if (it != children.end()) return it->second;
+
+    uint32_t node = nodes.size();
+    nodes.push_back({ function, parent, 0 });
+    children.emplace(key, node);
+    return node;
+}
+
+void CallProfiler::closeFrame(uint64_t now) {
+    Frame frame = stack.back();
+    stack.pop_back();
+
+    uint64_t inclusive = now - frame.start_cycle;
+    uint64_t exclusive = inclusive - frame.child_cycles;
+
+    nodes[frame.node].exclusive_cycles += exclusive;
+
+    FunctionProfile &profile = functions[frame.function];
+    profile.exclusive_cycles += exclusive;
+    if (--active[frame.function] == 0) profile.inclusive_cycles += inclusive;
+
+    if (!stack.empty()) stack.back().child_cycles += inclusive;
+}
+
+std::vector<CallProfiler::FunctionProfile> CallProfiler::topFunctions(
+    size_t count) const {
+    std::vector<FunctionProfile> top {};
+    for (size_t address = 0; address < functions.size(); ++address) {
+        if (functions[address].inclusive_cycles == 0) continue;
+
+        top.push_back(functions[address]);
+        top.back().address = address;
+    }
+
+    std::sort(top.begin(), top.end(),
+              [](const FunctionProfile &a, const FunctionProfile &b) {
+                  return a.inclusive_cycles > b.inclusive_cycles;
+              });
+    if (top.size() > count) top.resize(count);
+
+    return top;
+}
+
+void CallProfiler::writeCollapsed(std::ostream &out,
+                                  const SymbolTable &symbols) const {
+    std::vector<uint64_t> exclusive(nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        exclusive[i] = nodes[i].exclusive_cycles;
+    }
+
+    // Open frames so far: everything since they started, minus their
+    // completed calls and the open call above them
+    uint64_t now = processor.clock_cycles;
+    for (size_t i = 0; i < stack.size(); ++i) {
+        uint64_t open_child =
+            i + 1 < stack.size() ? now - stack[i + 1].start_cycle : 0;
+        exclusive[stack[i].node] +=
+            now - stack[i].start_cycle - stack[i].child_cycles - open_child;
+    }
+
+    // Different addresses can have the same name, so paths are merged by
+    // their text
+    std::vector<std::string> names(nodes.size());
+    std::map<std::string, uint64_t> paths {};
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        // Parents are always created before their children
+        std::string name = symbols.functionName(nodes[i].function);
+        names[i] = i == 0 ? name : names[nodes[i].parent] + ";" + name;
+
+        if (exclusive[i] > 0) paths[names[i]] += exclusive[i];
+    }
+
+    for (const auto &path : paths) {
+        out << path.first << " " << path.second << "\n";
+    }
+}
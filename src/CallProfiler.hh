@@ -0,0 +1,129 @@
+#pragma once
+
+// System headers
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// User headers
+#include "Constants.hh"
+#include "SymbolTable.hh"
+
+class Processor;
+
+/**
+ *  Keeps a shadow of the guest call stack to attribute cycles to functions,
+ *  both inclusive (with everything they call) and exclusive (their own
+ *  instructions), and per call path for flame graphs.
+ *
+ *  The instruction decoder reports calls (CALL, RST and interrupt dispatch)
+ *  and returns (RET, RETI). Guest code doesn't always pair them up: it can
+ *  reset SP, drop return addresses or return through a pushed address. Each
+ *  frame remembers where its return address was stored, and calls and
+ *  returns resynchronise against SP: a return through a slot closes every
+ *  frame at or below it, and a call whose return slot is at or above an open
+ *  frame closes that frame first. Tail calls (JP (HL) and friends) need
+ *  nothing special, the callee runs as part of the frame that jumped and ends
+ *  with its RET.
+ *
+ *  Only used by the emulation thread; read results while it's parked.
+ */
+class CallProfiler {
+   public:
+    struct FunctionProfile {
+        register16_t address { 0 };
+        uint64_t calls { 0 };
+        uint64_t inclusive_cycles { 0 };
+        uint64_t exclusive_cycles { 0 };
+    };
+
+    // Deeper call stacks are taken as the shadow stack being out of sync
+    static constexpr size_t MAX_DEPTH = 1024;
+
+    explicit CallProfiler(const Processor &processor);
+
+    // Weffc++
+    CallProfiler(const CallProfiler &) = delete;
+    void operator=(const CallProfiler &) = delete;
+
+    /**
+     *  Starts a new profile, with the code at PC as the root of every stack.
+     */
+    void start();
+
+    /**
+     *  Closes every open frame, so the totals include them.
+     */
+    void stop();
+
+    bool isRunning() const { return running; }
+
+    /**
+     *  A call to function was made, with the return address stored at
+     *  return_slot (SP after the push).
+     */
+    void enter(register16_t function, register16_t return_slot);
+
+    /**
+     *  A return address was popped from return_slot.
+     */
+    void leave(register16_t return_slot);
+
+    /**
+     *  Functions with completed calls, by inclusive cycles, most first.
+     */
+    std::vector<FunctionProfile> topFunctions(size_t count) const;
+
+    /**
+     *  Writes exclusive cycles per call path in the collapsed stack format
+     *  read by flame graph scripts ("root;caller;callee cycles"), including
+     *  the frames that are still open.
+     */
+    void writeCollapsed(std::ostream &out, const SymbolTable &symbols) const;
+
+   private:
+    // A position in the call tree: a function called through one path
+    struct Node {
+        register16_t function;
+        uint32_t parent;
+        uint64_t exclusive_cycles;
+    };
+
+    struct Frame {
+        register16_t function;
+
+        // Where the return address is stored, above all of SP for the root
+        uint32_t return_slot;
+
+        uint32_t node;
+        uint64_t start_cycle;
+
+        // Inclusive cycles of the calls made from this frame
+        uint64_t child_cycles;
+    };
+
+    const Processor &processor;
+    bool running { false };
+
+    // The root frame is always at the bottom
+    std::vector<Frame> stack {};
+
+    std::vector<Node> nodes {};
+
+    // Child node by parent node and function
+    std::unordered_map<uint64_t, uint32_t> children {};
+
+    std::vector<FunctionProfile> functions {};
+
+    // Open frames per function, so recursion isn't counted twice inclusively
+    std::vector<uint32_t> active {};
+
+    uint32_t childNode(uint32_t parent, register16_t function);
+
+    /**
+     *  Closes the innermost open frame at cycle now.
+     */
+    void closeFrame(uint64_t now);
+};
@@ -35,6 +35,20 @@ constexpr const register16_t PC_MAX_SIZE = 0xFFFF;
 constexpr const register16_t RAM_MAX_SIZE = 0xFFFF;
 constexpr const register16_t RAM_DATA_OFFSET = 0xFF00;
 
+// Interrupts
+constexpr const register16_t IF_ADDRESS = 0xFF0F;
+constexpr const register16_t IE_ADDRESS = 0xFFFF;
+
+// Interrupt bits (for the IF and IE registers)
+constexpr const byte_t INTERRUPT_VBLANK = 0x01;
+constexpr const byte_t INTERRUPT_LCD_STAT = 0x02;
+constexpr const byte_t INTERRUPT_TIMER = 0x04;
+constexpr const byte_t INTERRUPT_SERIAL = 0x08;
+constexpr const byte_t INTERRUPT_JOYPAD = 0x10;
+
+// Handler of interrupt bit n is at INTERRUPT_VECTOR_BASE + n * 8
+constexpr const register16_t INTERRUPT_VECTOR_BASE = 0x40;
+
 // Flag bits (for AND operation on flag register)
 constexpr const byte_t bit_c = 0x10;
 constexpr const byte_t bit_h = 0x20;
@@ -0,0 +1,239 @@
+// System headers
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// User headers
+#include "DeterminismChecker.hh"
+#include "Emulator.hh"
+#include "Movie.hh"
+#include "Utility.hh"
+
+namespace {
+
+template <typename T>
+uint64_t hashStruct(const T &value) {
+    return Util::hashBytes(reinterpret_cast<const byte_t *>(&value),
+                           sizeof(value));
+}
+
+std::string hexValue(unsigned value, int digits) {
+    char text[8];
+    std::snprintf(text, sizeof(text), "%0*X", digits, value);
+    return text;
+}
+
+/**
+ *  One of the instances, with the hash of its state after every frame.
+ */
+struct Lane {
+    explicit Lane(Emulator &emulator) : emulator { emulator } {}
+
+    Emulator &emulator;
+
+    // The term of every page of memory and stack; memory_hash is their
+    // XOR, so a frame only rehashes the pages it wrote to. Which pages were
+    // written doesn't matter, only what they hold.
+    std::vector<uint64_t> page_terms =
+        std::vector<uint64_t>(2 * Memory::NUMBER_OF_PAGES);
+    uint64_t memory_hash { 0 };
+
+    uint64_t hash { 0 };
+    std::string error {};
+
+    void updatePages(Memory &memory, unsigned first_term) {
+        for (unsigned page = 0; page < Memory::NUMBER_OF_PAGES; ++page) {
+            if (!memory.isDirty(page)) continue;
+
+            const byte_t *bytes = memory.pageData(page);
+            uint64_t &term = page_terms[first_term + page];
+            memory_hash ^= term;
+            term = Util::mixHash(first_term + page,
+                                 Util::hashBytes(bytes, Memory::PAGE_SIZE));
+            memory_hash ^= term;
+        }
+        memory.clearDirtyPages();
+    }
+
+    /**
+     *  Extends the rolling hash with the state after a frame.
+     */
+    void update() {
+        Processor &processor = *emulator.processor;
+
+        hash = Util::mixHash(hash, hashStruct(processor.getCPUState()));
+
+        // Whether the picture is wanted is up to the frontend, not the game
+        PPUState ppu = processor.ppu->getState();
+        ppu.output_wanted = false;
+        hash = Util::mixHash(hash, hashStruct(ppu));
+
+        updatePages(*processor.program_memory, 0);
+        updatePages(*processor.stack, Memory::NUMBER_OF_PAGES);
+        hash = Util::mixHash(hash, memory_hash);
+    }
+};
+
+}  // namespace
+
+std::string DeterminismChecker::difference(Emulator &a, Emulator &b) {
+    CPUState x = a.processor->getCPUState();
+    CPUState y = b.processor->getCPUState();
+
+    struct Field {
+        const char *name;
+        unsigned first, second;
+        int digits;
+    };
+    const Field fields[] = {
+        { "PC", x.PC, y.PC, 4 },
+        { "SP", x.SP, y.SP, 4 },
+        { "A", x.A, y.A, 2 },
+        { "F", x.F, y.F, 2 },
+        { "B", x.B, y.B, 2 },
+        { "C", x.C, y.C, 2 },
+        { "D", x.D, y.D, 2 },
+        { "E", x.E, y.E, 2 },
+        { "H", x.H, y.H, 2 },
+        { "L", x.L, y.L, 2 },
+        { "IME", x.interrupts_enabled, y.interrupts_enabled, 1 },
+        { "EI pending", x.interrupt_enable_pending,
+          y.interrupt_enable_pending, 1 },
+        { "HALT", x.halted, y.halted, 1 },
+    };
+    for (const Field &field : fields) {
+        if (field.first == field.second) continue;
+        return std::string("CPU register ") + field.name + " (" +
+               hexValue(field.first, field.digits) + " vs " +
+               hexValue(field.second, field.digits) + ")";
+    }
+
+    if (x.clock_cycles != y.clock_cycles) return "CPU cycle count";
+    if (x.machine_cycles != y.machine_cycles) return "CPU machine cycle count";
+    if (x.executed_instructions != y.executed_instructions) {
+        return "CPU instruction count";
+    }
+    if (x.serviced_interrupts != y.serviced_interrupts) {
+        return "CPU interrupt count";
+    }
+
+    // The hash covers all of it, fields added later included
+    if (std::memcmp(&x, &y, sizeof(CPUState)) != 0) return "CPU state";
+
+    PPUState p = a.processor->ppu->getState();
+    PPUState q = b.processor->ppu->getState();
+    p.output_wanted = q.output_wanted = false;
+    if (std::memcmp(&p, &q, sizeof(PPUState)) != 0) return "PPU state";
+
+    auto compare = [](const char *name, const Memory &m,
+                      const Memory &n) -> std::string {
+        for (size_t address = 0; address < m.size(); ++address) {
+            byte_t u = m.peek(address), v = n.peek(address);
+            if (u == v) continue;
+            return std::string(name) + " at 0x" + hexValue(address, 4) +
+                   " (" + hexValue(u, 2) + " vs " + hexValue(v, 2) + ")";
+        }
+        return "";
+    };
+
+    std::string found = compare("memory", *a.processor->program_memory,
+                                *b.processor->program_memory);
+    if (found.empty()) {
+        found = compare("stack memory", *a.processor->stack,
+                        *b.processor->stack);
+    }
+    return found;
+}
+
+DeterminismChecker::Result DeterminismChecker::run(const Movie &movie) {
+    first.startPlayback(movie);
+    second.startPlayback(movie);
+
+    // Start both from a full hash of the starting state
+    Lane lanes[2] = { Lane { first }, Lane { second } };
+    for (Lane &lane : lanes) {
+        lane.emulator.processor->program_memory->markAllDirty();
+        lane.emulator.processor->stack->markAllDirty();
+        lane.update();
+    }
+
+    std::mutex mutex {};
+    std::condition_variable start_frame {};
+    std::condition_variable frame_done {};
+    uint64_t requested = 0;
+    unsigned finished = 0;
+    bool stopping = false;
+
+    auto work = [&](Lane &lane) {
+        uint64_t frame = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock { mutex };
+                start_frame.wait(
+                    lock, [&] { return stopping || requested != frame; });
+                if (stopping) return;
+                frame = requested;
+            }
+
+            try {
+                lane.emulator.runFrame();
+                lane.update();
+            } catch (const std::exception &ex) {
+                lane.error = ex.what();
+            }
+
+            {
+                std::lock_guard<std::mutex> lock { mutex };
+                ++finished;
+            }
+            frame_done.notify_one();
+        }
+    };
+
+    std::thread threads[2] = { std::thread(work, std::ref(lanes[0])),
+                               std::thread(work, std::ref(lanes[1])) };
+
+    Result result {};
+    std::string error {};
+    for (uint64_t frame = 0; frame < movie.inputs.size(); ++frame) {
+        {
+            std::unique_lock<std::mutex> lock { mutex };
+            finished = 0;
+            ++requested;
+            start_frame.notify_all();
+            frame_done.wait(lock, [&] { return finished == 2; });
+        }
+
+        if (!lanes[0].error.empty() || !lanes[1].error.empty()) {
+            error = "Frame " + std::to_string(frame) + ": " +
+                    (lanes[0].error.empty() ? lanes[1].error : lanes[0].error);
+            break;
+        }
+
+        result.frames = frame + 1;
+        if (lanes[0].hash != lanes[1].hash) {
+            result.diverged = true;
+            result.frame = frame;
+            result.component = difference(first, second);
+            break;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock { mutex };
+        stopping = true;
+    }
+    start_frame.notify_all();
+    for (std::thread &thread : threads) thread.join();
+
+    first.stopMovie();
+    second.stopMovie();
+
+    if (!error.empty()) throw std::runtime_error(error);
+    return result;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+// System headers
+#include <cstdint>
+#include <string>
+
+class Emulator;
+class Movie;
+
+/**
+ *  Plays the same movie on two emulators, each on its own thread, in
+ *  lockstep, and compares a rolling hash of their state after every frame:
+ *  CPU registers, PPU state and memory, where only the pages written during
+ *  the frame are hashed again. The instances can be set up differently
+ *  (frame skipping, run-ahead, instrumented run loops, ...), which proves
+ *  that those never change results.
+ */
+class DeterminismChecker {
+   public:
+    struct Result {
+        // Frames that were run on both instances
+        uint64_t frames { 0 };
+
+        bool diverged { false };
+
+        // The frame after which the states first differed, and what
+        // differed, e.g. "CPU register PC" or "memory at 0xC012"
+        uint64_t frame { 0 };
+        std::string component {};
+    };
+
+    DeterminismChecker(Emulator &first, Emulator &second)
+        : first { first }, second { second } {}
+
+    // Weffc++
+    DeterminismChecker(const DeterminismChecker &) = delete;
+    void operator=(const DeterminismChecker &) = delete;
+
+    /**
+     *  Plays movie on both instances until it ends or they diverge. Throws
+     *  std::runtime_error if the movie can't be played on them, or either
+     *  one fails to run a frame.
+     */
+    Result run(const Movie &movie);
+
+    /**
+     *  Names the first part of the state that differs between a and b, or
+     *  returns an empty string if the states are the same.
+     */
+    static std::string difference(Emulator &a, Emulator &b);
+
+   private:
+    Emulator &first;
+    Emulator &second;
+};
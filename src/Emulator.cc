@@ -0,0 +1,483 @@
+// System headers
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// User headers
+#include "Emulator.hh"
+#include "Utility.hh"
+
+namespace {
+
+void checkNoROM(const Processor &processor) {
+    if (!processor.rom_data.empty()) {
+        throw std::runtime_error("A ROM is already loaded");
+    }
+}
+
+}  // namespace
+
+void Emulator::loadROM(const std::string &filename, bool verbose) {
+    checkNoROM(*processor);
+    processor->readInstructions(filename, verbose);
+}
+
+void Emulator::loadROM(const byte_t *data, size_t size, bool verbose) {
+    checkNoROM(*processor);
+    processor->readInstructions(data, size, verbose);
+}
+
+void Emulator::setPPUAccuracy(PPUAccuracy accuracy) {
+    processor->ppu->setAccuracy(accuracy);
+}
+
+void Emulator::setFrameSkip(unsigned frames) {
+    frame_skip = frames;
+
+    // Render the next frame, then start skipping
+    skipped_frames = frames;
+}
+
+void Emulator::setAutoFrameSkip(bool enabled) {
+    auto_frame_skip = enabled;
+    frame_deadline = std::chrono::steady_clock::now() + FRAME_DURATION;
+}
+
+void Emulator::setCallProfiling(bool enabled) {
+    if (enabled) {
+        call_profiler->start();
+        instruction_decoder->call_profiler = call_profiler;
+    } else {
+        call_profiler->stop();
+        instruction_decoder->call_profiler = nullptr;
+    }
+}
+
+ptr<Emulator> Emulator::clone() {
+    auto copy = std::make_shared<Emulator>();
+    const Processor &from = *processor;
+    Processor &to = *copy->processor;
+
+    to.rom_data = from.rom_data;
+    to.program_memory->shareFrom(*from.program_memory);
+    to.stack->shareFrom(*from.stack);
+    to.setCPUState(from.getCPUState());
+
+    copy->setPPUAccuracy(from.ppu->getAccuracy());
+    to.ppu->restoreState(from.ppu->getState());
+    to.ppu->restoreFramebuffer(from.ppu->getFramebuffer());
+    to.joypad->restoreState(from.joypad->getState());
+
+    // Profiler samples belong to this emulator's profiler
+    std::vector<Event> events {};
+    for (const Event &event : from.scheduler.pendingEvents()) {
+        if (event.type != EventType::ProfilerSample) events.push_back(event);
+    }
+    to.scheduler.restoreEvents(events);
+
+    copy->frame_skip = frame_skip;
+    copy->skipped_frames = skipped_frames;
+    copy->auto_frame_skip = auto_frame_skip;
+    copy->frame_deadline = frame_deadline;
+    copy->buttons = buttons;
+
+    return copy;
+}
+
+size_t Emulator::stateSize(bool with_framebuffer) const {
+    return SaveState::size(*processor, with_framebuffer);
+}
+
+size_t Emulator::saveState(byte_t *buffer, size_t size,
+                           bool with_framebuffer) const {
+    return SaveState::save(*processor, buffer, size, with_framebuffer);
+}
+
+void Emulator::loadState(const byte_t *data, size_t size) {
+    SaveState::load(*processor, data, size);
+
+    // Profiler samples aren't part of the state, and the shadow call stack
+    // doesn't match the restored one
+    if (sampling_profiler->isRunning()) {
+        sampling_profiler->start(sampling_profiler->getInterval());
+    }
+    if (call_profiler->isRunning()) setCallProfiling(true);
+}
+
+void Emulator::saveStateFile(const std::string &filename) const {
+    std::vector<byte_t> state(stateSize());
+    state.resize(saveState(state.data(), state.size()));
+
+    std::ofstream file { filename, std::ios::binary | std::ios::trunc };
+    file.write(reinterpret_cast<const char *>(state.data()), state.size());
+    if (!file) throw std::runtime_error("Could not write " + filename);
+}
+
+void Emulator::loadStateFile(const std::string &filename) {
+    std::ifstream file { filename, std::ios::binary };
+    if (!file.is_open()) throw std::runtime_error("Could not open " + filename);
+
+    std::vector<byte_t> state { std::istreambuf_iterator<char>(file),
+                                std::istreambuf_iterator<char>() };
+    loadState(state.data(), state.size());
+}
+
+bool Emulator::nextFrameWanted() {
+    if (auto_frame_skip) {
+        auto now = std::chrono::steady_clock::now();
+
+        // Don't try to catch up after a long stall (paused, debugger, ...)
+        if (now - frame_deadline > std::chrono::seconds(1)) {
+            frame_deadline = now;
+        }
+
+        bool behind = now > frame_deadline;
+        frame_deadline += FRAME_DURATION;
+
+        return !behind || skipped_frames >= MAX_AUTO_FRAME_SKIP;
+    }
+
+    return skipped_frames >= frame_skip;
+}
+
+/**
+ *  Run loop policies. beforeStep() is called before every instruction and
+ *  afterStep() after it, returning true if the run should stop.
+ */
+struct Emulator::NoChecks {
+    void beforeStep() {}
+    bool afterStep() { return false; }
+};
+
+/**
+ *  Tracing, breakpoints and watchpoints.
+ */
+struct Emulator::DebugChecks {
+    Emulator &emulator;
+
+    void beforeStep() {
+        if (emulator.trace_recorder->isRecording()) {
+            emulator.trace_recorder->record(*emulator.processor);
+        }
+    }
+
+    bool afterStep() { return emulator.stopForDebugger(); }
+};
+
+/**
+ *  Adds the opcode profiler to another policy.
+ */
+template <typename Checks>
+struct Emulator::Profiled {
+    Checks checks;
+    OpcodeProfiler &profiler;
+    const Processor &processor;
+
+    void beforeStep() {
+        checks.beforeStep();
+        profiler.begin(processor);
+    }
+
+    bool afterStep() {
+        profiler.end(processor);
+        return checks.afterStep();
+    }
+};
+
+bool Emulator::debugChecksNeeded() const {
+    return breakpoints.any() || processor->program_memory->hasWatchpoints() ||
+           trace_recorder->isRecording();
+}
+
+template <typename Run>
+auto Emulator::withRunPolicy(Run run) {
+    bool debug = debugChecksNeeded();
+
+    if (profiling.load(std::memory_order_relaxed)) {
+        if (debug) {
+            return run(Profiled<DebugChecks> { DebugChecks { *this },
+                                               *opcode_profiler, *processor });
+        }
+        return run(
+            Profiled<NoChecks> { NoChecks {}, *opcode_profiler, *processor });
+    }
+
+    if (debug) return run(DebugChecks { *this });
+    return run(NoChecks {});
+}
+
+bool Emulator::stopForDebugger() {
+    if (processor->program_memory->takeWatchpointHit(watchpoint_hit)) {
+        stop_reason = StopReason::Watchpoint;
+        return true;
+    }
+
+    // A halted CPU stays at the instruction after HALT, which would hit a
+    // breakpoint there on every step until it wakes
+    if (!processor->halted &&
+        breakpoints.shouldBreak(processor->PC->getValue(), *processor)) {
+        stop_reason = StopReason::Breakpoint;
+        return true;
+    }
+
+    return false;
+}
+
+void Emulator::runFrame() {
+    // A frame the debugger stopped in carries on with the same input, and
+    // is rendered or skipped as decided when it started
+    if (stop_reason == StopReason::None) {
+        applyInput();
+
+        if (forced_skips > 0) {
+            --forced_skips;
+            frame_rendered = false;
+        } else {
+            frame_rendered = nextFrameWanted();
+        }
+        skipped_frames = frame_rendered ? 0 : skipped_frames + 1;
+    }
+
+    // With run-ahead the frame shown is a speculative one, not this one
+    bool ahead =
+        frame_rendered && run_ahead->getFrames() > 0 && runAheadAllowed();
+    processor->ppu->setOutputWanted(frame_rendered &&
+                                    (!ahead || run_ahead->needsRealFrame()));
+
+    stop_reason = StopReason::None;
+    withRunPolicy([this](auto policy) { runFrameLoop(policy); });
+
+    if (rewind_enabled && stop_reason == StopReason::None &&
+        ++frames_since_snapshot >= rewind_buffer->getInterval()) {
+        takeRewindSnapshot();
+    }
+
+    if (ahead && stop_reason == StopReason::None) run_ahead->speculate();
+}
+
+void Emulator::applyInput() {
+    byte_t pressed = buttons;
+
+    if (movie_mode == MovieMode::Playing) {
+        pressed = movie->inputs[movie_frame++];
+        if (movie_frame == movie->inputs.size()) movie_mode = MovieMode::None;
+    } else if (movie_mode == MovieMode::Recording) {
+        movie->inputs.push_back(pressed);
+        ++movie_frame;
+    }
+
+    processor->joypad->setButtons(pressed);
+}
+
+void Emulator::startRecording() {
+    Movie recording {};
+    recording.rom_hash = romHash();
+    recording.start_hash = stateHash();
+    recording.accuracy = processor->ppu->getAccuracy();
+
+    if (processor->clock_cycles != 0) {
+        std::vector<byte_t> &state = recording.start_state;
+        state.resize(stateSize(false));
+        state.resize(saveState(state.data(), state.size(), false));
+    }
+
+    *movie = std::move(recording);
+    movie_mode = MovieMode::Recording;
+    movie_frame = 0;
+
+    // The first recorded frame takes new input even after a debugger stop
+    stop_reason = StopReason::None;
+}
+
+void Emulator::startPlayback(const Movie &played) {
+    if (played.rom_hash != romHash()) {
+        throw std::runtime_error("The movie was recorded with another ROM");
+    }
+
+    if (played.startsAtPowerOn()) {
+        if (stateHash() != played.start_hash) {
+            throw std::runtime_error(
+                "The movie starts at power-on, but this machine isn't there");
+        }
+    } else {
+        loadState(played.start_state.data(), played.start_state.size());
+    }
+
+    if (&played != movie.get()) *movie = played;
+    setPPUAccuracy(movie->accuracy);
+
+    movie_mode =
+        movie->inputs.empty() ? MovieMode::None : MovieMode::Playing;
+    movie_frame = 0;
+    stop_reason = StopReason::None;
+}
+
+uint64_t Emulator::romHash() const {
+    const std::vector<opcode_t> &rom = processor->rom_data;
+    return Util::hashBytes(rom.data(), rom.size());
+}
+
+uint64_t Emulator::stateHash() const {
+    std::vector<byte_t> state(stateSize(false));
+    size_t size = saveState(state.data(), state.size(), false);
+    return Util::hashBytes(state.data(), size);
+}
+
+void Emulator::setFingerprinting(bool enabled) {
+    processor->program_memory->setHashing(enabled);
+    processor->stack->setHashing(enabled);
+}
+
+uint64_t Emulator::fingerprint() const {
+    auto hashStruct = [](const auto &value) {
+        return Util::hashBytes(reinterpret_cast<const byte_t *>(&value),
+                               sizeof(value));
+    };
+
+    // Counters only tell how the state was reached
+    CPUState cpu = processor->getCPUState();
+    cpu.machine_cycles = 0;
+    cpu.executed_instructions = 0;
+    cpu.serviced_interrupts = 0;
+
+    // Whether the picture is wanted is up to the frontend, not the game
+    PPUState ppu = processor->ppu->getState();
+    ppu.output_wanted = false;
+
+    uint64_t hash = processor->program_memory->contentHash();
+    hash = Util::mixHash(hash, processor->stack->contentHash());
+    hash = Util::mixHash(hash, hashStruct(cpu));
+    hash = Util::mixHash(hash, hashStruct(ppu));
+    return Util::mixHash(hash, hashStruct(processor->joypad->getState()));
+}
+
+bool Emulator::runAheadAllowed() const {
+    return !debugChecksNeeded() && !profiling.load(std::memory_order_relaxed) &&
+           !sampling_profiler->isRunning() && !call_profiler->isRunning();
+}
+
+void Emulator::runSpeculativeFrame(bool output_wanted) {
+    processor->ppu->setOutputWanted(output_wanted);
+    runFrameLoop(NoChecks {});
+}
+
+void Emulator::setRewindEnabled(bool enabled) {
+    rewind_enabled = enabled;
+    frames_since_snapshot = 0;
+    rewind_buffer->clear();
+}
+
+void Emulator::takeRewindSnapshot() {
+    frames_since_snapshot = 0;
+
+    // The picture comes back with the frame run after rewinding, so it's
+    // not worth storing
+    rewind_state.resize(stateSize(false));
+    size_t size = saveState(rewind_state.data(), rewind_state.size(), false);
+    rewind_buffer->push(rewind_state.data(), size);
+}
+
+bool Emulator::rewindFrame() {
+    // Going back in time can't be recorded or played back
+    if (rewind_buffer->empty() || movie_mode != MovieMode::None) return false;
+
+    bool rewound = rewind_buffer->rewind();
+    loadState(rewind_buffer->newestState(), rewind_buffer->newestSize());
+    frames_since_snapshot = 0;
+
+    // Show the restored state, with the debugger out of the way
+    frame_rendered = true;
+    processor->ppu->setOutputWanted(true);
+    stop_reason = StopReason::None;
+    runFrameLoop(NoChecks {});
+
+    return rewound;
+}
+
+template <typename Policy>
+void Emulator::runFrameLoop(Policy policy) {
+    processor->program_memory->clearWatchpointHit();
+
+    uint64_t frame = processor->ppu->getFrameCount();
+    uint64_t end_cycle = processor->clock_cycles + LCD::DOTS_PER_FRAME;
+
+    while (processor->ppu->getFrameCount() == frame) {
+        policy.beforeStep();
+        instruction_decoder->step();
+        if (policy.afterStep()) return;
+
+        if (!processor->ppu->lcdEnabled() &&
+            processor->clock_cycles >= end_cycle) {
+            break;
+        }
+    }
+}
+
+RunTarget Emulator::makeRunTarget(RunMode mode, uint64_t argument) const {
+    switch (mode) {
+        case RunMode::Instructions:
+            return { mode, argument };
+        case RunMode::ToPC:
+            return { mode, argument & PC_MAX };
+        case RunMode::ToFrame:
+            return { mode, processor->ppu->getFrameCount() + 1 };
+        case RunMode::ToInterrupt:
+            return { mode, processor->serviced_interrupts + 1 };
+    }
+
+    return { mode, argument };
+}
+
+bool Emulator::runTowards(RunTarget &target, unsigned max_steps) {
+    // Debugger runs always show every frame
+    processor->ppu->setOutputWanted(true);
+
+    stop_reason = StopReason::None;
+    return withRunPolicy([this, &target, max_steps](auto policy) {
+        return runTowardsLoop(policy, target, max_steps);
+    });
+}
+
+template <typename Policy>
+bool Emulator::runTowardsLoop(Policy policy, RunTarget &target,
+                              unsigned max_steps) {
+    processor->program_memory->clearWatchpointHit();
+
+    for (unsigned i = 0; i < max_steps; ++i) {
+        policy.beforeStep();
+        instruction_decoder->step();
+        if (policy.afterStep()) return true;
+
+        switch (target.mode) {
+            case RunMode::Instructions:
+                if (--target.value == 0) return true;
+                break;
+            case RunMode::ToPC:
+                if (processor->PC->getValue() == target.value) return true;
+                break;
+            case RunMode::ToFrame:
+                if (processor->ppu->getFrameCount() >= target.value) {
+                    return true;
+                }
+                break;
+            case RunMode::ToInterrupt:
+                if (processor->serviced_interrupts >= target.value) {
+                    return true;
+                }
+                break;
+        }
+    }
+
+    return false;
+}
+
+const framebuffer_t &Emulator::getFramebuffer() const {
+    return processor->ppu->getFramebuffer();
+}
+
+uint64_t Emulator::frameHash() const {
+    const framebuffer_t &framebuffer = getFramebuffer();
+    return Util::hashBytes(framebuffer.data(), framebuffer.size());
+}
@@ -0,0 +1,383 @@
+#pragma once
+
+// System headers
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+// User headers
+#include "Breakpoints.hh"
+#include "CallProfiler.hh"
+#include "Constants.hh"
+#include "InstructionDecoder.hh"
+#include "Movie.hh"
+#include "OpcodeProfiler.hh"
+#include "PPU.hh"
+#include "Processor.hh"
+#include "RewindBuffer.hh"
+#include "RunAhead.hh"
+#include "SamplingProfiler.hh"
+#include "SaveState.hh"
+#include "SymbolTable.hh"
+#include "TraceRecorder.hh"
+
+/**
+ *  Where a debugger run stops.
+ */
+enum class RunMode : uint8_t {
+    Instructions,  // After a number of steps
+    ToPC,          // When PC reaches an address
+    ToFrame,       // When the next frame is finished
+    ToInterrupt    // When the next interrupt is dispatched
+};
+
+/**
+ *  Why the last run stopped before it was done.
+ */
+enum class StopReason : uint8_t { None, Breakpoint, Watchpoint };
+
+/**
+ *  What happens to the input of each frame.
+ */
+enum class MovieMode : uint8_t { None, Recording, Playing };
+
+struct RunTarget {
+    RunMode mode { RunMode::Instructions };
+
+    // Steps left, the PC or the frame/interrupt count to stop at
+    uint64_t value { 0 };
+};
+
+/**
+ *  Owns one emulated machine (processor state and instruction decoder) and
+ *  drives it frame by frame. This is what frontends and tools run.
+ */
+class Emulator {
+   public:
+    Emulator() = default;
+
+    // Weffc++
+    Emulator(const Emulator &) = delete;
+    void operator=(const Emulator &) = delete;
+
+    /**
+     *  Loads the ROM into a machine at power-on. Nothing resets the rest of
+     *  the machine, so there is one ROM per emulator: throws
+     *  std::runtime_error if one is loaded already.
+     */
+    void loadROM(const std::string &filename, bool verbose = false);
+    void loadROM(const byte_t *data, size_t size, bool verbose = false);
+
+    void setPPUAccuracy(PPUAccuracy accuracy);
+
+    /**
+     *  Renders only one frame out of every frames + 1. Skipped frames keep
+     *  all PPU timing and interrupts but do no pixel work.
+     */
+    void setFrameSkip(unsigned frames);
+
+    /**
+     *  Skips frames whenever emulation has fallen behind real time (by the
+     *  host clock), but never more than MAX_AUTO_FRAME_SKIP in a row.
+     */
+    void setAutoFrameSkip(bool enabled);
+
+    /**
+     *  Skips the next frames frames whatever frame skipping is set up, for
+     *  callers that only look at the last of a few frames.
+     */
+    void skipNextFrames(unsigned frames) { forced_skips = frames; }
+
+    /**
+     *  Whether the last frame run by runFrame() was rendered.
+     */
+    bool frameRendered() const { return frame_rendered; }
+
+    /**
+     *  Runs until the PPU has finished a frame (entered VBlank). If the LCD
+     *  is off, runs for one frame worth of cycles instead. Stops early if PC
+     *  reaches a breakpoint or a watchpoint triggers.
+     */
+    void runFrame();
+
+    /**
+     *  Creates a target for runTowards(). The argument is the number of
+     *  steps for RunMode::Instructions and the address for RunMode::ToPC,
+     *  and is ignored otherwise.
+     */
+    RunTarget makeRunTarget(RunMode mode, uint64_t argument = 0) const;
+
+    /**
+     *  Steps until the target is reached, but at most max_steps times.
+     *  Always steps at least once, so running to the current PC stops at
+     *  the next visit. Returns true if the target was reached or the run
+     *  stopped for the debugger.
+     */
+    bool runTowards(RunTarget &target, unsigned max_steps);
+
+    /**
+     *  Whether the last run stopped for the debugger. At a breakpoint, the
+     *  instruction at PC has not been executed yet. A watchpoint stops after
+     *  the instruction that made the access, see getWatchpointHit().
+     */
+    StopReason stopReason() const { return stop_reason; }
+    const WatchpointHit &getWatchpointHit() const { return watchpoint_hit; }
+
+    const framebuffer_t &getFramebuffer() const;
+
+    /**
+     *  Hash of the current framebuffer, for comparing output between runs.
+     */
+    uint64_t frameHash() const;
+
+    /**
+     *  Save states of the whole machine (see SaveState), in memory or as
+     *  files. Only call while the emulator isn't running. Throws
+     *  std::runtime_error if the state can't be written or loaded; a failed
+     *  load leaves the machine as it was.
+     */
+    size_t stateSize(bool with_framebuffer = true) const;
+    size_t saveState(byte_t *buffer, size_t size,
+                     bool with_framebuffer = true) const;
+    void loadState(const byte_t *data, size_t size);
+    void saveStateFile(const std::string &filename) const;
+    void loadStateFile(const std::string &filename);
+
+    /**
+     *  A new emulator in the same state, for branching searches. Memory is
+     *  shared page by page and copied on write (see Memory::shareFrom), so
+     *  a clone costs about as much as constructing an emulator, and each
+     *  branch only pays for the pages it changes. Frame skip, PPU accuracy,
+     *  fingerprinting and the buttons held carry over; debugging,
+     *  profiling, rewind, run-ahead and movies don't.
+     *
+     *  Not const: sharing takes the pages out of this emulator's write
+     *  table too. Only call while the emulator is idle, and never clone
+     *  one emulator from two threads at once.
+     */
+    ptr<Emulator> clone();
+
+    ptr<Processor> processor { std::make_shared<Processor>() };
+    ptr<InstructionDecoder> instruction_decoder {
+        std::make_shared<InstructionDecoder>(processor)
+    };
+
+    Breakpoints breakpoints {};
+
+    // Records every instruction run by runFrame() and runTowards() while
+    // started
+    ptr<TraceRecorder> trace_recorder { std::make_shared<TraceRecorder>() };
+
+    // Counts executions and cycles per opcode while profiling is enabled
+    ptr<OpcodeProfiler> opcode_profiler { std::make_shared<OpcodeProfiler>() };
+
+    /**
+     *  Enables the opcode profiler for the next runs. Can be toggled while
+     *  another thread runs the emulator, it's picked up at the next frame.
+     */
+    void setProfiling(bool enabled) { profiling.store(enabled); }
+    bool isProfiling() const { return profiling.load(); }
+
+    // Names guest functions in profiles
+    ptr<SymbolTable> symbols { std::make_shared<SymbolTable>() };
+
+    // Samples PC every few thousand cycles while started, to find hot code
+    ptr<SamplingProfiler> sampling_profiler {
+        std::make_shared<SamplingProfiler>(*processor, *symbols)
+    };
+
+    // Shadow call stack, attributing cycles to guest functions while
+    // call profiling
+    ptr<CallProfiler> call_profiler {
+        std::make_shared<CallProfiler>(*processor)
+    };
+
+    /**
+     *  Starts a new call profile, or stops the current one. Only call while
+     *  the emulator isn't running.
+     */
+    void setCallProfiling(bool enabled);
+    bool isCallProfiling() const { return call_profiler->isRunning(); }
+
+    // Snapshots taken by runFrame() while rewind is enabled
+    ptr<RewindBuffer> rewind_buffer { std::make_shared<RewindBuffer>() };
+
+    /**
+     *  Takes a rewind snapshot every few frames from now on, or stops and
+     *  drops the snapshots. Only call while the emulator isn't running.
+     */
+    void setRewindEnabled(bool enabled);
+    bool isRewindEnabled() const { return rewind_enabled; }
+
+    /**
+     *  Goes back to the previous rewind snapshot and runs a frame from it to
+     *  show it, instead of runFrame(). Returns false once at the oldest
+     *  snapshot, or if there are none.
+     */
+    bool rewindFrame();
+
+    /**
+     *  Buttons held (Buttons bits) from the next frame on. runFrame() applies
+     *  them to the joypad at the start of every frame, unless a movie is
+     *  playing.
+     */
+    void setButtons(byte_t pressed) { buttons = pressed; }
+
+    // Input of every frame while recording, or the input played back
+    ptr<Movie> movie { std::make_shared<Movie>() };
+
+    /**
+     *  Starts a new movie, recording the input of every following frame.
+     *  Movies started before the first frame begin at power-on and only
+     *  store a hash of it, others store the current state. Only call while
+     *  the emulator isn't running.
+     */
+    void startRecording();
+
+    /**
+     *  Restores the start of movie and plays its input back, one frame per
+     *  runFrame(), until it runs out. Throws std::runtime_error, without
+     *  changing anything, if the movie is for another ROM or a power-on
+     *  state this machine isn't in. Only call while the emulator isn't
+     *  running.
+     */
+    void startPlayback(const Movie &movie);
+
+    /**
+     *  Stops recording or playing back. A recording stays in movie.
+     */
+    void stopMovie() { movie_mode = MovieMode::None; }
+
+    MovieMode movieMode() const { return movie_mode; }
+
+    /**
+     *  Frames recorded or played back so far.
+     */
+    size_t movieFrame() const { return movie_frame; }
+
+    /**
+     *  Hash of the ROM, to tell which ROM a movie belongs to.
+     */
+    uint64_t romHash() const;
+
+    /**
+     *  Hash of the whole machine state (without framebuffer).
+     */
+    uint64_t stateHash() const;
+
+    /**
+     *  Keeps incremental hashes of memory and stack up to date on every
+     *  write from now on (see Memory::setHashing), making fingerprint()
+     *  O(1). Costs a little on every write, and a full rehash on every
+     *  state load.
+     */
+    void setFingerprinting(bool enabled);
+    bool isFingerprinting() const {
+        return processor->program_memory->isHashing();
+    }
+
+    /**
+     *  64 bit fingerprint of the machine state, for telling states apart in
+     *  searches: the Zobrist hashes of memory and stack combined with the
+     *  registers, PPU and joypad state. Equal states give equal
+     *  fingerprints, whether or not fingerprinting is enabled; without it
+     *  memory is hashed in full. The instruction, interrupt and machine
+     *  cycle counters are left out, as they only tell how a state was
+     *  reached.
+     */
+    uint64_t fingerprint() const;
+
+    // Shows frames from a few frames ahead while set up, see RunAhead.
+    // Skipped while debugging or profiling.
+    ptr<RunAhead> run_ahead { std::make_shared<RunAhead>(*this) };
+
+    /**
+     *  Runs a frame that isn't part of the real timeline, without debug
+     *  checks, rewind snapshots or frame skipping. For run-ahead, which
+     *  restores the state afterwards.
+     */
+    void runSpeculativeFrame(bool output_wanted);
+
+    static constexpr unsigned MAX_AUTO_FRAME_SKIP = 8;
+
+    // 4194304 Hz / 70224 cycles per frame
+    static constexpr std::chrono::nanoseconds FRAME_DURATION { 16742706 };
+
+   private:
+    unsigned frame_skip { 0 };
+    bool auto_frame_skip { false };
+
+    // Frames skipped since the last rendered one
+    unsigned skipped_frames { 0 };
+    unsigned forced_skips { 0 };
+    bool frame_rendered { true };
+
+    // When the next frame should be done to keep up with real time
+    std::chrono::steady_clock::time_point frame_deadline {};
+
+    std::atomic<bool> profiling { false };
+
+    byte_t buttons { 0 };
+    MovieMode movie_mode { MovieMode::None };
+    size_t movie_frame { 0 };
+
+    /**
+     *  Sets the joypad for the next frame, from the movie or the buttons
+     *  held, and records it.
+     */
+    void applyInput();
+
+    bool rewind_enabled { false };
+    unsigned frames_since_snapshot { 0 };
+
+    // Reused for saving rewind snapshots
+    std::vector<byte_t> rewind_state {};
+
+    void takeRewindSnapshot();
+
+    /**
+     *  Whether speculative frames are harmless: nothing observes execution
+     *  or would be reset by the restore.
+     */
+    bool runAheadAllowed() const;
+
+    StopReason stop_reason { StopReason::None };
+    WatchpointHit watchpoint_hit {};
+
+    /**
+     *  Decides whether the next frame is rendered or skipped.
+     */
+    bool nextFrameWanted();
+
+    // The run loops are instantiated with a policy that is called around
+    // every step, so runs without breakpoints, watchpoints, tracing or
+    // profiling don't test anything per instruction. Watchpoints still
+    // latch their hits during those, so every run starts by dropping them.
+
+    struct NoChecks;
+    struct DebugChecks;
+    template <typename Checks>
+    struct Profiled;
+
+    bool debugChecksNeeded() const;
+
+    /**
+     *  Calls run with the cheapest policy that covers what is enabled.
+     */
+    template <typename Run>
+    auto withRunPolicy(Run run);
+
+    /**
+     *  Checks for breakpoints and watchpoints after a step. Sets stop_reason
+     *  and returns true if the run should stop.
+     */
+    bool stopForDebugger();
+
+    template <typename Policy>
+    void runFrameLoop(Policy policy);
+
+    template <typename Policy>
+    bool runTowardsLoop(Policy policy, RunTarget &target, unsigned max_steps);
+};
@@ -0,0 +1,203 @@
+// System headers
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+
+// User headers
+#include "EmulatorThread.hh"
+#include "InstructionDecoder.hh"
+#include "Utility.hh"
+
+EmulatorThread::~EmulatorThread() { stop(); }
+
+void EmulatorThread::start(bool paused) {
+    state.store(paused ? State::Pausing : State::Running);
+    running.store(true);
+    thread = std::thread(&EmulatorThread::run, this);
+}
+
+void EmulatorThread::stop() {
+    running.store(false);
+    if (thread.joinable()) thread.join();
+}
+
+void EmulatorThread::pause() { requestPause(); }
+
+bool EmulatorThread::requestPause() {
+    State expected = State::Running;
+    return state.compare_exchange_strong(expected, State::Pausing);
+}
+
+bool EmulatorThread::pauseAndWait() {
+    bool paused = requestPause();
+    while (!isParked() && running.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return paused;
+}
+
+void EmulatorThread::resume() {
+    run_target_active = false;
+    unpark();
+}
+
+void EmulatorThread::runTo(RunMode mode, uint64_t argument) {
+    checkNoMovie();
+    run_target = emulator.makeRunTarget(mode, argument);
+    run_target_active = true;
+    unpark();
+}
+
+void EmulatorThread::step() {
+    checkNoMovie();
+    emulator.instruction_decoder->step();
+}
+
+void EmulatorThread::checkNoMovie() const {
+    // Stopping mid-frame would record or play the next input mid-frame
+    if (emulator.movieMode() != MovieMode::None) {
+        throw std::runtime_error("Can't run or step during a movie");
+    }
+}
+
+void EmulatorThread::unpark() {
+    // The caller is the only one touching the emulator while parked, so it
+    // gives that up before the thread is let go
+    error.clear();
+    state.store(State::Running, std::memory_order_release);
+}
+
+void EmulatorThread::park() {
+    publishDebugSnapshot();
+
+    // Resumed again before getting here
+    State expected = State::Pausing;
+    if (!state.compare_exchange_strong(expected, State::Parked,
+                                       std::memory_order_acq_rel)) {
+        return;
+    }
+
+    while (state.load(std::memory_order_acquire) == State::Parked &&
+           running.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void EmulatorThread::publishFrame() {
+    FrameOutput &output = frame_buffer.writeBuffer();
+    output.pixels = emulator.getFramebuffer();
+    output.frame_number = emulator.processor->ppu->getFrameCount();
+    frame_buffer.publish();
+}
+
+void EmulatorThread::publishDebugSnapshot() {
+    debug_snapshot.store(emulator.processor->getDebugSnapshot());
+}
+
+void EmulatorThread::publishDebugSnapshotPeriodically() {
+    // Bounded, so running unthrottled doesn't spend its time on this
+    auto now = std::chrono::steady_clock::now();
+    if (now >= next_debug_publish) {
+        publishDebugSnapshot();
+        next_debug_publish = now + DEBUG_PUBLISH_INTERVAL;
+    }
+}
+
+void EmulatorThread::stopForDebugger() {
+    char message[64];
+    char *end = message;
+
+    if (emulator.stopReason() == StopReason::Watchpoint) {
+        const WatchpointHit &hit = emulator.getWatchpointHit();
+        const char *access =
+            hit.access == WATCH_WRITE ? "Watchpoint write " : "Watchpoint read ";
+        end = std::copy(access, access + std::strlen(access), end);
+        end = Util::hexFormat(end, hit.address, 4);
+        end = std::copy_n(" = ", 3, end);
+        Util::hexFormat(end, hit.value, 2);
+    } else {
+        end = std::copy_n("Breakpoint at ", 14, end);
+        Util::hexFormat(end, emulator.processor->PC->getValue(), 4);
+    }
+
+    error = message;
+    requestPause();
+}
+
+bool EmulatorThread::runBatch() {
+    uint64_t frame = emulator.processor->ppu->getFrameCount();
+
+    bool reached;
+    try {
+        reached = emulator.runTowards(run_target, RUN_BATCH_STEPS);
+    } catch (const std::exception &ex) {
+        error = ex.what();
+        run_target_active = false;
+        requestPause();
+        return false;
+    }
+
+    if (emulator.processor->ppu->getFrameCount() != frame) publishFrame();
+
+    if (reached) {
+        if (emulator.stopReason() != StopReason::None) stopForDebugger();
+        run_target_active = false;
+        requestPause();
+    }
+
+    return true;
+}
+
+void EmulatorThread::run() {
+    using clock = std::chrono::steady_clock;
+    clock::time_point deadline = clock::now();
+
+    while (running.load()) {
+        if (state.load() != State::Running) {
+            park();
+            deadline = clock::now();
+            continue;
+        }
+
+        if (run_target_active) {
+            // Unthrottled, with the cheap pause check between batches
+            if (runBatch()) publishDebugSnapshotPeriodically();
+            continue;
+        }
+
+        emulator.setButtons(buttons.load(std::memory_order_relaxed));
+
+        try {
+            if (rewinding.load(std::memory_order_relaxed)) {
+                emulator.rewindFrame();
+            } else {
+                emulator.runFrame();
+            }
+        } catch (const std::exception &ex) {
+            error = ex.what();
+            requestPause();
+            continue;
+        }
+
+        if (emulator.stopReason() != StopReason::None) {
+            stopForDebugger();
+            continue;
+        }
+
+        if (emulator.frameRendered()) publishFrame();
+        publishDebugSnapshotPeriodically();
+
+        if (!throttled.load()) continue;
+
+        deadline += Emulator::FRAME_DURATION;
+        clock::time_point now = clock::now();
+        if (deadline > now) {
+            std::this_thread::sleep_until(deadline);
+        } else if (now - deadline > std::chrono::seconds(1)) {
+            // Too far behind to catch up, don't try to
+            deadline = now;
+        }
+    }
+}
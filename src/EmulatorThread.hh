@@ -0,0 +1,181 @@
+#pragma once
+
+// System headers
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+// User headers
+#include "Emulator.hh"
+#include "PPU.hh"
+#include "Processor.hh"
+#include "SeqLock.hh"
+#include "TripleBuffer.hh"
+
+/**
+ *  A completed frame as published by the emulation thread.
+ */
+struct FrameOutput {
+    framebuffer_t pixels {};
+    uint64_t frame_number { 0 };
+};
+
+/**
+ *  Runs the emulator on a dedicated thread, paced by the host clock instead
+ *  of the display. Frames are published to a triple buffer so the GUI can
+ *  pick up the latest one without either side blocking.
+ *
+ *  While paused, the thread parks and doesn't touch the emulator. The GUI
+ *  thread may then inspect and step the emulator directly, until it calls
+ *  resume().
+ */
+class EmulatorThread {
+   public:
+    EmulatorThread(Emulator &emulator) : emulator { emulator } {}
+    ~EmulatorThread();
+
+    // Weffc++
+    EmulatorThread(const EmulatorThread &) = delete;
+    void operator=(const EmulatorThread &) = delete;
+
+    void start(bool paused = true);
+    void stop();
+
+    void pause();
+
+    /**
+     *  Runs freely again, dropping the runTo() target if there is one.
+     */
+    void resume();
+
+    /**
+     *  Pauses and waits until the thread is parked. Returns true if it was
+     *  running until this call, rather than paused already or pausing by
+     *  itself at a runTo() target.
+     */
+    bool pauseAndWait();
+
+    /**
+     *  Lets the thread carry on with what it was doing when it parked,
+     *  towards the runTo() target if it was running to one. For a short
+     *  look at the emulator between pauseAndWait() and this.
+     */
+    void unpark();
+
+    /**
+     *  Resumes, running as fast as possible until the target is reached and
+     *  then pausing again. Only call while parked. Throws
+     *  std::runtime_error while a movie is recorded or played, since its
+     *  inputs belong to whole frames.
+     */
+    void runTo(RunMode mode, uint64_t argument = 0);
+
+    /**
+     *  Steps one instruction on the calling thread. Only call while parked.
+     *  Throws std::runtime_error during a movie, like runTo().
+     */
+    void step();
+    bool isPaused() const { return state.load() != State::Running; }
+
+    /**
+     *  True when the thread is paused and guaranteed not to touch the
+     *  emulator until resume() is called.
+     */
+    bool isParked() const {
+        return state.load(std::memory_order_acquire) == State::Parked;
+    }
+
+    /**
+     *  Buttons held (Buttons bits), applied to the joypad before each
+     *  frame.
+     */
+    void setButtons(byte_t pressed) { buttons.store(pressed); }
+
+    /**
+     *  While set, frames step back through the rewind buffer instead of
+     *  forward.
+     */
+    void setRewinding(bool enabled) { rewinding.store(enabled); }
+
+    /**
+     *  Run as fast as possible instead of at the Game Boy frame rate.
+     */
+    void setThrottled(bool enabled) { throttled.store(enabled); }
+
+    TripleBuffer<FrameOutput> &frames() { return frame_buffer; }
+
+    /**
+     *  CPU state for the debug panels while running. Published at most every
+     *  DEBUG_PUBLISH_INTERVAL, and always right before the thread parks.
+     */
+    const SeqLock<DebugSnapshot> &debugSnapshot() const {
+        return debug_snapshot;
+    }
+
+    static constexpr std::chrono::milliseconds DEBUG_PUBLISH_INTERVAL { 10 };
+
+    // Steps run between checks for a pause request during runTo()
+    static constexpr unsigned RUN_BATCH_STEPS = 4096;
+
+    /**
+     *  Why emulation stopped (error, breakpoint or watchpoint), if it did. Only valid
+     *  while parked.
+     */
+    const std::string &getError() const { return error; }
+
+   private:
+    Emulator &emulator;
+    std::thread thread {};
+
+    /**
+     *  Pausing is a request the thread acknowledges by parking. Both sides
+     *  change the one state, with compare-exchange where they could race,
+     *  so a resume can never leave the thread running while it looks parked.
+     */
+    enum class State : uint8_t { Running, Pausing, Parked };
+
+    std::atomic<bool> running { false };
+    std::atomic<State> state { State::Pausing };
+    std::atomic<bool> throttled { true };
+    std::atomic<bool> rewinding { false };
+    std::atomic<byte_t> buttons { 0 };
+
+    TripleBuffer<FrameOutput> frame_buffer {};
+    std::string error {};
+
+    // Set up by runTo() while parked, so only touched by one thread at a time
+    RunTarget run_target {};
+    bool run_target_active { false };
+
+    SeqLock<DebugSnapshot> debug_snapshot {};
+    std::chrono::steady_clock::time_point next_debug_publish {};
+
+    void run();
+
+    /**
+     *  Asks the thread to park, unless it already is or is about to.
+     *  Returns true if it was running.
+     */
+    bool requestPause();
+    void park();
+    void publishFrame();
+    void publishDebugSnapshot();
+    void publishDebugSnapshotPeriodically();
+
+    /**
+     *  Runs one batch towards run_target. Returns false if emulation had to
+     *  stop because of an error.
+     */
+    bool runBatch();
+
+    /**
+     *  Pauses with the breakpoint or watchpoint as the reason.
+     */
+    void stopForDebugger();
+
+    /**
+     *  Throws std::runtime_error while a movie is recorded or played.
+     */
+    void checkNoMovie() const;
+};
@@ -0,0 +1,307 @@
+// System headers
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// User headers
+#include "Emulator.hh"
+#include "Environment.hh"
+
+namespace {
+
+constexpr unsigned SIZE = Environment::DOWNSAMPLED_SIZE;
+
+constexpr byte_t luminance(uint32_t color) {
+    return (299 * (color & 0xFF) + 587 * ((color >> 8) & 0xFF) +
+            114 * ((color >> 16) & 0xFF) + 500) /
+           1000;
+}
+
+constexpr std::array<byte_t, 4> SHADE_GRAYS {
+    luminance(LCD::SHADE_COLORS[0]), luminance(LCD::SHADE_COLORS[1]),
+    luminance(LCD::SHADE_COLORS[2]), luminance(LCD::SHADE_COLORS[3])
+};
+
+/**
+ *  How the pixels of a row or column of the screen cover the SIZE output
+ *  pixels. With both sizes divided by their GCD, a screen pixel is unit
+ *  long and an output pixel span, so overlaps are whole numbers. Every
+ *  output pixel overlaps at most 3 screen pixels, from first on; the 4th
+ *  weight is always 0.
+ */
+struct AreaTaps {
+    unsigned span { 0 };
+    std::array<uint16_t, SIZE> first {};
+    alignas(16) std::array<std::array<int16_t, 4>, SIZE> weights {};
+};
+
+constexpr AreaTaps makeAreaTaps(unsigned pixels) {
+    unsigned gcd = std::gcd(pixels, SIZE);
+    unsigned unit = SIZE / gcd;
+
+    AreaTaps taps {};
+    taps.span = pixels / gcd;
+    for (unsigned i = 0; i < SIZE; ++i) {
+        unsigned begin = i * taps.span;
+        unsigned end = begin + taps.span;
+        taps.first[i] = begin / unit;
+        for (unsigned k = 0; k < 3; ++k) {
+            unsigned from = std::max(begin, (taps.first[i] + k) * unit);
+            unsigned to = std::min(end, (taps.first[i] + k + 1) * unit);
+            taps.weights[i][k] = to > from ? to - from : 0;
+        }
+    }
+    return taps;
+}
+
+constexpr AreaTaps COLUMN_TAPS = makeAreaTaps(LCD::SCREEN_WIDTH);
+constexpr AreaTaps ROW_TAPS = makeAreaTaps(LCD::SCREEN_HEIGHT);
+
+// Sum of the weights of an output pixel, and the largest sum of weighted
+// grays
+constexpr unsigned AREA = COLUMN_TAPS.span * ROW_TAPS.span;
+constexpr unsigned MAX_SUM = 255 * AREA + AREA / 2;
+
+// Weighted column sums must fit signed 16 bits for _mm_madd_epi16
+static_assert(255 * ROW_TAPS.span <= 0x7FFF, "Column sums overflow");
+
+// The vector loops have no scalar tails
+static_assert(LCD::SCREEN_WIDTH % 16 == 0 && SIZE % 4 == 0,
+              "Sizes don't fill whole vectors");
+
+// The rounded average is ((sum + AREA / 2) >> AREA_SHIFT) * AREA_FACTOR >>
+// 16: the power of two in AREA is shifted out first, which leaves a value
+// small enough to divide by the odd rest with a 16 bit multiply
+constexpr unsigned AREA_SHIFT = __builtin_ctz(AREA);
+constexpr unsigned AREA_ODD = AREA >> AREA_SHIFT;
+constexpr unsigned AREA_FACTOR = 0x10000 / AREA_ODD + 1;
+
+constexpr bool divisionIsExact() {
+    for (unsigned x = 0; x <= (MAX_SUM >> AREA_SHIFT); ++x) {
+        if (x * AREA_FACTOR >> 16 != x / AREA_ODD) return false;
+    }
+    return AREA_FACTOR <= 0xFFFF;
+}
+static_assert(divisionIsExact(), "Downsampling division is inexact");
+
+byte_t averageOf(uint32_t sum) {
+    return ((sum + AREA / 2) >> AREA_SHIFT) * AREA_FACTOR >> 16;
+}
+
+#ifdef __SSE2__
+
+/**
+ *  Grays of 16 shades.
+ */
+__m128i grays(__m128i shades) {
+    shades = _mm_and_si128(shades, _mm_set1_epi8(0x03));
+    __m128i result = _mm_setzero_si128();
+    for (unsigned shade = 0; shade < 4; ++shade) {
+        __m128i mask = _mm_cmpeq_epi8(shades, _mm_set1_epi8((char)shade));
+        __m128i gray = _mm_set1_epi8((char)SHADE_GRAYS[shade]);
+        result = _mm_or_si128(result, _mm_and_si128(mask, gray));
+    }
+    return result;
+}
+
+#endif
+
+void toRGBA(const framebuffer_t &pixels, byte_t *out) {
+    for (size_t i = 0; i < pixels.size(); ++i) {
+        std::memcpy(out + 4 * i, &LCD::SHADE_COLORS[pixels[i] & 0x03], 4);
+    }
+}
+
+void toGrayscale(const framebuffer_t &pixels, byte_t *out) {
+#ifdef __SSE2__
+    for (size_t i = 0; i < pixels.size(); i += 16) {
+        __m128i shades =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(&pixels[i]));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), grays(shades));
+    }
+#else
+    for (size_t i = 0; i < pixels.size(); ++i) {
+        out[i] = SHADE_GRAYS[pixels[i] & 0x03];
+    }
+#endif
+}
+
+/**
+ *  Averages the grays of the screen over the area of every output pixel:
+ *  first the weighted sums of the rows under an output row, per column,
+ *  then the weighted sums of those over the columns under every output
+ *  pixel.
+ */
+void toDownsampled(const framebuffer_t &pixels, byte_t *out) {
+    // Padded for reading 4 columns from the last first column
+    alignas(16) std::array<int16_t, LCD::SCREEN_WIDTH + 8> columns {};
+    alignas(16) std::array<uint32_t, SIZE> sums {};
+
+    for (unsigned row = 0; row < SIZE; ++row) {
+        columns.fill(0);
+        for (unsigned k = 0; k < 3; ++k) {
+            int16_t weight = ROW_TAPS.weights[row][k];
+            if (weight == 0) continue;
+            const byte_t *line =
+                &pixels[(ROW_TAPS.first[row] + k) * LCD::SCREEN_WIDTH];
+
+#ifdef __SSE2__
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i factor = _mm_set1_epi16(weight);
+            for (unsigned x = 0; x < LCD::SCREEN_WIDTH; x += 16) {
+                __m128i gray = grays(_mm_loadu_si128(
+                    reinterpret_cast<const __m128i *>(line + x)));
+                for (unsigned half = 0; half < 2; ++half) {
+                    __m128i *sum =
+                        reinterpret_cast<__m128i *>(&columns[x + 8 * half]);
+                    __m128i wide = half ? _mm_unpackhi_epi8(gray, zero)
+                                        : _mm_unpacklo_epi8(gray, zero);
+                    *sum = _mm_add_epi16(*sum, _mm_mullo_epi16(wide, factor));
+                }
+            }
+#else
+            for (unsigned x = 0; x < LCD::SCREEN_WIDTH; ++x) {
+                columns[x] += weight * SHADE_GRAYS[line[x] & 0x03];
+            }
+#endif
+        }
+
+#ifdef __SSE2__
+        // Two output pixels per vector: their 4 column sums times their
+        // weights, added up pairwise by madd, then the pairs added
+        for (unsigned i = 0; i < SIZE; i += 4) {
+            __m128i pairs[2];
+            for (unsigned j = 0; j < 2; ++j) {
+                unsigned a = i + 2 * j, b = a + 1;
+                auto load = [](const void *at) {
+                    return _mm_loadl_epi64(static_cast<const __m128i *>(at));
+                };
+                __m128i values =
+                    _mm_unpacklo_epi64(load(&columns[COLUMN_TAPS.first[a]]),
+                                       load(&columns[COLUMN_TAPS.first[b]]));
+                __m128i weights = _mm_unpacklo_epi64(
+                    load(COLUMN_TAPS.weights[a].data()),
+                    load(COLUMN_TAPS.weights[b].data()));
+                pairs[j] = _mm_madd_epi16(values, weights);
+            }
+            __m128 x = _mm_castsi128_ps(pairs[0]);
+            __m128 y = _mm_castsi128_ps(pairs[1]);
+            __m128i even = _mm_castps_si128(
+                _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 0, 2, 0)));
+            __m128i odd = _mm_castps_si128(
+                _mm_shuffle_ps(x, y, _MM_SHUFFLE(3, 1, 3, 1)));
+            _mm_store_si128(reinterpret_cast<__m128i *>(&sums[i]),
+                            _mm_add_epi32(even, odd));
+        }
+#else
+        for (unsigned i = 0; i < SIZE; ++i) {
+            uint32_t sum = 0;
+            for (unsigned k = 0; k < 3; ++k) {
+                sum += COLUMN_TAPS.weights[i][k] *
+                       columns[COLUMN_TAPS.first[i] + k];
+            }
+            sums[i] = sum;
+        }
+#endif
+
+        byte_t *line = out + row * SIZE;
+        unsigned i = 0;
+#ifdef __SSE2__
+        const __m128i half = _mm_set1_epi32(AREA / 2);
+        const __m128i factor = _mm_set1_epi16((short)AREA_FACTOR);
+        for (; i + 8 <= SIZE; i += 8) {
+            __m128i low = _mm_load_si128(
+                reinterpret_cast<const __m128i *>(&sums[i]));
+            __m128i high = _mm_load_si128(
+                reinterpret_cast<const __m128i *>(&sums[i + 4]));
+            low = _mm_srli_epi32(_mm_add_epi32(low, half), AREA_SHIFT);
+            high = _mm_srli_epi32(_mm_add_epi32(high, half), AREA_SHIFT);
+            __m128i average =
+                _mm_mulhi_epu16(_mm_packs_epi32(low, high), factor);
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(line + i),
+                             _mm_packus_epi16(average, average));
+        }
+#endif
+        for (; i < SIZE; ++i) line[i] = averageOf(sums[i]);
+    }
+}
+
+}  // namespace
+
+Environment::Environment(ptr<Emulator> emulator, ObservationFormat format,
+                         unsigned frames_per_step)
+    : emulator { std::move(emulator) },
+      format { format },
+      frames_per_step { frames_per_step } {
+    if (frames_per_step == 0) {
+        throw std::runtime_error("An environment step needs frames");
+    }
+    if (format != ObservationFormat::Shades) buffer.resize(observationSize());
+
+    setStartState();
+    observe();
+}
+
+unsigned Environment::width() const {
+    return format == ObservationFormat::Downsampled ? SIZE
+                                                    : LCD::SCREEN_WIDTH;
+}
+
+unsigned Environment::height() const {
+    return format == ObservationFormat::Downsampled ? SIZE
+                                                    : LCD::SCREEN_HEIGHT;
+}
+
+unsigned Environment::channels() const {
+    return format == ObservationFormat::RGBA ? 4 : 1;
+}
+
+void Environment::setStartState() {
+    start_state.resize(emulator->stateSize());
+    start_state.resize(
+        emulator->saveState(start_state.data(), start_state.size()));
+}
+
+void Environment::reset() {
+    emulator->loadState(start_state.data(), start_state.size());
+    observe();
+}
+
+Environment::Step Environment::step(byte_t action) {
+    emulator->setButtons(action);
+    emulator->skipNextFrames(frames_per_step - 1);
+    for (unsigned frame = 0; frame < frames_per_step; ++frame) {
+        emulator->runFrame();
+    }
+    observe();
+
+    Step result {};
+    if (reward) result.reward = reward(*emulator);
+    if (done) result.done = done(*emulator);
+    return result;
+}
+
+void Environment::observe() {
+    const framebuffer_t &pixels = emulator->getFramebuffer();
+    switch (format) {
+        case ObservationFormat::RGBA:
+            toRGBA(pixels, buffer.data());
+            break;
+        case ObservationFormat::Grayscale:
+            toGrayscale(pixels, buffer.data());
+            break;
+        case ObservationFormat::Downsampled:
+            toDownsampled(pixels, buffer.data());
+            break;
+        case ObservationFormat::Shades:
+            observed = pixels.data();
+            return;
+    }
+    observed = buffer.data();
+}
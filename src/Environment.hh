@@ -0,0 +1,108 @@
+#pragma once
+
+// System headers
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// User headers
+#include "Constants.hh"
+
+class Emulator;
+
+/**
+ *  What an Environment observes after every step.
+ */
+enum class ObservationFormat : uint8_t {
+    RGBA,         // The screen in the colors of the GUI, 4 bytes per pixel
+    Grayscale,    // The luminance of those colors, 1 byte per pixel
+    Downsampled,  // Grayscale, averaged down to 84x84 pixels
+    Shades        // The framebuffer itself, shades 0-3
+};
+
+/**
+ *  Reinforcement learning style interface to an emulator: every step holds
+ *  the buttons of an action for a few frames and observes the last one.
+ *  Only that frame is rendered, and the observation is made from the
+ *  framebuffer directly in the format asked for, so no other format is
+ *  ever produced.
+ *
+ *  Rewards and the end of an episode are up to the game, so they come from
+ *  hooks that usually read the game's memory.
+ */
+class Environment {
+   public:
+    static constexpr unsigned DOWNSAMPLED_SIZE = 84;
+
+    // Called once the frames of a step have run
+    using reward_function = std::function<double(const Emulator &)>;
+    using done_function = std::function<bool(const Emulator &)>;
+
+    struct Step {
+        double reward { 0 };
+        bool done { false };
+    };
+
+    /**
+     *  Steps emulator frames_per_step frames at a time, starting episodes
+     *  from its current state. Throws std::runtime_error if frames_per_step
+     *  is 0.
+     */
+    Environment(ptr<Emulator> emulator, ObservationFormat format,
+                unsigned frames_per_step = 4);
+
+    // Weffc++
+    Environment(const Environment &) = delete;
+    void operator=(const Environment &) = delete;
+
+    void setReward(reward_function function) { reward = std::move(function); }
+    void setDone(done_function function) { done = std::move(function); }
+
+    /**
+     *  Starts episodes from the current state of the emulator from now on,
+     *  e.g. once past the title screen.
+     */
+    void setStartState();
+
+    /**
+     *  Goes back to the start state and observes it.
+     */
+    void reset();
+
+    /**
+     *  Runs frames_per_step frames with action (Buttons bits) held and
+     *  observes the last one. Stepping on after the episode is done keeps
+     *  running the game.
+     */
+    Step step(byte_t action);
+
+    /**
+     *  The last observation, valid until the next step or reset. Rows of
+     *  width() pixels of channels() bytes each.
+     */
+    const byte_t *observation() const { return observed; }
+    size_t observationSize() const {
+        return (size_t)width() * height() * channels();
+    }
+
+    unsigned width() const;
+    unsigned height() const;
+    unsigned channels() const;
+
+    ptr<Emulator> emulator;
+
+   private:
+    ObservationFormat format;
+    unsigned frames_per_step;
+
+    reward_function reward {};
+    done_function done {};
+
+    std::vector<byte_t> start_state {};
+
+    // Holds the observation, unless the framebuffer itself is observed
+    std::vector<byte_t> buffer {};
+    const byte_t *observed { nullptr };
+
+    void observe();
+};
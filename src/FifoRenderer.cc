@@ -0,0 +1,161 @@
+#include "FifoRenderer.hh"
+
+unsigned FifoRenderer::beginLine() {
+    line = {};
+    line.discard = state.scx % 8;
+    line.initial_fetch = true;
+    line.fetch_tile_x = state.scx / 8;
+
+    // Run the line without output, with the registers as they are now
+    LineState dry_run = line;
+    while (dry_run.x < LCD::SCREEN_WIDTH &&
+           dry_run.dot < LCD::DOTS_PER_LINE - LCD::OAM_SCAN_DOTS) {
+        tick(dry_run, false);
+    }
+
+    return dry_run.dot;
+}
+
+void FifoRenderer::renderUpTo(unsigned dot) {
+    if (!state.output_wanted) return skipLine();
+
+    while (line.dot < dot && line.x < LCD::SCREEN_WIDTH) tick(line, true);
+}
+
+void FifoRenderer::finishLine() {
+    if (!state.output_wanted) return skipLine();
+
+    // Bounded in case registers changed mid-line in a way that stalls it
+    while (line.x < LCD::SCREEN_WIDTH &&
+           line.dot < LCD::DOTS_PER_LINE - LCD::OAM_SCAN_DOTS) {
+        tick(line, true);
+    }
+}
+
+void FifoRenderer::tick(LineState &l, bool output) const {
+    l.dot++;
+
+    // The background fetcher is paused while a sprite is fetched
+    if (l.sprite_dots > 0) {
+        if (--l.sprite_dots == 0) mergeSprite(l);
+        return;
+    }
+
+    if (l.bg_size > 0) {
+        bool window_starts = !l.fetching_window && l.discard == 0 &&
+                             windowOnLine() && l.x + 7 >= state.wx;
+        int sprite = l.discard == 0 ? pendingSprite(l) : -1;
+
+        if (window_starts) {
+            // Throw away the background and restart the fetcher
+            l.bg_size = 0;
+            l.fetching_window = true;
+            l.fetch_step = 0;
+            l.fetch_tile_x = 0;
+            if (output) state.window_drawn = true;
+        } else if (sprite >= 0) {
+            // Wait for the current background fetch before the sprite fetch
+            if (l.fetch_step == FETCH_DOTS) {
+                l.sprite_index = (unsigned)sprite;
+                l.sprite_dots = SPRITE_FETCH_DOTS;
+                return;
+            }
+        } else {
+            byte_t color = l.bg_fifo[l.bg_head];
+            l.bg_head = (l.bg_head + 1) % l.bg_fifo.size();
+            l.bg_size--;
+
+            if (l.discard > 0) {
+                l.discard--;
+            } else {
+                SpritePixel sprite_pixel = l.obj_fifo[l.obj_head];
+                l.obj_fifo[l.obj_head] = {};
+                l.obj_head = (l.obj_head + 1) % l.obj_fifo.size();
+
+                if (output) {
+                    if (!(state.lcdc & LCD::LCDC_BG_ENABLE)) color = 0;
+
+                    byte_t shade = applyPalette(state.bgp, color);
+                    if (sprite_pixel.color != 0 &&
+                        (!sprite_pixel.bg_priority || color == 0)) {
+                        shade = applyPalette(
+                            sprite_pixel.obp1 ? state.obp1 : state.obp0,
+                            sprite_pixel.color);
+                    }
+                    framebuffer[state.line * LCD::SCREEN_WIDTH + l.x] = shade;
+                }
+                l.x++;
+            }
+        }
+    }
+
+    advanceFetcher(l);
+}
+
+void FifoRenderer::advanceFetcher(LineState &l) const {
+    if (l.fetch_step < FETCH_DOTS) l.fetch_step++;
+    if (l.fetch_step < FETCH_DOTS || l.bg_size > 0) return;
+
+    // Push, the FIFO is empty
+    l.fetch_step = 0;
+    if (l.initial_fetch) {
+        // The first fetch of every line is thrown away
+        l.initial_fetch = false;
+        return;
+    }
+
+    TileRow row;
+    if (l.fetching_window) {
+        row = fetchBackgroundRow(windowMap(), l.fetch_tile_x,
+                                 state.window_line);
+    } else {
+        row = fetchBackgroundRow(backgroundMap(), l.fetch_tile_x % 32,
+                                 (byte_t)(state.line + state.scy));
+    }
+    l.fetch_tile_x = (l.fetch_tile_x + 1) % 32;
+
+    for (unsigned bit = 0; bit < 8; ++bit) {
+        unsigned index = (l.bg_head + l.bg_size) % l.bg_fifo.size();
+        l.bg_fifo[index] = tileRowPixel(row, 7 - bit);
+        l.bg_size++;
+    }
+}
+
+void FifoRenderer::mergeSprite(LineState &l) const {
+    byte_t oam_index = state.sprites[l.sprite_index];
+    l.sprite_done[l.sprite_index] = true;
+
+    register16_t entry = LCD::OAM_START + oam_index * 4;
+    int sprite_x = memory.peek(entry + 1) - 8;
+    byte_t attributes = memory.peek(entry + 3);
+    TileRow row = fetchSpriteRow(oam_index);
+
+    // Sprites partly left of the screen start at their first visible pixel
+    unsigned first = sprite_x < 0 ? (unsigned)-sprite_x : 0;
+
+    for (unsigned px = first; px < 8; ++px) {
+        unsigned bit = (attributes & 0x20) ? px : 7 - px;
+        byte_t color = tileRowPixel(row, bit);
+
+        // Earlier sprites win, only transparent slots are replaced
+        SpritePixel &slot =
+            l.obj_fifo[(l.obj_head + px - first) % l.obj_fifo.size()];
+        if (slot.color != 0 || color == 0) continue;
+
+        slot = { color, (attributes & 0x10) != 0, (attributes & 0x80) != 0 };
+    }
+}
+
+int FifoRenderer::pendingSprite(const LineState &l) const {
+    if (!(state.lcdc & LCD::LCDC_OBJ_ENABLE)) return -1;
+
+    for (unsigned s = 0; s < state.sprite_count; ++s) {
+        if (l.sprite_done[s]) continue;
+
+        int sprite_x = memory.peek(LCD::OAM_START + state.sprites[s] * 4 + 1);
+        int start = sprite_x < 8 ? 0 : sprite_x - 8;
+        if (start == (int)l.x) return (int)s;
+    }
+
+    return -1;
+}
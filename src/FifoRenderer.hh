@@ -0,0 +1,78 @@
+#pragma once
+
+// System headers
+#include <array>
+
+// User headers
+#include "PPURenderer.hh"
+
+/**
+ *  Dot accurate renderer modelled on the hardware pixel FIFO. A background
+ *  fetcher fills a FIFO that shifts out one pixel per dot, so pixel transfer
+ *  gets longer with fine scroll (SCX % 8 discarded pixels), when the window
+ *  starts (the fetcher restarts) and for every sprite (the fetcher is
+ *  paused while the sprite is fetched).
+ */
+class FifoRenderer : public PPURenderer {
+   public:
+    using PPURenderer::PPURenderer;
+
+    unsigned beginLine() override;
+    void renderUpTo(unsigned dot) override;
+    void finishLine() override;
+
+   private:
+    // Dots for the three fetch steps (tile number, data low, data high)
+    static constexpr unsigned FETCH_DOTS = 6;
+    static constexpr unsigned SPRITE_FETCH_DOTS = 6;
+
+    struct SpritePixel {
+        byte_t color;
+        bool obp1;
+        bool bg_priority;
+    };
+
+    struct LineState {
+        // Dots of pixel transfer done, and the next pixel to output
+        unsigned dot;
+        unsigned x;
+
+        // Pixels left to throw away for fine scroll
+        unsigned discard;
+
+        // Background fetcher
+        unsigned fetch_step;
+        byte_t fetch_tile_x;
+        bool initial_fetch;
+        bool fetching_window;
+
+        std::array<byte_t, 16> bg_fifo;
+        unsigned bg_head;
+        unsigned bg_size;
+
+        // Sprite FIFO, aligned with the next pixel to output
+        std::array<SpritePixel, 8> obj_fifo;
+        unsigned obj_head;
+
+        unsigned sprite_dots;
+        unsigned sprite_index;
+        std::array<bool, LCD::MAX_SPRITES_PER_LINE> sprite_done;
+    };
+
+    LineState line {};
+
+    /**
+     *  Advances the line by one dot. With output false nothing is written to
+     *  the framebuffer, used to find the length of pixel transfer.
+     */
+    void tick(LineState &l, bool output) const;
+
+    void advanceFetcher(LineState &l) const;
+    void mergeSprite(LineState &l) const;
+
+    /**
+     *  Returns the index (into state.sprites) of a sprite that starts at the
+     *  current pixel and has not been fetched, or -1.
+     */
+    int pendingSprite(const LineState &l) const;
+};
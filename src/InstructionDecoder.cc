@@ -33,6 +33,16 @@ void InstructionDecoder::executeCBInstruction(opcode_t opcode) {
 }
 
 void InstructionDecoder::step(bool verbose) {
+    if (cpu->halted) {
+        skipHalted();
+        serviceInterrupts();
+        return;
+    }
+
+    // EI only applies once the instruction after it is done, unless that
+    // is DI, which cancels it
+    bool enable_interrupts = cpu->interrupt_enable_pending;
+
     opcode_t instruction = cpu->fetchInstruction();
     PC->increment();
     // TODO check if cycles should be added after instruction execution
@@ -53,6 +63,16 @@ void InstructionDecoder::step(bool verbose) {
         cpu->executed_instructions++;
     }
 
+    if (cpu->clock_cycles >= cpu->scheduler.nextEventCycle()) {
+        cpu->scheduler.runUntil(cpu->clock_cycles);
+    }
+
+    if (enable_interrupts && cpu->interrupt_enable_pending) {
+        cpu->interrupts_enabled = true;
+        cpu->interrupt_enable_pending = false;
+    }
+    serviceInterrupts();
+
     if (verbose) {
         cpu->dump();
         cpu->printStack();
@@ -60,6 +80,49 @@ void InstructionDecoder::step(bool verbose) {
     }
 }
 
+bool InstructionDecoder::serviceInterrupts() {
+    byte_t pending = cpu->pendingInterrupts();
+    if (!pending) return false;
+
+    // Pending interrupts end HALT even when they won't be dispatched
+    cpu->halted = false;
+    if (!cpu->interrupts_enabled) return false;
+
+    // Lowest bit has the highest priority, and vectors are 8 bytes apart
+    unsigned bit = 0;
+    while (!(pending & (1 << bit))) ++bit;
+
+    byte_t flags = program_memory->getData(IF_ADDRESS);
+    program_memory->setData(IF_ADDRESS, flags & ~(1 << bit));
+    cpu->interrupts_enabled = false;
+
+    pushStack(PC);
+    PC->setValue(INTERRUPT_VECTOR_BASE + bit * 8);
+    cpu->add_machine_cycles(5);
+    cpu->serviced_interrupts++;
+    calledFunction();
+
+    if (cpu->clock_cycles >= cpu->scheduler.nextEventCycle()) {
+        cpu->scheduler.runUntil(cpu->clock_cycles);
+    }
+
+    return true;
+}
+
+void InstructionDecoder::skipHalted() {
+    uint64_t next_event = cpu->scheduler.nextEventCycle();
+
+    unsigned machine_cycles = 1;
+    if (next_event != Scheduler::NO_EVENT && next_event > cpu->clock_cycles) {
+        machine_cycles = (next_event - cpu->clock_cycles + 3) / 4;
+    }
+    cpu->add_machine_cycles(machine_cycles);
+
+    if (cpu->clock_cycles >= cpu->scheduler.nextEventCycle()) {
+        cpu->scheduler.runUntil(cpu->clock_cycles);
+    }
+}
+
 void InstructionDecoder::map_opcode_functions() {
     this->map_regular_opcodes();
     this->map_cb_opcodes();
@@ -5,6 +5,7 @@
 #include <memory>
 
 // User headers
+#include "CallProfiler.hh"
 #include "Constants.hh"
 #include "Memory.hh"
 #include "Processor.hh"
@@ -36,7 +37,40 @@ class InstructionDecoder {
      */
     void step(bool verbose = false);
 
+    // Told about every call and return while set
+    ptr<CallProfiler> call_profiler {};
+
    private:
+    /**
+     *  Wakes the CPU from HALT if any interrupt is pending, and dispatches
+     *  the one with the highest priority if interrupts are enabled. Returns
+     *  true if an interrupt was dispatched.
+     */
+    bool serviceInterrupts();
+
+    /**
+     *  While halted nothing executes, so time skips ahead to the next
+     *  scheduled event, the first point where an interrupt could be raised.
+     */
+    void skipHalted();
+
+    /**
+     *  Reports a call that just jumped to PC, with its return address on top
+     *  of the stack, to the call profiler.
+     */
+    void calledFunction() {
+        if (call_profiler) {
+            call_profiler->enter(PC->getValue(), SP->getValue());
+        }
+    }
+
+    /**
+     *  Reports a return that just popped PC to the call profiler.
+     */
+    void returnedFromFunction() {
+        if (call_profiler) call_profiler->leave(SP->getValue() - 2);
+    }
+
     // Keep pointer to CPU and registers
     ptr<Processor> cpu;
 
@@ -0,0 +1,31 @@
+// User headers
+#include "Joypad.hh"
+#include "Processor.hh"
+
+Joypad::Joypad(Processor &cpu) : cpu { cpu } {
+    cpu.program_memory->mapIO(P1, this);
+}
+
+byte_t Joypad::inputLines(byte_t buttons) const {
+    byte_t pressed = 0;
+    if (!(state.select & 0x10)) pressed |= buttons & 0x0F;
+    if (!(state.select & 0x20)) pressed |= buttons >> 4;
+    return ~pressed & 0x0F;
+}
+
+byte_t Joypad::readIO(register16_t) {
+    // The upper two bits aren't connected and read as 1
+    return 0xC0 | state.select | inputLines(state.buttons);
+}
+
+void Joypad::writeIO(register16_t, byte_t data) {
+    state.select = data & 0x30;
+}
+
+void Joypad::setButtons(byte_t pressed) {
+    byte_t before = inputLines(state.buttons);
+    state.buttons = pressed;
+
+    // Any selected line going from high to low
+    if (before & ~inputLines(pressed)) cpu.requestInterrupt(INTERRUPT_JOYPAD);
+}
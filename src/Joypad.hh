@@ -0,0 +1,71 @@
+#pragma once
+
+// System headers
+#include <cstdint>
+
+// User headers
+#include "Constants.hh"
+#include "Memory.hh"
+
+class Processor;
+
+namespace Buttons {
+// Bits of the pressed button mask given to Joypad::setButtons
+constexpr const byte_t RIGHT = 0x01;
+constexpr const byte_t LEFT = 0x02;
+constexpr const byte_t UP = 0x04;
+constexpr const byte_t DOWN = 0x08;
+constexpr const byte_t A = 0x10;
+constexpr const byte_t B = 0x20;
+constexpr const byte_t SELECT = 0x40;
+constexpr const byte_t START = 0x80;
+}  // namespace Buttons
+
+/**
+ *  Everything the joypad needs to resume, kept as plain data.
+ */
+struct JoypadState {
+    // Bits 4 (directions) and 5 (actions) of P1, a group is selected when 0
+    byte_t select { 0x30 };
+
+    // Pressed buttons, as Buttons bits
+    byte_t buttons { 0x00 };
+};
+
+/**
+ *  The joypad register P1 (0xFF00). The CPU selects the direction and/or the
+ *  action buttons with bits 4 and 5, and reads the selected ones in the lower
+ *  four bits, 0 meaning pressed.
+ */
+class Joypad : public IOHandler {
+   public:
+    static constexpr register16_t P1 = 0xFF00;
+
+    Joypad(Processor &cpu);
+
+    // Weffc++
+    Joypad(const Joypad &) = delete;
+    void operator=(const Joypad &) = delete;
+
+    byte_t readIO(register16_t address) override;
+    void writeIO(register16_t address, byte_t data) override;
+
+    /**
+     *  Sets which buttons are held. Requests the joypad interrupt when a
+     *  selected button goes down.
+     */
+    void setButtons(byte_t pressed);
+    byte_t getButtons() const { return state.buttons; }
+
+    const JoypadState &getState() const { return state; }
+    void restoreState(const JoypadState &saved) { state = saved; }
+
+   private:
+    Processor &cpu;
+    JoypadState state {};
+
+    /**
+     *  Lower four bits of P1 for the given buttons, 0 meaning pressed.
+     */
+    byte_t inputLines(byte_t buttons) const;
+};
@@ -1,11 +1,175 @@
+// System headers
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+// User headers
 #include "Memory.hh"
 
-Memory::Memory(const unsigned size) { this->memory.reserve(size); }
+namespace {
+
+/**
+ *  The page every memory starts out with, never written to: it's always
+ *  shared, so the first write to it makes a copy.
+ */
+const std::shared_ptr<std::array<byte_t, Memory::PAGE_SIZE>> &zeroPage() {
+    static const auto page =
+        std::make_shared<std::array<byte_t, Memory::PAGE_SIZE>>();
+    return page;
+}
+
+}  // namespace
+
+Memory::Memory(const unsigned size)
+    : size_in_pages { std::min(size / PAGE_SIZE, NUMBER_OF_PAGES) } {
+    for (unsigned page = 0; page < size_in_pages; ++page) {
+        storage[page] = zeroPage();
+        page_data[page] = storage[page]->data();
+    }
+    updatePages();
+}
+
+byte_t *Memory::writablePage(unsigned page) {
+    if (storage[page].use_count() > 1) {
+        storage[page] = std::make_shared<Page>(*storage[page]);
+        page_data[page] = storage[page]->data();
+    }
+
+    // Also when the clones sharing it are gone
+    if (!write_pages[page]) updatePage(page);
+
+    return page_data[page];
+}
+
+void Memory::copyTo(byte_t *out) const {
+    for (unsigned page = 0; page < size_in_pages; ++page) {
+        std::memcpy(out + page * PAGE_SIZE, page_data[page], PAGE_SIZE);
+    }
+}
+
+void Memory::copyFrom(const byte_t *in) {
+    for (unsigned page = 0; page < size_in_pages; ++page) {
+        const byte_t *bytes = in + page * PAGE_SIZE;
+        if (std::memcmp(page_data[page], bytes, PAGE_SIZE) == 0) continue;
+        std::memcpy(writablePage(page), bytes, PAGE_SIZE);
+    }
+
+    markAllDirty();
+    rehash();
+}
+
+void Memory::shareFrom(Memory &source) {
+    for (unsigned page = 0; page < size_in_pages; ++page) {
+        storage[page] = source.storage[page];
+        page_data[page] = storage[page]->data();
+    }
+
+    // Neither may write to the shared pages directly any more
+    updatePages();
+    source.updatePages();
+
+    markAllDirty();
+    hashing = source.hashing;
+    content_hash = source.content_hash;
+}
+
+byte_t Memory::slowRead(const register16_t address) {
+    byte_t value = page_data[address >> 8][address & 0xFF];
+
+    if ((address & 0xFF00) == RAM_DATA_OFFSET) {
+        IOHandler *handler = io_handlers[address & 0xFF];
+        if (handler) value = handler->readIO(address);
+    }
+
+    checkWatchpoints(address, value, WATCH_READ);
+    return value;
+}
+
+void Memory::slowWrite(const register16_t address, byte_t data) {
+    checkWatchpoints(address, data, WATCH_WRITE);
+
+    if ((address & 0xFF00) == RAM_DATA_OFFSET) {
+        IOHandler *handler = io_handlers[address & 0xFF];
+        if (handler) return handler->writeIO(address, data);
+    }
+
+    byte_t &stored = writablePage(address >> 8)[address & 0xFF];
+    if (hashing) updateHash(address, stored, data);
+    stored = data;
+}
+
+void Memory::checkWatchpoints(register16_t address, byte_t value,
+                              byte_t access) {
+    if (watchpoint_hit) return;
+
+    for (const Watchpoint &watchpoint : watchpoints) {
+        if ((watchpoint.access & access) && address >= watchpoint.start &&
+            address <= watchpoint.end) {
+            watchpoint_hit = true;
+            first_hit = { address, value, access };
+            return;
+        }
+    }
+}
+
+void Memory::setHashing(bool enabled) {
+    hashing = enabled;
+    rehash();
+}
+
+uint64_t Memory::fullHash() const {
+    uint64_t hash = 0;
+    for (size_t address = 0; address < size(); ++address) {
+        hash ^= zobristKey(address, peek(address));
+    }
+    return hash;
+}
+
+void Memory::mapIO(const register16_t address, IOHandler *handler) {
+    io_handlers[address & 0xFF] = handler;
 
-byte_t Memory::getData(const register16_t address) {
-    return this->memory[address];
+    io_mapped = false;
+    for (IOHandler *mapped : io_handlers) {
+        if (mapped) io_mapped = true;
+    }
+    updatePages();
 }
 
-void Memory::setData(const register16_t address, byte_t data) {
-    this->memory[address] = data;
-}
\ No newline at end of file
+void Memory::addWatchpoint(register16_t start, register16_t end,
+                           byte_t access) {
+    if (end < start) std::swap(start, end);
+    watchpoints.push_back({ start, end, access });
+    updatePages();
+}
+
+void Memory::removeWatchpoint(size_t index) {
+    if (index >= watchpoints.size()) return;
+    watchpoints.erase(watchpoints.begin() + index);
+    updatePages();
+}
+
+bool Memory::takeWatchpointHit(WatchpointHit &hit) {
+    if (!watchpoint_hit) return false;
+
+    hit = first_hit;
+    watchpoint_hit = false;
+    return true;
+}
+
+void Memory::updatePage(unsigned page) {
+    bool checked = io_mapped && page == (RAM_DATA_OFFSET >> 8);
+    for (const Watchpoint &watchpoint : watchpoints) {
+        if (page >= (unsigned)(watchpoint.start >> 8) &&
+            page <= (unsigned)(watchpoint.end >> 8)) {
+            checked = true;
+        }
+    }
+
+    bool shared = storage[page].use_count() != 1;
+    read_pages[page] = checked ? nullptr : page_data[page];
+    write_pages[page] = checked || shared ? nullptr : page_data[page];
+}
+
+void Memory::updatePages() {
+    for (unsigned page = 0; page < NUMBER_OF_PAGES; ++page) updatePage(page);
+}
@@ -1,18 +1,244 @@
 #pragma once
+#include <array>
+#include <cstdint>
 #include <iostream>
+#include <memory>
 #include <vector>
 
 #include "Constants.hh"
+#include "Utility.hh"
 
+/**
+ *  Interface for hardware that handles reads and writes to its IO registers
+ *  itself instead of them being stored in plain memory.
+ */
+class IOHandler {
+   public:
+    virtual ~IOHandler() = default;
+    virtual byte_t readIO(register16_t address) = 0;
+    virtual void writeIO(register16_t address, byte_t data) = 0;
+};
+
+// Watchpoint access types, can be combined
+constexpr const byte_t WATCH_READ = 0x01;
+constexpr const byte_t WATCH_WRITE = 0x02;
+
+/**
+ *  Watched address range, both ends inclusive.
+ */
+struct Watchpoint {
+    register16_t start;
+    register16_t end;
+    byte_t access;
+};
+
+/**
+ *  The access that triggered a watchpoint.
+ */
+struct WatchpointHit {
+    register16_t address;
+    byte_t value;
+    byte_t access;
+};
+
+/**
+ *  Memory is accessed through tables of 256 byte pages. Plain pages point
+ *  straight into the memory, and reads and writes to them are a single
+ *  lookup. Pages that need checking (mapped IO registers, watched
+ *  addresses) are left out of the tables and go through a slow path instead,
+ *  so the cost of a watchpoint is only paid on its own page.
+ *
+ *  Pages are refcounted and copied on write, so clones of a memory (see
+ *  shareFrom()) only pay for the pages they change. Shared pages are left
+ *  out of the write table, and the first write to one takes the slow path,
+ *  which copies it. Memory starts out sharing a single page of zeros.
+ */
 class Memory {
    public:
     Memory(const unsigned size);
-    void setData(const register16_t address, byte_t data);
-    byte_t getData(const register16_t address);
 
-    // Use only for testing!!
-    std::vector<byte_t> &_get_mem_vector() { return memory; }
+    // Weffc++ (tables point into the pages)
+    Memory(const Memory &) = delete;
+    void operator=(const Memory &) = delete;
+
+    void setData(const register16_t address, byte_t data) {
+        markDirty(address);
+
+        byte_t *page = write_pages[address >> 8];
+        if (page) {
+            byte_t &stored = page[address & 0xFF];
+            if (hashing) updateHash(address, stored, data);
+            stored = data;
+        } else {
+            slowWrite(address, data);
+        }
+    }
+
+    byte_t getData(const register16_t address) {
+        const byte_t *page = read_pages[address >> 8];
+        if (page) return page[address & 0xFF];
+        return slowRead(address);
+    }
+
+    /**
+     *  Reads the stored byte without going through any IO handler. Meant for
+     *  hardware that reads memory directly, such as the PPU reading VRAM.
+     */
+    byte_t peek(const register16_t address) const {
+        return page_data[address >> 8][address & 0xFF];
+    }
+
+    /**
+     *  Routes reads and writes of the IO register at address (0xFF00-0xFFFF)
+     *  to handler. Pass nullptr to map the address back to plain memory.
+     */
+    void mapIO(const register16_t address, IOHandler *handler);
+
+    /**
+     *  Watchpoints trigger on reads and/or writes (WATCH_READ, WATCH_WRITE)
+     *  through getData() and setData(). Not thread safe, only change them
+     *  while nothing runs.
+     */
+    void addWatchpoint(register16_t start, register16_t end, byte_t access);
+    void removeWatchpoint(size_t index);
+    const std::vector<Watchpoint> &getWatchpoints() const {
+        return watchpoints;
+    }
+    bool hasWatchpoints() const { return !watchpoints.empty(); }
+
+    /**
+     *  Whether a watchpoint triggered since the last call, and if so which
+     *  access triggered it first.
+     */
+    bool takeWatchpointHit(WatchpointHit &hit);
+
+    /**
+     *  Forgets a hit left over from stepping without checks.
+     */
+    void clearWatchpointHit() { watchpoint_hit = false; }
+
+    /**
+     *  Saving and restoring the whole memory at once, bypassing IO handlers
+     *  and watchpoints. copyFrom() only touches pages whose contents change,
+     *  so they stay shared otherwise.
+     */
+    void copyTo(byte_t *out) const;
+    void copyFrom(const byte_t *in);
+    size_t size() const { return size_in_pages * PAGE_SIZE; }
+
+    /**
+     *  The stored bytes of one page, read only.
+     */
+    const byte_t *pageData(unsigned page) const { return page_data[page]; }
+
+    /**
+     *  Shares all pages of source, which must have the same size, replacing
+     *  the contents of this memory, and takes over its hash (see
+     *  setHashing()). Both copy a page on their next write to it. IO
+     *  mappings and watchpoints stay as they are on both. Only call while
+     *  neither is in use.
+     */
+    void shareFrom(Memory &source);
+
+    /**
+     *  Pages written through setData() since the last clearDirtyPages(), as
+     *  one bit per page. copyFrom() and shareFrom() mark every page.
+     */
+    bool isDirty(unsigned page) const {
+        return (dirty[page >> 6] >> (page & 63)) & 1;
+    }
+    void clearDirtyPages() { dirty = {}; }
+    void markAllDirty() { dirty.fill(~uint64_t(0)); }
+
+    /**
+     *  Zobrist hash of the contents, kept up to date by every write while
+     *  hashing is enabled: a write XORs out the key of the old byte at its
+     *  address and XORs in the key of the new one, so reading it is O(1)
+     *  however much memory there is. copyFrom() rehashes.
+     */
+    void setHashing(bool enabled);
+    bool isHashing() const { return hashing; }
+
+    /**
+     *  The Zobrist hash, computed in full when hashing isn't enabled.
+     */
+    uint64_t contentHash() const {
+        return hashing ? content_hash : fullHash();
+    }
+
+    /**
+     *  The Zobrist hash computed from scratch, which the kept up to date
+     *  one must always equal.
+     */
+    uint64_t fullHash() const;
+
+    /**
+     *  Hashes all of memory again, if hashing is enabled.
+     */
+    void rehash() {
+        if (hashing) content_hash = fullHash();
+    }
+
+    /**
+     *  Key of value stored at address. Derived from both on the fly, which
+     *  is cheaper than a 64K x 256 table that wouldn't fit in any cache.
+     */
+    static uint64_t zobristKey(register16_t address, byte_t value) {
+        return Util::splitmix64((uint64_t)address << 8 | value);
+    }
+
+    static constexpr unsigned PAGE_SIZE = 0x100;
+    static constexpr unsigned NUMBER_OF_PAGES = 0x100;
 
    private:
-    std::vector<byte_t> memory {};
+    using Page = std::array<byte_t, PAGE_SIZE>;
+
+    unsigned size_in_pages;
+
+    // The pages, possibly shared with clones, and their bytes
+    std::array<std::shared_ptr<Page>, NUMBER_OF_PAGES> storage {};
+    std::array<byte_t *, NUMBER_OF_PAGES> page_data {};
+
+    // Direct pointer to each page, or nullptr if it takes the slow path.
+    // Shared pages can be read directly but not written.
+    std::array<const byte_t *, NUMBER_OF_PAGES> read_pages {};
+    std::array<byte_t *, NUMBER_OF_PAGES> write_pages {};
+
+    // One bit per page, a single OR per write
+    std::array<uint64_t, NUMBER_OF_PAGES / 64> dirty {};
+
+    void markDirty(register16_t address) {
+        dirty[address >> 14] |= uint64_t(1) << ((address >> 8) & 63);
+    }
+
+    bool hashing { false };
+    uint64_t content_hash { 0 };
+
+    void updateHash(register16_t address, byte_t old_value, byte_t value) {
+        content_hash ^= zobristKey(address, old_value) ^
+                        zobristKey(address, value);
+    }
+
+    std::array<IOHandler *, 0x100> io_handlers {};
+    bool io_mapped { false };
+
+    std::vector<Watchpoint> watchpoints {};
+    bool watchpoint_hit { false };
+    WatchpointHit first_hit {};
+
+    /**
+     *  The bytes of page, copied first if it's shared.
+     */
+    byte_t *writablePage(unsigned page);
+
+    byte_t slowRead(const register16_t address);
+    void slowWrite(const register16_t address, byte_t data);
+    void checkWatchpoints(register16_t address, byte_t value, byte_t access);
+
+    /**
+     *  Rebuilds the page tables after pages, IO mappings or watchpoints
+     *  changed.
+     */
+    void updatePage(unsigned page);
+    void updatePages();
 };
@@ -0,0 +1,56 @@
+// System headers
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+// User headers
+#include "Movie.hh"
+
+constexpr char Movie::MAGIC[8];
+
+void Movie::save(const std::string &filename) const {
+    MovieHeader header {};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.frame_count = inputs.size();
+    header.rom_hash = rom_hash;
+    header.start_hash = start_hash;
+    header.state_size = start_state.size();
+    header.accuracy = static_cast<uint8_t>(accuracy);
+
+    std::ofstream file { filename, std::ios::binary | std::ios::trunc };
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(start_state.data()),
+               start_state.size());
+    file.write(reinterpret_cast<const char *>(inputs.data()), inputs.size());
+
+    if (!file) throw std::runtime_error("Could not write " + filename);
+}
+
+void Movie::load(const std::string &filename) {
+    std::ifstream file { filename, std::ios::binary };
+    if (!file.is_open()) throw std::runtime_error("Could not open " + filename);
+
+    MovieHeader header {};
+    file.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!file || std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error(filename + " is not a movie");
+    }
+    if (header.version != VERSION ||
+        header.accuracy > static_cast<uint8_t>(PPUAccuracy::Fifo)) {
+        throw std::runtime_error(filename + " has an unsupported version");
+    }
+
+    std::vector<byte_t> state(header.state_size);
+    std::vector<byte_t> frames(header.frame_count);
+    file.read(reinterpret_cast<char *>(state.data()), state.size());
+    file.read(reinterpret_cast<char *>(frames.data()), frames.size());
+    if (!file) throw std::runtime_error(filename + " is truncated");
+
+    rom_hash = header.rom_hash;
+    start_hash = header.start_hash;
+    accuracy = static_cast<PPUAccuracy>(header.accuracy);
+    start_state = std::move(state);
+    inputs = std::move(frames);
+}
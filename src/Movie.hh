@@ -0,0 +1,76 @@
+#pragma once
+
+// System headers
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// User headers
+#include "Constants.hh"
+#include "PPU.hh"
+
+/**
+ *  Fixed part at the start of a movie file.
+ */
+struct MovieHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t frame_count;
+
+    // Hash of the ROM the movie was recorded with
+    uint64_t rom_hash;
+
+    // Hash of the save state (without framebuffer) the movie starts from
+    uint64_t start_hash;
+
+    // Size of the embedded starting state, 0 for movies from power-on
+    uint32_t state_size;
+
+    uint8_t accuracy;
+    uint8_t reserved[3];
+};
+
+static_assert(sizeof(MovieHeader) == 40, "MovieHeader must not have padding");
+
+/**
+ *  A recording of the buttons held during every frame, which Emulator plays
+ *  back to repeat a run exactly.
+ *
+ *  The file is a MovieHeader, the starting save state (none for movies from
+ *  power-on, where the header's hash identifies the start instead) and one
+ *  byte of Buttons bits per frame. All values are in host byte order.
+ *
+ *  Input is taken once per frame because the joypad only changes between
+ *  frames here, so a per frame log reproduces every poll the game makes.
+ */
+class Movie {
+   public:
+    static constexpr char MAGIC[8] = { 'G', 'B', 'M', 'O', 'V', 'I', 'E', 0 };
+    static constexpr uint32_t VERSION = 1;
+
+    uint64_t rom_hash { 0 };
+    uint64_t start_hash { 0 };
+
+    // Playback needs the same renderer, the PPU timing depends on it
+    PPUAccuracy accuracy { PPUAccuracy::Fast };
+
+    // Save state the movie starts from, empty when it starts at power-on
+    std::vector<byte_t> start_state {};
+
+    // Buttons held during each frame
+    std::vector<byte_t> inputs {};
+
+    bool startsAtPowerOn() const { return start_state.empty(); }
+
+    /**
+     *  Writes the movie to filename. Throws std::runtime_error if it can't.
+     */
+    void save(const std::string &filename) const;
+
+    /**
+     *  Replaces this movie with the one in filename. Throws
+     *  std::runtime_error, without changing anything, if the file isn't a
+     *  complete movie this version can read.
+     */
+    void load(const std::string &filename);
+};
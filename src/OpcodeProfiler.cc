@@ -0,0 +1,57 @@
+// User headers
+#include "OpcodeProfiler.hh"
+#include "Processor.hh"
+#include "Utility.hh"
+#include "opcode_names.hh"
+
+void OpcodeProfiler::begin(const Processor &processor) {
+    // HALT steps don't execute anything
+    if (processor.halted) {
+        current = nullptr;
+        return;
+    }
+
+    register16_t pc = processor.PC->getValue();
+    opcode_t opcode = processor.program_memory->peek(pc);
+
+    if (opcode == 0xCB) {
+        current = &cb_counters[processor.program_memory->peek(pc + 1)];
+    } else {
+        current = &counters[opcode];
+    }
+    start_cycle = processor.clock_cycles;
+}
+
+void OpcodeProfiler::end(const Processor &processor) {
+    if (!current) return;
+
+    add(current->executions, 1);
+    add(current->cycles, processor.clock_cycles - start_cycle);
+}
+
+void OpcodeProfiler::reset() {
+    for (auto *table : { &counters, &cb_counters }) {
+        for (Counter &counter : *table) {
+            counter.executions.store(0, std::memory_order_relaxed);
+            counter.cycles.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+void OpcodeProfiler::writeCSV(std::ostream &out) const {
+    out << "prefix,opcode,name,executions,cycles" << std::endl;
+
+    for (int cb = 0; cb < 2; ++cb) {
+        const auto &table = cb ? cb_counters : counters;
+        const auto &names = cb ? opcodes_cb_names : opcode_names;
+
+        for (unsigned opcode = 0; opcode < NUMBER_OF_INSTRUCTIONS; ++opcode) {
+            uint64_t executions = table[opcode].executions.load();
+            if (executions == 0) continue;
+
+            out << (cb ? "CB" : "") << "," << Util::hexString(opcode, 2)
+                << ",\"" << names[opcode] << "\"," << executions << ","
+                << table[opcode].cycles.load() << std::endl;
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+// System headers
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+// User headers
+#include "Constants.hh"
+
+class Processor;
+
+/**
+ *  Counts executions and cycles per opcode and per CB opcode. Only the run
+ *  loop instantiated with profiling calls begin() and end(), so it costs
+ *  nothing while disabled.
+ *
+ *  Counters are only written by the emulation thread, as relaxed atomics so
+ *  the GUI can read them while it runs.
+ */
+class OpcodeProfiler {
+   public:
+    struct Counter {
+        std::atomic<uint64_t> executions { 0 };
+        std::atomic<uint64_t> cycles { 0 };
+    };
+
+    OpcodeProfiler() = default;
+
+    // Weffc++
+    OpcodeProfiler(const OpcodeProfiler &) = delete;
+    void operator=(const OpcodeProfiler &) = delete;
+
+    /**
+     *  Notes the instruction about to be executed.
+     */
+    void begin(const Processor &processor);
+
+    /**
+     *  Counts the instruction noted by begin(), with the cycles it took.
+     */
+    void end(const Processor &processor);
+
+    void reset();
+
+    const Counter &getCounter(opcode_t opcode) const {
+        return counters[opcode];
+    }
+    const Counter &getCBCounter(opcode_t opcode) const {
+        return cb_counters[opcode];
+    }
+
+    /**
+     *  Writes "prefix,opcode,name,executions,cycles" lines for every opcode
+     *  that was executed, with a header.
+     */
+    void writeCSV(std::ostream &out) const;
+
+   private:
+    std::array<Counter, NUMBER_OF_INSTRUCTIONS> counters {};
+    std::array<Counter, NUMBER_OF_INSTRUCTIONS> cb_counters {};
+
+    // The instruction between begin() and end(), nullptr while halted
+    Counter *current { nullptr };
+    uint64_t start_cycle { 0 };
+
+    static void add(std::atomic<uint64_t> &counter, uint64_t value) {
+        // Single writer, so no atomic read-modify-write is needed
+        counter.store(counter.load(std::memory_order_relaxed) + value,
+                      std::memory_order_relaxed);
+    }
+};
@@ -0,0 +1,262 @@
+// System headers
+#include <algorithm>
+
+// User headers
+#include "FifoRenderer.hh"
+#include "PPU.hh"
+#include "Processor.hh"
+#include "ScanlineRenderer.hh"
+
+PPU::PPU(Processor &cpu)
+    : cpu { cpu },
+      renderer { std::make_shared<ScanlineRenderer>(
+          state, *cpu.program_memory, framebuffer) } {
+    for (register16_t address = LCD::LCDC; address <= LCD::WX; ++address) {
+        // OAM DMA (0xFF46) is not handled by the PPU
+        if (address == LCD::DMA) continue;
+        cpu.program_memory->mapIO(address, this);
+    }
+
+    cpu.scheduler.setHandler(EventType::PPULineStart,
+                             [this](uint64_t cycle) { onLineStart(cycle); });
+    cpu.scheduler.setHandler(EventType::PPUHBlank,
+                             [this](uint64_t cycle) { onHBlank(cycle); });
+
+    if (lcdEnabled()) enableLCD();
+}
+
+void PPU::setAccuracy(PPUAccuracy accuracy) {
+    this->accuracy = accuracy;
+    switch (accuracy) {
+        case PPUAccuracy::Fast:
+            renderer = std::make_shared<ScanlineRenderer>(
+                state, *cpu.program_memory, framebuffer);
+            break;
+        case PPUAccuracy::Fifo:
+            renderer = std::make_shared<FifoRenderer>(
+                state, *cpu.program_memory, framebuffer);
+            break;
+    }
+}
+
+void PPU::restoreState(const PPUState &saved) {
+    bool output_wanted = state.output_wanted;
+    state = saved;
+    state.output_wanted = output_wanted;
+}
+
+byte_t PPU::currentLine() const {
+    if (!lcdEnabled()) return 0;
+
+    uint64_t dot = (cpu.clock_cycles - state.frame_start) % LCD::DOTS_PER_FRAME;
+    return (byte_t)(dot / LCD::DOTS_PER_LINE);
+}
+
+byte_t PPU::currentMode() const {
+    if (!lcdEnabled()) return LCD::MODE_HBLANK;
+
+    uint64_t dot = (cpu.clock_cycles - state.frame_start) % LCD::DOTS_PER_FRAME;
+    if (dot / LCD::DOTS_PER_LINE >= LCD::SCREEN_HEIGHT) return LCD::MODE_VBLANK;
+
+    // The length of pixel transfer is only known for the line the events
+    // have reached, which the current cycle can be ahead of
+    unsigned transfer_dots = dot / LCD::DOTS_PER_LINE == state.line
+                                 ? state.pixel_transfer_dots
+                                 : LCD::PIXEL_TRANSFER_DOTS;
+
+    unsigned line_dot = dot % LCD::DOTS_PER_LINE;
+    if (line_dot < LCD::OAM_SCAN_DOTS) return LCD::MODE_OAM_SCAN;
+    if (line_dot < LCD::OAM_SCAN_DOTS + transfer_dots)
+        return LCD::MODE_PIXEL_TRANSFER;
+    return LCD::MODE_HBLANK;
+}
+
+byte_t PPU::readIO(register16_t address) {
+    switch (address) {
+        case LCD::LCDC:
+            return state.lcdc;
+        case LCD::STAT: {
+            byte_t coincidence =
+                currentLine() == state.lyc ? LCD::STAT_COINCIDENCE : 0;
+            return 0x80 | (state.stat & LCD::STAT_WRITABLE) | coincidence |
+                   currentMode();
+        }
+        case LCD::SCY:
+            return state.scy;
+        case LCD::SCX:
+            return state.scx;
+        case LCD::LY:
+            return currentLine();
+        case LCD::LYC:
+            return state.lyc;
+        case LCD::BGP:
+            return state.bgp;
+        case LCD::OBP0:
+            return state.obp0;
+        case LCD::OBP1:
+            return state.obp1;
+        case LCD::WY:
+            return state.wy;
+        case LCD::WX:
+            return state.wx;
+        default:
+            return 0xFF;
+    }
+}
+
+void PPU::writeIO(register16_t address, byte_t data) {
+    switch (address) {
+        case LCD::LCDC: {
+            catchUp();
+            bool was_enabled = lcdEnabled();
+            state.lcdc = data;
+            if (!was_enabled && lcdEnabled()) enableLCD();
+            if (was_enabled && !lcdEnabled()) disableLCD();
+            break;
+        }
+        case LCD::STAT:
+            state.stat = data & LCD::STAT_WRITABLE;
+            updateStatLine(currentLine(), currentMode());
+            break;
+        case LCD::SCY:
+            catchUp();
+            state.scy = data;
+            break;
+        case LCD::SCX:
+            catchUp();
+            state.scx = data;
+            break;
+        case LCD::LY:
+            // Read only
+            break;
+        case LCD::LYC:
+            state.lyc = data;
+            updateStatLine(currentLine(), currentMode());
+            break;
+        case LCD::BGP:
+            catchUp();
+            state.bgp = data;
+            break;
+        case LCD::OBP0:
+            catchUp();
+            state.obp0 = data;
+            break;
+        case LCD::OBP1:
+            catchUp();
+            state.obp1 = data;
+            break;
+        case LCD::WY:
+            catchUp();
+            state.wy = data;
+            break;
+        case LCD::WX:
+            catchUp();
+            state.wx = data;
+            break;
+        default:
+            break;
+    }
+}
+
+void PPU::catchUp() {
+    cpu.scheduler.runUntil(cpu.clock_cycles);
+
+    if (!lcdEnabled() || state.line >= LCD::SCREEN_HEIGHT) return;
+
+    // Events are up to date, so the current cycle is within state.line
+    uint64_t line_dot = cpu.clock_cycles - state.frame_start -
+                        state.line * LCD::DOTS_PER_LINE;
+    if (line_dot <= LCD::OAM_SCAN_DOTS) return;
+
+    renderer->renderUpTo((unsigned)std::min<uint64_t>(
+        line_dot - LCD::OAM_SCAN_DOTS, state.pixel_transfer_dots));
+}
+
+void PPU::enableLCD() {
+    state.frame_start = cpu.clock_cycles;
+    state.line = 0;
+    state.window_line = 0;
+    cpu.scheduler.schedule(EventType::PPULineStart, cpu.clock_cycles);
+}
+
+void PPU::disableLCD() {
+    cpu.scheduler.deschedule(EventType::PPULineStart);
+    cpu.scheduler.deschedule(EventType::PPUHBlank);
+    state.line = 0;
+    state.stat_line = false;
+}
+
+void PPU::onLineStart(uint64_t cycle) {
+    uint64_t line = (cycle - state.frame_start) / LCD::DOTS_PER_LINE;
+    if (line >= LCD::LINES_PER_FRAME) {
+        state.frame_start = cycle;
+        state.window_line = 0;
+        line = 0;
+    }
+    state.line = (byte_t)line;
+
+    byte_t mode = LCD::MODE_OAM_SCAN;
+    if (state.line < LCD::SCREEN_HEIGHT) {
+        state.window_drawn = false;
+        scanOAM();
+        state.pixel_transfer_dots = (uint16_t)renderer->beginLine();
+        cpu.scheduler.schedule(
+            EventType::PPUHBlank,
+            cycle + LCD::OAM_SCAN_DOTS + state.pixel_transfer_dots);
+    } else {
+        mode = LCD::MODE_VBLANK;
+        if (state.line == LCD::SCREEN_HEIGHT) {
+            cpu.requestInterrupt(INTERRUPT_VBLANK);
+            state.frame_count++;
+        }
+    }
+
+    updateStatLine(state.line, mode);
+    cpu.scheduler.schedule(EventType::PPULineStart,
+                           cycle + LCD::DOTS_PER_LINE);
+}
+
+void PPU::onHBlank(uint64_t) {
+    // Whatever was not rendered by mid-line register writes
+    renderer->finishLine();
+    if (state.window_drawn) state.window_line++;
+
+    updateStatLine(state.line, LCD::MODE_HBLANK);
+}
+
+void PPU::updateStatLine(byte_t line, byte_t mode) {
+    bool level = false;
+    if ((state.stat & LCD::STAT_COINCIDENCE_INTERRUPT) && line == state.lyc)
+        level = true;
+    if ((state.stat & LCD::STAT_HBLANK_INTERRUPT) && mode == LCD::MODE_HBLANK)
+        level = true;
+    if ((state.stat & LCD::STAT_VBLANK_INTERRUPT) && mode == LCD::MODE_VBLANK)
+        level = true;
+    if ((state.stat & LCD::STAT_OAM_INTERRUPT) && mode == LCD::MODE_OAM_SCAN)
+        level = true;
+
+    if (level && !state.stat_line) cpu.requestInterrupt(INTERRUPT_LCD_STAT);
+    state.stat_line = level;
+}
+
+void PPU::scanOAM() {
+    const Memory &vram = *cpu.program_memory;
+    unsigned height = (state.lcdc & LCD::LCDC_OBJ_SIZE) ? 16 : 8;
+
+    state.sprite_count = 0;
+    for (unsigned i = 0; i < LCD::OAM_ENTRIES; ++i) {
+        int y = vram.peek(LCD::OAM_START + i * 4) - 16;
+        if (state.line >= y && state.line < y + (int)height) {
+            state.sprites[state.sprite_count++] = (byte_t)i;
+            if (state.sprite_count == LCD::MAX_SPRITES_PER_LINE) break;
+        }
+    }
+
+    // Lower X has priority, ties are broken by OAM order
+    std::stable_sort(state.sprites.begin(),
+                     state.sprites.begin() + state.sprite_count,
+                     [&vram](byte_t a, byte_t b) {
+                         return vram.peek(LCD::OAM_START + a * 4 + 1) <
+                                vram.peek(LCD::OAM_START + b * 4 + 1);
+                     });
+}
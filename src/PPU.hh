@@ -0,0 +1,229 @@
+#pragma once
+
+// System headers
+#include <array>
+#include <cstdint>
+
+// User headers
+#include "Constants.hh"
+#include "Memory.hh"
+
+class Processor;
+class PPURenderer;
+
+namespace LCD {
+// IO registers
+constexpr const register16_t LCDC = 0xFF40;
+constexpr const register16_t STAT = 0xFF41;
+constexpr const register16_t SCY = 0xFF42;
+constexpr const register16_t SCX = 0xFF43;
+constexpr const register16_t LY = 0xFF44;
+constexpr const register16_t LYC = 0xFF45;
+constexpr const register16_t DMA = 0xFF46;
+constexpr const register16_t BGP = 0xFF47;
+constexpr const register16_t OBP0 = 0xFF48;
+constexpr const register16_t OBP1 = 0xFF49;
+constexpr const register16_t WY = 0xFF4A;
+constexpr const register16_t WX = 0xFF4B;
+
+// LCDC bits
+constexpr const byte_t LCDC_BG_ENABLE = 0x01;
+constexpr const byte_t LCDC_OBJ_ENABLE = 0x02;
+constexpr const byte_t LCDC_OBJ_SIZE = 0x04;
+constexpr const byte_t LCDC_BG_MAP = 0x08;
+constexpr const byte_t LCDC_TILE_DATA = 0x10;
+constexpr const byte_t LCDC_WINDOW_ENABLE = 0x20;
+constexpr const byte_t LCDC_WINDOW_MAP = 0x40;
+constexpr const byte_t LCDC_LCD_ENABLE = 0x80;
+
+// STAT bits
+constexpr const byte_t STAT_COINCIDENCE = 0x04;
+constexpr const byte_t STAT_HBLANK_INTERRUPT = 0x08;
+constexpr const byte_t STAT_VBLANK_INTERRUPT = 0x10;
+constexpr const byte_t STAT_OAM_INTERRUPT = 0x20;
+constexpr const byte_t STAT_COINCIDENCE_INTERRUPT = 0x40;
+constexpr const byte_t STAT_WRITABLE = 0x78;
+
+// Modes (lower two bits of STAT)
+constexpr const byte_t MODE_HBLANK = 0;
+constexpr const byte_t MODE_VBLANK = 1;
+constexpr const byte_t MODE_OAM_SCAN = 2;
+constexpr const byte_t MODE_PIXEL_TRANSFER = 3;
+
+// Screen and timing, in pixels and dots (one dot is one clock cycle)
+constexpr const unsigned SCREEN_WIDTH = 160;
+constexpr const unsigned SCREEN_HEIGHT = 144;
+constexpr const unsigned LINES_PER_FRAME = 154;
+constexpr const unsigned DOTS_PER_LINE = 456;
+constexpr const unsigned DOTS_PER_FRAME = DOTS_PER_LINE * LINES_PER_FRAME;
+constexpr const unsigned OAM_SCAN_DOTS = 80;
+constexpr const unsigned PIXEL_TRANSFER_DOTS = 172;
+
+// Memory regions used for rendering
+constexpr const register16_t TILE_DATA_UNSIGNED = 0x8000;
+constexpr const register16_t TILE_DATA_SIGNED = 0x9000;
+constexpr const register16_t TILE_MAP_LOW = 0x9800;
+constexpr const register16_t TILE_MAP_HIGH = 0x9C00;
+constexpr const register16_t OAM_START = 0xFE00;
+constexpr const unsigned OAM_ENTRIES = 40;
+constexpr const unsigned MAX_SPRITES_PER_LINE = 10;
+
+// Colors of the shades 0-3, from lightest to darkest, as RGBA bytes in
+// memory order
+constexpr const std::array<uint32_t, 4> SHADE_COLORS { 0xFFD0F8E0, 0xFF70C088,
+                                                       0xFF566834,
+                                                       0xFF201808 };
+}  // namespace LCD
+
+/**
+ *  Shades (0-3, after palette) of every pixel on the screen, row by row.
+ */
+using framebuffer_t = std::array<byte_t, LCD::SCREEN_WIDTH * LCD::SCREEN_HEIGHT>;
+
+/**
+ *  Selects the renderer backend. Fast renders whole scanlines with a fixed
+ *  mode 3 length, Fifo is dot accurate with a variable mode 3 length.
+ */
+enum class PPUAccuracy { Fast, Fifo };
+
+/**
+ *  Everything the PPU needs to resume, kept as plain data. Members are
+ *  ordered so there is no padding, which keeps save states (and hashes of
+ *  them) dependent on the values only.
+ */
+struct PPUState {
+    // Clock cycle at which line 0 of the current frame started
+    uint64_t frame_start { 0 };
+
+    // Number of frames that have reached VBlank
+    uint64_t frame_count { 0 };
+
+    // Length of pixel transfer (mode 3) of the current line, in dots
+    uint16_t pixel_transfer_dots { LCD::PIXEL_TRANSFER_DOTS };
+
+    // Register values, initialized to what the boot ROM leaves behind
+    byte_t lcdc { 0x91 };
+    byte_t stat { 0x00 };
+    byte_t scy { 0x00 };
+    byte_t scx { 0x00 };
+    byte_t lyc { 0x00 };
+    byte_t bgp { 0xFC };
+    byte_t obp0 { 0xFF };
+    byte_t obp1 { 0xFF };
+    byte_t wy { 0x00 };
+    byte_t wx { 0x00 };
+
+    // Scanline the event handlers last processed
+    byte_t line { 0 };
+
+    // Internal line counter of the window, only advances when it is drawn
+    byte_t window_line { 0 };
+    bool window_drawn { false };
+
+    // Pixels of the current line that have already been rendered
+    byte_t line_x { 0 };
+
+    // OAM indices of the sprites on the current line, in priority order
+    std::array<byte_t, LCD::MAX_SPRITES_PER_LINE> sprites {};
+    byte_t sprite_count { 0 };
+
+    // Level of the STAT interrupt line, the interrupt fires on rising edges
+    bool stat_line { false };
+
+    // Whether anyone will look at the pixels, checked by the renderer for
+    // every line. Timing and interrupts are the same either way.
+    bool output_wanted { true };
+
+    byte_t reserved[3] {};
+};
+
+static_assert(sizeof(PPUState) == 48, "PPUState must not have padding");
+
+/**
+ *  The picture processing unit. LY and STAT are never stored; reads compute
+ *  them from the current clock cycle relative to the start of the frame. The
+ *  actual work (rendering, requesting interrupts) is done in scheduler events
+ *  at mode boundaries, where the renderer backend finishes the scanline.
+ *
+ *  Writes to registers that affect the picture (LCDC, scroll, window and
+ *  palettes) first render the current line up to the pixel the PPU has
+ *  reached, so mid-scanline raster effects end up where they should.
+ */
+class PPU : public IOHandler {
+   public:
+    PPU(Processor &cpu);
+
+    // Weffc++
+    PPU(const PPU &) = delete;
+    void operator=(const PPU &) = delete;
+
+    byte_t readIO(register16_t address) override;
+    void writeIO(register16_t address, byte_t data) override;
+
+    void setAccuracy(PPUAccuracy accuracy);
+    PPUAccuracy getAccuracy() const { return accuracy; }
+
+    /**
+     *  LY as seen by the CPU at the current clock cycle.
+     */
+    byte_t currentLine() const;
+
+    /**
+     *  STAT mode (lower two bits) at the current clock cycle.
+     */
+    byte_t currentMode() const;
+
+    bool lcdEnabled() const { return state.lcdc & LCD::LCDC_LCD_ENABLE; }
+
+    /**
+     *  When output is not wanted (skipped frames) the renderer does no tile
+     *  decoding, palette lookups or framebuffer writes.
+     */
+    void setOutputWanted(bool wanted) { state.output_wanted = wanted; }
+    bool outputWanted() const { return state.output_wanted; }
+
+    const framebuffer_t &getFramebuffer() const { return framebuffer; }
+
+    /**
+     *  For save states. Restoring keeps whether output is wanted, that's up
+     *  to the host rather than part of the machine.
+     */
+    const PPUState &getState() const { return state; }
+    void restoreState(const PPUState &saved);
+    void restoreFramebuffer(const framebuffer_t &pixels) {
+        framebuffer = pixels;
+    }
+
+    uint64_t getFrameCount() const { return state.frame_count; }
+
+   private:
+    Processor &cpu;
+    PPUState state {};
+    framebuffer_t framebuffer {};
+    PPUAccuracy accuracy { PPUAccuracy::Fast };
+    ptr<PPURenderer> renderer;
+
+    /**
+     *  Runs all PPU events that are due and renders the current line up to
+     *  the current clock cycle, before a register it depends on changes.
+     */
+    void catchUp();
+
+    void enableLCD();
+    void disableLCD();
+
+    void onLineStart(uint64_t cycle);
+    void onHBlank(uint64_t cycle);
+
+    /**
+     *  Computes the STAT interrupt line for the given line and mode and
+     *  requests an interrupt on a rising edge.
+     */
+    void updateStatLine(byte_t line, byte_t mode);
+
+    /**
+     *  Selects the (up to 10) sprites on the current line.
+     */
+    void scanOAM();
+
+};
@@ -0,0 +1,47 @@
+#include "PPURenderer.hh"
+
+register16_t PPURenderer::backgroundMap() const {
+    return (state.lcdc & LCD::LCDC_BG_MAP) ? LCD::TILE_MAP_HIGH
+                                           : LCD::TILE_MAP_LOW;
+}
+
+register16_t PPURenderer::windowMap() const {
+    return (state.lcdc & LCD::LCDC_WINDOW_MAP) ? LCD::TILE_MAP_HIGH
+                                               : LCD::TILE_MAP_LOW;
+}
+
+bool PPURenderer::windowOnLine() const {
+    return (state.lcdc & LCD::LCDC_BG_ENABLE) &&
+           (state.lcdc & LCD::LCDC_WINDOW_ENABLE) && state.line >= state.wy &&
+           state.wx <= 166;
+}
+
+PPURenderer::TileRow PPURenderer::fetchBackgroundRow(register16_t map,
+                                                     byte_t tile_x,
+                                                     byte_t py) const {
+    byte_t tile = memory.peek(map + (py / 8) * 32 + tile_x);
+    register16_t tile_address = (state.lcdc & LCD::LCDC_TILE_DATA)
+                                    ? LCD::TILE_DATA_UNSIGNED + tile * 16
+                                    : LCD::TILE_DATA_SIGNED + (int8_t)tile * 16;
+    tile_address += (py % 8) * 2;
+
+    return { memory.peek(tile_address), memory.peek(tile_address + 1) };
+}
+
+PPURenderer::TileRow PPURenderer::fetchSpriteRow(byte_t oam_index) const {
+    register16_t entry = LCD::OAM_START + oam_index * 4;
+    unsigned height = (state.lcdc & LCD::LCDC_OBJ_SIZE) ? 16 : 8;
+
+    int y = memory.peek(entry) - 16;
+    byte_t tile = memory.peek(entry + 2);
+    byte_t attributes = memory.peek(entry + 3);
+
+    unsigned sprite_row = state.line - y;
+    if (attributes & 0x40) sprite_row = height - 1 - sprite_row;
+    if (height == 16) tile &= 0xFE;
+
+    register16_t tile_address =
+        LCD::TILE_DATA_UNSIGNED + tile * 16 + sprite_row * 2;
+
+    return { memory.peek(tile_address), memory.peek(tile_address + 1) };
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+// User headers
+#include "Constants.hh"
+#include "Memory.hh"
+#include "PPU.hh"
+
+/**
+ *  Common interface of the PPU backends. The PPU owns the registers, the
+ *  events and the OAM scan; a renderer turns the current line into pixels
+ *  and decides how long pixel transfer (mode 3) takes.
+ */
+class PPURenderer {
+   public:
+    PPURenderer(PPUState &state, const Memory &memory,
+                framebuffer_t &framebuffer)
+        : state { state }, memory { memory }, framebuffer { framebuffer } {}
+    virtual ~PPURenderer() = default;
+
+    // Weffc++
+    PPURenderer(const PPURenderer &) = delete;
+    void operator=(const PPURenderer &) = delete;
+
+    /**
+     *  Called at the start of every visible line, after the OAM scan.
+     *  Returns the length of pixel transfer in dots.
+     */
+    virtual unsigned beginLine() = 0;
+
+    /**
+     *  Renders the current line up to the given dot of pixel transfer.
+     */
+    virtual void renderUpTo(unsigned dot) = 0;
+
+    /**
+     *  Renders whatever is left of the current line.
+     */
+    virtual void finishLine() = 0;
+
+   protected:
+    struct TileRow {
+        byte_t low;
+        byte_t high;
+    };
+
+    PPUState &state;
+    const Memory &memory;
+    framebuffer_t &framebuffer;
+
+    static byte_t applyPalette(byte_t palette, byte_t color) {
+        return (palette >> (color * 2)) & 0x03;
+    }
+
+    static byte_t tileRowPixel(TileRow row, unsigned bit) {
+        return (((row.high >> bit) & 0x01) << 1) | ((row.low >> bit) & 0x01);
+    }
+
+    register16_t backgroundMap() const;
+    register16_t windowMap() const;
+
+    /**
+     *  Whether the window covers any part of the current line.
+     */
+    bool windowOnLine() const;
+
+    /**
+     *  Bookkeeping for a line that is not rendered because output is not
+     *  wanted, so the window line counter still advances.
+     */
+    void skipLine() { state.window_drawn = windowOnLine(); }
+
+    /**
+     *  Fetches the row py of the tile at column tile_x in the given map.
+     */
+    TileRow fetchBackgroundRow(register16_t map, byte_t tile_x,
+                               byte_t py) const;
+
+    /**
+     *  Fetches the row of the given sprite that is on the current line,
+     *  with vertical flip applied.
+     */
+    TileRow fetchSpriteRow(byte_t oam_index) const;
+};
@@ -98,3 +98,13 @@ byte_t Processor::get_interrupt_data() {
 void Processor::set_interrupt_data(byte_t data) {
     program_memory->setData(0xFFFF, data);
 }
+
+void Processor::requestInterrupt(byte_t interrupt) {
+    byte_t flags = program_memory->getData(IF_ADDRESS);
+    program_memory->setData(IF_ADDRESS, flags | interrupt);
+}
+
+byte_t Processor::pendingInterrupts() {
+    return program_memory->getData(IF_ADDRESS) &
+           program_memory->getData(IE_ADDRESS) & 0x1F;
+}
@@ -10,9 +10,12 @@
 
 // User headers
 #include "Constants.hh"
+#include "Joypad.hh"
 #include "Memory.hh"
+#include "PPU.hh"
 #include "Register16bit.hh"
 #include "Register8bit.hh"
+#include "Scheduler.hh"
 #include "Utility.hh"
 #include "opcode_names.hh"
 
@@ -43,6 +46,50 @@ struct CPU_info {
     std::vector<AddressValuePair> PM {};
 };
 
+/**
+ * Plain copy of the CPU state for the debug panels. Unlike CPU_info it holds
+ * values instead of pointers to the live registers, so it can be handed to
+ * another thread and built without allocating.
+ */
+struct DebugSnapshot {
+    static constexpr int PM_RADIUS = 5;
+
+    register8_t A, B, C, D, E, F, H, L;
+    register16_t SP, PC;
+    bool interrupts_enabled;
+
+    uint64_t clock_cycles;
+    uint64_t machine_cycles;
+    uint64_t executed_instructions;
+    uint64_t frame_count;
+
+    // Program memory around PC, starting at PM_start
+    register16_t PM_start;
+    byte_t PM_size;
+    std::array<byte_t, PM_RADIUS * 2 + 1> PM;
+};
+
+/**
+ *  Plain copy of the CPU registers and flags, for save states. Laid out
+ *  without implicit padding so saved bytes only depend on the state.
+ */
+struct CPUState {
+    uint64_t clock_cycles;
+    uint64_t machine_cycles;
+    uint64_t executed_instructions;
+    uint64_t serviced_interrupts;
+
+    register16_t SP, PC;
+    register8_t A, B, C, D, E, F, H, L;
+
+    uint8_t interrupts_enabled;
+    uint8_t interrupt_enable_pending;
+    uint8_t halted;
+    uint8_t reserved[9];
+};
+
+static_assert(sizeof(CPUState) == 56, "CPUState must not have padding");
+
 /** This class is basically just to keep track of the state of the emulated CPU.
     It keeps the registers, memory and so on as members, but all modifications
     are done (using opcodes) using the instruction decoder. */
@@ -60,6 +107,12 @@ class Processor {
     */
     void readInstructions(const std::string &filename, bool verbose = false);
 
+    /**
+        Same as above, with the ROM already in memory.
+    */
+    void readInstructions(const opcode_t *data, size_t size,
+                          bool verbose = false);
+
     /**
         Prints the stack content in a radius around the stack pointer.
     */
@@ -73,6 +126,10 @@ class Processor {
     void printPMAddressData(register16_t address);
     void dump();
     CPU_info getCPUInfo() const;
+    DebugSnapshot getDebugSnapshot() const;
+
+    CPUState getCPUState() const;
+    void setCPUState(const CPUState &state);
 
     /**
      *  Returns the instruction currently pointed at by the program counter.
@@ -142,11 +199,29 @@ class Processor {
     // Number of instructions executed (for debugging)
     long unsigned int executed_instructions { 0 };
 
+    // Hardware events, checked by the instruction decoder after each step
+    Scheduler scheduler {};
+
+    // Picture processing unit, maps its own IO registers in program_memory
+    ptr<PPU> ppu { std::make_shared<PPU>(*this) };
+
+    // Joypad register P1
+    ptr<Joypad> joypad { std::make_shared<Joypad>(*this) };
+
     // Store raw ROM data
     std::vector<opcode_t> rom_data {};
 
-    // Interrupts
-    bool interrupts_enabled { true };
+    // Interrupts (IME). Off after the boot ROM.
+    bool interrupts_enabled { false };
+
+    // Set by EI, which enables interrupts after the following instruction
+    bool interrupt_enable_pending { false };
+
+    // Set by HALT, cleared when an interrupt is pending
+    bool halted { false };
+
+    // Number of interrupts dispatched (for debugging)
+    long unsigned int serviced_interrupts { 0 };
 
     /**
      *   Return data from the interrupt register.
@@ -157,4 +232,14 @@ class Processor {
      *   Set data in the interrupt register.
      */
     void set_interrupt_data(byte_t data);
+
+    /**
+     *   Sets the given interrupt bit(s) in the interrupt flag register (IF).
+     */
+    void requestInterrupt(byte_t interrupt);
+
+    /**
+     *   Interrupts that are both requested (IF) and enabled (IE).
+     */
+    byte_t pendingInterrupts();
 };
\ No newline at end of file
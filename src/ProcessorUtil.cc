@@ -17,18 +17,19 @@ void Processor::readInstructions(const std::string &filename, bool verbose) {
     // Stop eating new lines in binary mode
     file.unsetf(std::ios::skipws);
 
-    std::streampos fileSize;
-
-    file.seekg(0, std::ios::end);
-    fileSize = file.tellg();
-    file.seekg(0, std::ios::beg);
-
     if (verbose)
         std::cout << "Reading instructions from binary file..." << std::endl;
 
     // read the data:
-    rom_data.insert(rom_data.begin(), std::istream_iterator<opcode_t>(file),
-                    std::istream_iterator<opcode_t>());
+    std::vector<opcode_t> data { std::istream_iterator<opcode_t>(file),
+                                 std::istream_iterator<opcode_t>() };
+
+    readInstructions(data.data(), data.size(), verbose);
+}
+
+void Processor::readInstructions(const opcode_t *data, size_t size,
+                                 bool verbose) {
+    rom_data.assign(data, data + size);
 
     if (verbose)
         std::cout << "Loaded " << rom_data.size() << " bytes from ROM file"
@@ -163,4 +164,84 @@ CPU_info Processor::getCPUInfo() const {
     }
 
     return info;
-}
\ No newline at end of file
+}
+
+DebugSnapshot Processor::getDebugSnapshot() const {
+    DebugSnapshot snapshot {};
+    snapshot.A = A->getValue();
+    snapshot.B = B->getValue();
+    snapshot.C = C->getValue();
+    snapshot.D = D->getValue();
+    snapshot.E = E->getValue();
+    snapshot.F = F->getValue();
+    snapshot.H = H->getValue();
+    snapshot.L = L->getValue();
+    snapshot.SP = SP->getValue();
+    snapshot.PC = PC->getValue();
+    snapshot.interrupts_enabled = interrupts_enabled;
+
+    snapshot.clock_cycles = clock_cycles;
+    snapshot.machine_cycles = machine_cycles;
+    snapshot.executed_instructions = executed_instructions;
+    snapshot.frame_count = ppu->getFrameCount();
+
+    // Peek, so that reading IO registers has no side effects
+    int radius = DebugSnapshot::PM_RADIUS;
+    int start = std::max<int>(0, (int)snapshot.PC - radius);
+    int end = std::min<int>(PC_MAX + 1, (int)snapshot.PC + radius + 1);
+
+    snapshot.PM_start = (register16_t)start;
+    snapshot.PM_size = (byte_t)(end - start);
+    for (int i = 0; i < snapshot.PM_size; ++i) {
+        snapshot.PM[i] = program_memory->peek((register16_t)(start + i));
+    }
+
+    return snapshot;
+}
+
+CPUState Processor::getCPUState() const {
+    CPUState state {};
+    state.clock_cycles = clock_cycles;
+    state.machine_cycles = machine_cycles;
+    state.executed_instructions = executed_instructions;
+    state.serviced_interrupts = serviced_interrupts;
+
+    state.SP = SP->getValue();
+    state.PC = PC->getValue();
+    state.A = A->getValue();
+    state.B = B->getValue();
+    state.C = C->getValue();
+    state.D = D->getValue();
+    state.E = E->getValue();
+    state.F = F->getValue();
+    state.H = H->getValue();
+    state.L = L->getValue();
+
+    state.interrupts_enabled = interrupts_enabled;
+    state.interrupt_enable_pending = interrupt_enable_pending;
+    state.halted = halted;
+
+    return state;
+}
+
+void Processor::setCPUState(const CPUState &state) {
+    clock_cycles = state.clock_cycles;
+    machine_cycles = state.machine_cycles;
+    executed_instructions = state.executed_instructions;
+    serviced_interrupts = state.serviced_interrupts;
+
+    SP->setValue(state.SP);
+    PC->setValue(state.PC);
+    A->setValue(state.A);
+    B->setValue(state.B);
+    C->setValue(state.C);
+    D->setValue(state.D);
+    E->setValue(state.E);
+    F->setValue(state.F);
+    H->setValue(state.H);
+    L->setValue(state.L);
+
+    interrupts_enabled = state.interrupts_enabled;
+    interrupt_enable_pending = state.interrupt_enable_pending;
+    halted = state.halted;
+}
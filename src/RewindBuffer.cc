@@ -0,0 +1,191 @@
+// System headers
+#include <algorithm>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// User headers
+#include "RewindBuffer.hh"
+
+namespace {
+
+// Equal bytes needed to end a literal, shorter runs are cheaper to keep in it
+constexpr size_t MIN_RUN = 8;
+
+struct DeltaHeader {
+    // Size of the state this delta turns the newer one into
+    uint32_t size;
+
+    // Bytes the XOR covers, the larger of the two sizes
+    uint32_t length;
+};
+
+/**
+ *  Returns the first position in [pos, end) where a and b differ, or end.
+ */
+size_t equalRunEnd(const byte_t *a, const byte_t *b, size_t pos, size_t end) {
+#ifdef __SSE2__
+    while (end - pos >= 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + pos));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + pos));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(x, y));
+        if (mask != 0xFFFF) return pos + __builtin_ctz(~mask);
+        pos += 16;
+    }
+#endif
+    while (pos < end && a[pos] == b[pos]) ++pos;
+    return pos;
+}
+
+/**
+ *  out[i] = a[i] ^ b[i], for both encoding and applying deltas.
+ */
+void xorBytes(byte_t *out, const byte_t *a, const byte_t *b, size_t size) {
+    size_t i = 0;
+#ifdef __SSE2__
+    for (; i + 16 <= size; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i),
+                         _mm_xor_si128(x, y));
+    }
+#endif
+    for (; i < size; ++i) out[i] = a[i] ^ b[i];
+}
+
+void writeVarint(std::vector<byte_t> &out, size_t value) {
+    while (value >= 0x80) {
+        out.push_back((byte_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((byte_t)value);
+}
+
+size_t readVarint(const byte_t *&in) {
+    size_t value = 0;
+    for (unsigned shift = 0;; shift += 7) {
+        byte_t b = *in++;
+        value |= (size_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) return value;
+    }
+}
+
+/**
+ *  Appends a ^ b as (equal run length, literal length, literal XOR bytes)
+ *  triples. Trailing equal bytes are left out.
+ */
+void encodeDelta(const byte_t *a, const byte_t *b, size_t length,
+                 std::vector<byte_t> &out) {
+    size_t pos = 0;
+    while (pos < length) {
+        size_t run_start = pos;
+        pos = equalRunEnd(a, b, pos, length);
+        if (pos == length) break;
+
+        // The literal ends at the first run of MIN_RUN equal bytes
+        size_t literal_start = pos;
+        while (pos < length) {
+            if (a[pos] != b[pos]) {
+                ++pos;
+                continue;
+            }
+            size_t run_end =
+                equalRunEnd(a, b, pos, std::min(length, pos + MIN_RUN));
+            if (run_end - pos >= MIN_RUN || run_end == length) break;
+            pos = run_end;
+        }
+
+        size_t literal_length = pos - literal_start;
+        writeVarint(out, literal_start - run_start);
+        writeVarint(out, literal_length);
+
+        size_t offset = out.size();
+        out.resize(offset + literal_length);
+        xorBytes(out.data() + offset, a + literal_start, b + literal_start,
+                 literal_length);
+    }
+}
+
+/**
+ *  XORs an encoded delta into state.
+ */
+void applyDelta(byte_t *state, const byte_t *in, const byte_t *end) {
+    size_t pos = 0;
+    while (in < end) {
+        pos += readVarint(in);
+        size_t literal_length = readVarint(in);
+
+        xorBytes(state + pos, state + pos, in, literal_length);
+        pos += literal_length;
+        in += literal_length;
+    }
+}
+
+}  // namespace
+
+RewindBuffer::RewindBuffer(unsigned interval_frames, unsigned seconds,
+                           size_t max_bytes)
+    : interval_frames { std::max(interval_frames, 1u) },
+      max_snapshots { std::max<size_t>(seconds * 60 / this->interval_frames,
+                                       1) },
+      max_bytes { max_bytes } {}
+
+void RewindBuffer::push(const byte_t *state, size_t size) {
+    if (newest.empty()) {
+        newest.assign(state, state + size);
+        return;
+    }
+
+    // Both sides are compared over the larger size, padded with zeros
+    size_t older_size = newest.size();
+    size_t length = std::max(older_size, size);
+    newest.resize(length, 0);
+
+    const byte_t *newer = state;
+    if (size < length) {
+        padded.assign(length, 0);
+        std::memcpy(padded.data(), state, size);
+        newer = padded.data();
+    }
+
+    std::vector<byte_t> delta(sizeof(DeltaHeader));
+    DeltaHeader header { (uint32_t)older_size, (uint32_t)length };
+    std::memcpy(delta.data(), &header, sizeof(header));
+    encodeDelta(newest.data(), newer, length, delta);
+    delta.shrink_to_fit();
+
+    delta_bytes += delta.size();
+    deltas.push_back(std::move(delta));
+    newest.assign(state, state + size);
+
+    while (!deltas.empty() && (deltas.size() + 1 > max_snapshots ||
+                               delta_bytes > max_bytes)) {
+        delta_bytes -= deltas.front().size();
+        deltas.pop_front();
+    }
+}
+
+bool RewindBuffer::rewind() {
+    if (deltas.empty()) return false;
+
+    const std::vector<byte_t> &delta = deltas.back();
+    DeltaHeader header {};
+    std::memcpy(&header, delta.data(), sizeof(header));
+
+    newest.resize(header.length, 0);
+    applyDelta(newest.data(), delta.data() + sizeof(header),
+               delta.data() + delta.size());
+    newest.resize(header.size);
+
+    delta_bytes -= delta.size();
+    deltas.pop_back();
+    return true;
+}
+
+void RewindBuffer::clear() {
+    newest.clear();
+    deltas.clear();
+    delta_bytes = 0;
+}
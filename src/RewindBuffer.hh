@@ -0,0 +1,77 @@
+#pragma once
+
+// System headers
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// User headers
+#include "Constants.hh"
+
+/**
+ *  Ring of save states for rewinding. Only the newest state is kept whole;
+ *  every older one is stored as the XOR against the state after it,
+ *  run-length encoded. Between two snapshots a few frames apart most of
+ *  memory is unchanged, so the XOR is mostly zeros and a snapshot takes a
+ *  few hundred bytes to a few KB. Rewinding applies the deltas from the
+ *  newest state backwards.
+ *
+ *  The oldest snapshots are dropped when the buffer holds more than
+ *  max_snapshots or more than max_bytes of deltas.
+ */
+class RewindBuffer {
+   public:
+    static constexpr unsigned DEFAULT_INTERVAL_FRAMES = 2;
+    static constexpr unsigned DEFAULT_SECONDS = 60;
+    static constexpr size_t DEFAULT_MAX_BYTES = 20 << 20;
+
+    /**
+     *  A snapshot is taken every interval_frames frames, and enough are kept
+     *  for the given number of seconds of rewind (at about 60 frames per
+     *  second).
+     */
+    explicit RewindBuffer(unsigned interval_frames = DEFAULT_INTERVAL_FRAMES,
+                          unsigned seconds = DEFAULT_SECONDS,
+                          size_t max_bytes = DEFAULT_MAX_BYTES);
+
+    /**
+     *  Adds a state as the newest snapshot.
+     */
+    void push(const byte_t *state, size_t size);
+
+    /**
+     *  Makes the snapshot before the newest one the newest, dropping the
+     *  newest. Returns false if there is no older snapshot, leaving the
+     *  oldest as the newest.
+     */
+    bool rewind();
+
+    const byte_t *newestState() const { return newest.data(); }
+    size_t newestSize() const { return newest.size(); }
+
+    bool empty() const { return newest.empty(); }
+    void clear();
+
+    unsigned getInterval() const { return interval_frames; }
+    size_t snapshotCount() const { return deltas.size() + !newest.empty(); }
+
+    /**
+     *  Bytes used by the snapshots, including the newest whole one.
+     */
+    size_t memoryUsage() const { return delta_bytes + newest.size(); }
+
+   private:
+    unsigned interval_frames;
+    size_t max_snapshots;
+    size_t max_bytes;
+
+    std::vector<byte_t> newest {};
+
+    // Oldest first, each turns the state after it into its own
+    std::deque<std::vector<byte_t>> deltas {};
+    size_t delta_bytes { 0 };
+
+    // The pushed state, padded to the size of the newest when it's smaller
+    std::vector<byte_t> padded {};
+};
@@ -0,0 +1,95 @@
+// System headers
+#include <algorithm>
+
+// User headers
+#include "Emulator.hh"
+#include "RunAhead.hh"
+
+RunAhead::~RunAhead() { setSecondInstance(false); }
+
+void RunAhead::setFrames(unsigned frames) {
+    this->frames = std::min(frames, MAX_FRAMES);
+}
+
+void RunAhead::setSecondInstance(bool enabled) {
+    if (enabled == usesSecondInstance()) return;
+
+    if (enabled) {
+        shadow = std::make_shared<Emulator>();
+        shadow->setPPUAccuracy(emulator.processor->ppu->getAccuracy());
+        stopping = false;
+        pending = false;
+        has_result = false;
+        worker = std::thread(&RunAhead::workerLoop, this);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock { mutex };
+        stopping = true;
+    }
+    work_ready.notify_one();
+    worker.join();
+    shadow = nullptr;
+}
+
+void RunAhead::speculate() {
+    if (frames == 0) return;
+
+    if (usesSecondInstance()) {
+        speculateOnSecondInstance();
+    } else {
+        speculateHere();
+    }
+}
+
+void RunAhead::speculateHere() {
+    state.resize(emulator.stateSize(false));
+    state_size = emulator.saveState(state.data(), state.size(), false);
+
+    for (unsigned i = 1; i <= frames; ++i) {
+        emulator.runSpeculativeFrame(i == frames);
+    }
+
+    emulator.loadState(state.data(), state_size);
+}
+
+void RunAhead::speculateOnSecondInstance() {
+    std::unique_lock<std::mutex> lock { mutex };
+    work_done.wait(lock, [this] { return !pending; });
+
+    // Show what was speculated from the previous frame, which is a frame
+    // behind by now, hence the extra frame below
+    if (has_result) emulator.processor->ppu->restoreFramebuffer(result);
+
+    state.resize(emulator.stateSize(false));
+    state_size = emulator.saveState(state.data(), state.size(), false);
+    pending_frames = frames + 1;
+    pending = true;
+    has_result = true;
+
+    lock.unlock();
+    work_ready.notify_one();
+}
+
+void RunAhead::workerLoop() {
+    std::unique_lock<std::mutex> lock { mutex };
+
+    for (;;) {
+        work_ready.wait(lock, [this] { return pending || stopping; });
+        if (stopping) return;
+
+        unsigned count = pending_frames;
+        lock.unlock();
+
+        shadow->loadState(state.data(), state_size);
+        for (unsigned i = 1; i <= count; ++i) {
+            shadow->runSpeculativeFrame(i == count);
+        }
+
+        lock.lock();
+        result = shadow->getFramebuffer();
+        pending = false;
+        work_done.notify_one();
+    }
+}
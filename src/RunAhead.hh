@@ -0,0 +1,97 @@
+#pragma once
+
+// System headers
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// User headers
+#include "Constants.hh"
+#include "PPU.hh"
+
+class Emulator;
+
+/**
+ *  Hides input latency by showing a frame from the future. After each real
+ *  frame (run without output), the state is saved, a few frames are run
+ *  ahead with the input held as it is now, the last of them is shown, and
+ *  the state is restored. Games that take a few frames to react to input
+ *  then react on the next frame shown.
+ *
+ *  With a second instance, the speculation runs on another thread from a
+ *  copy of the state while the real emulator carries on with the next frame,
+ *  instead of taking turns with it. The frame shown is then the one
+ *  speculated from the previous frame, so the worker runs one frame more to
+ *  make up for it. Until its first result arrives the real frame is shown.
+ *
+ *  Snapshots leave out the framebuffer, so restoring keeps the speculated
+ *  picture on screen. There is no audio yet, so nothing has to be muted
+ *  during the speculative frames.
+ */
+class RunAhead {
+   public:
+    static constexpr unsigned MAX_FRAMES = 8;
+
+    explicit RunAhead(Emulator &emulator) : emulator { emulator } {}
+    ~RunAhead();
+
+    // Weffc++
+    RunAhead(const RunAhead &) = delete;
+    void operator=(const RunAhead &) = delete;
+
+    /**
+     *  Frames to run ahead, 0 to turn it off. Only call while the emulator
+     *  isn't running.
+     */
+    void setFrames(unsigned frames);
+    unsigned getFrames() const { return frames; }
+
+    /**
+     *  Starts or stops the second instance and its thread. Only call while
+     *  the emulator isn't running.
+     */
+    void setSecondInstance(bool enabled);
+    bool usesSecondInstance() const { return shadow != nullptr; }
+
+    /**
+     *  Whether the real frame has to be drawn, because the second instance
+     *  has nothing to show instead yet.
+     */
+    bool needsRealFrame() const { return shadow && !has_result; }
+
+    /**
+     *  Runs the frames ahead of the real one that just finished and leaves
+     *  the one to show in the emulator's framebuffer.
+     */
+    void speculate();
+
+   private:
+    Emulator &emulator;
+    unsigned frames { 0 };
+
+    // State of the real emulator, reused between frames
+    std::vector<byte_t> state {};
+    size_t state_size { 0 };
+
+    // The second instance and the thread running it
+    ptr<Emulator> shadow {};
+    std::thread worker {};
+    std::mutex mutex {};
+    std::condition_variable work_ready {};
+    std::condition_variable work_done {};
+
+    // Guarded by mutex. While pending the worker owns state.
+    bool pending { false };
+    bool stopping { false };
+    unsigned pending_frames { 0 };
+    framebuffer_t result {};
+
+    // Whether result holds a speculated frame, only used by the caller
+    bool has_result { false };
+
+    void speculateHere();
+    void speculateOnSecondInstance();
+    void workerLoop();
+};
@@ -0,0 +1,73 @@
+// System headers
+#include <algorithm>
+#include <map>
+
+// User headers
+#include "Processor.hh"
+#include "SamplingProfiler.hh"
+
+SamplingProfiler::SamplingProfiler(Processor &processor,
+                                   const SymbolTable &symbols)
+    : processor { processor }, symbols { symbols } {
+    processor.scheduler.setHandler(EventType::ProfilerSample,
+                                   [this](uint64_t cycle) { sample(cycle); });
+}
+
+void SamplingProfiler::start(uint64_t interval) {
+    this->interval = std::max<uint64_t>(interval, 1);
+    if (samples.empty()) {
+        samples = std::vector<std::atomic<uint32_t>>(PC_MAX + 1);
+    }
+    running = true;
+    processor.scheduler.schedule(EventType::ProfilerSample,
+                                 processor.clock_cycles + this->interval);
+}
+
+void SamplingProfiler::stop() {
+    running = false;
+    processor.scheduler.deschedule(EventType::ProfilerSample);
+}
+
+void SamplingProfiler::reset() {
+    for (std::atomic<uint32_t> &count : samples) {
+        count.store(0, std::memory_order_relaxed);
+    }
+    total_samples.store(0, std::memory_order_relaxed);
+}
+
+void SamplingProfiler::sample(uint64_t cycle) {
+    // Single writer, so no atomic read-modify-write is needed
+    std::atomic<uint32_t> &count = samples[processor.PC->getValue()];
+    count.store(count.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+    total_samples.store(total_samples.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_relaxed);
+
+    processor.scheduler.schedule(EventType::ProfilerSample, cycle + interval);
+}
+
+std::vector<SamplingProfiler::HotSpot> SamplingProfiler::topFunctions(
+    size_t count) const {
+    std::map<std::string, uint64_t> totals {};
+
+    for (unsigned address = 0; address < samples.size(); ++address) {
+        uint64_t hits = samples[address].load(std::memory_order_relaxed);
+        if (hits == 0) continue;
+
+        std::string name = symbols.functionName(address);
+        totals[name] += hits * interval;
+    }
+
+    std::vector<HotSpot> hot_spots {};
+    for (const auto &entry : totals) {
+        hot_spots.push_back({ entry.first, entry.second });
+    }
+
+    std::sort(hot_spots.begin(), hot_spots.end(),
+              [](const HotSpot &a, const HotSpot &b) {
+                  return a.cycles > b.cycles;
+              });
+    if (hot_spots.size() > count) hot_spots.resize(count);
+
+    return hot_spots;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+// System headers
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// User headers
+#include "Constants.hh"
+#include "SymbolTable.hh"
+
+class Processor;
+
+/**
+ *  Samples PC every N guest cycles to find where guest code spends its time.
+ *  Sampling is a scheduler event, so the run loop doesn't check anything and
+ *  the cost is one event every interval. Samples are kept per address and
+ *  grouped into functions when reported.
+ */
+class SamplingProfiler {
+   public:
+    struct HotSpot {
+        std::string name {};
+        uint64_t cycles { 0 };
+    };
+
+    static constexpr uint64_t DEFAULT_INTERVAL = 1000;
+
+    SamplingProfiler(Processor &processor, const SymbolTable &symbols);
+
+    // Weffc++
+    SamplingProfiler(const SamplingProfiler &) = delete;
+    void operator=(const SamplingProfiler &) = delete;
+
+    /**
+     *  Starts sampling every interval cycles. Only call while the emulator
+     *  isn't running, it schedules an event.
+     */
+    void start(uint64_t interval = DEFAULT_INTERVAL);
+    void stop();
+    bool isRunning() const { return running; }
+
+    void reset();
+
+    /**
+     *  The functions (named by the symbol table) with the most sampled
+     *  cycles, most first.
+     */
+    std::vector<HotSpot> topFunctions(size_t count) const;
+
+    uint64_t totalSamples() const {
+        return total_samples.load(std::memory_order_relaxed);
+    }
+    uint64_t getInterval() const { return interval; }
+
+   private:
+    Processor &processor;
+    const SymbolTable &symbols;
+
+    uint64_t interval { DEFAULT_INTERVAL };
+    bool running { false };
+
+    // Samples per address, written by the emulation thread only. Allocated
+    // by the first start(), most emulators are never profiled.
+    std::vector<std::atomic<uint32_t>> samples {};
+    std::atomic<uint64_t> total_samples { 0 };
+
+    void sample(uint64_t cycle);
+};
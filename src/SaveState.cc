@@ -0,0 +1,259 @@
+// System headers
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// User headers
+#include "Processor.hh"
+#include "SaveState.hh"
+
+namespace SaveState {
+
+namespace {
+
+struct ChunkHeader {
+    char tag[4];
+    uint32_t size;
+};
+
+constexpr size_t HEADER_SIZE = sizeof(MAGIC) + sizeof(uint32_t);
+
+// Scheduler events as saved, without the padding of Event
+struct SavedEvent {
+    uint64_t cycle;
+    uint32_t type;
+    uint32_t reserved;
+};
+
+constexpr char CPU_TAG[4] = { 'C', 'P', 'U', ' ' };
+constexpr char MEMORY_TAG[4] = { 'M', 'E', 'M', ' ' };
+constexpr char STACK_TAG[4] = { 'S', 'T', 'C', 'K' };
+constexpr char PPU_TAG[4] = { 'P', 'P', 'U', ' ' };
+constexpr char FRAMEBUFFER_TAG[4] = { 'F', 'B', 'U', 'F' };
+constexpr char SCHEDULER_TAG[4] = { 'S', 'C', 'H', 'D' };
+constexpr char JOYPAD_TAG[4] = { 'J', 'O', 'Y', 'P' };
+
+/**
+ *  Events that belong to the machine. Profiler samples are host side and
+ *  not saved.
+ */
+bool isMachineEvent(const Event &event) {
+    return event.type == EventType::PPULineStart ||
+           event.type == EventType::PPUHBlank;
+}
+
+size_t savedEventCount(const Processor &processor) {
+    size_t count = 0;
+    for (const Event &event : processor.scheduler.pendingEvents()) {
+        if (isMachineEvent(event)) ++count;
+    }
+    return count;
+}
+
+class Writer {
+   public:
+    explicit Writer(byte_t *buffer) : out { buffer } {}
+
+    // Weffc++
+    Writer(const Writer &) = delete;
+    void operator=(const Writer &) = delete;
+
+    void write(const void *data, size_t size) {
+        std::memcpy(out, data, size);
+        out += size;
+    }
+
+    /**
+     *  Writes the chunk header and returns where the payload goes.
+     */
+    byte_t *chunk(const char (&tag)[4], size_t size) {
+        ChunkHeader header {};
+        std::memcpy(header.tag, tag, sizeof(header.tag));
+        header.size = size;
+        write(&header, sizeof(header));
+
+        byte_t *payload = out;
+        out += size;
+        return payload;
+    }
+
+    byte_t *position() const { return out; }
+
+   private:
+    byte_t *out;
+};
+
+}  // namespace
+
+size_t size(const Processor &processor, bool with_framebuffer) {
+    size_t framebuffer_size =
+        with_framebuffer ? sizeof(ChunkHeader) + sizeof(framebuffer_t) : 0;
+
+    return HEADER_SIZE + 6 * sizeof(ChunkHeader) + sizeof(CPUState) +
+           processor.program_memory->size() + processor.stack->size() +
+           sizeof(PPUState) + framebuffer_size + sizeof(JoypadState) +
+           savedEventCount(processor) * sizeof(SavedEvent);
+}
+
+size_t save(const Processor &processor, byte_t *buffer, size_t buffer_size,
+            bool with_framebuffer) {
+    size_t needed = size(processor, with_framebuffer);
+    if (buffer_size < needed) {
+        throw std::runtime_error("Save state needs " + std::to_string(needed) +
+                                 " bytes");
+    }
+
+    Writer writer { buffer };
+    uint32_t version = VERSION;
+    writer.write(MAGIC, sizeof(MAGIC));
+    writer.write(&version, sizeof(version));
+
+    CPUState cpu = processor.getCPUState();
+    std::memcpy(writer.chunk(CPU_TAG, sizeof(cpu)), &cpu, sizeof(cpu));
+
+    const Memory &memory = *processor.program_memory;
+    memory.copyTo(writer.chunk(MEMORY_TAG, memory.size()));
+
+    const Memory &stack = *processor.stack;
+    stack.copyTo(writer.chunk(STACK_TAG, stack.size()));
+
+    const PPU &ppu = *processor.ppu;
+    std::memcpy(writer.chunk(PPU_TAG, sizeof(PPUState)), &ppu.getState(),
+                sizeof(PPUState));
+    if (with_framebuffer) {
+        std::memcpy(writer.chunk(FRAMEBUFFER_TAG, sizeof(framebuffer_t)),
+                    ppu.getFramebuffer().data(), sizeof(framebuffer_t));
+    }
+
+    std::memcpy(writer.chunk(JOYPAD_TAG, sizeof(JoypadState)),
+                &processor.joypad->getState(), sizeof(JoypadState));
+
+    byte_t *events = writer.chunk(
+        SCHEDULER_TAG, savedEventCount(processor) * sizeof(SavedEvent));
+    for (const Event &event : processor.scheduler.pendingEvents()) {
+        if (!isMachineEvent(event)) continue;
+
+        SavedEvent saved { event.cycle, (uint32_t)event.type, 0 };
+        std::memcpy(events, &saved, sizeof(saved));
+        events += sizeof(saved);
+    }
+
+    return writer.position() - buffer;
+}
+
+void load(Processor &processor, const byte_t *data, size_t data_size) {
+    uint32_t version = 0;
+    if (data_size < HEADER_SIZE ||
+        std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error("Not a save state");
+    }
+    std::memcpy(&version, data + sizeof(MAGIC), sizeof(version));
+    if (version == 0 || version > VERSION) {
+        throw std::runtime_error("Unsupported save state version " +
+                                 std::to_string(version));
+    }
+
+    // Find every chunk before changing anything
+    const byte_t *cpu = nullptr, *memory = nullptr, *stack = nullptr,
+                 *ppu = nullptr, *framebuffer = nullptr, *joypad = nullptr,
+                 *events = nullptr;
+    size_t event_bytes = 0;
+
+    auto expect = [](const ChunkHeader &header, size_t size) {
+        if (header.size != size) {
+            throw std::runtime_error("Save state chunk " +
+                                     std::string(header.tag, 4) +
+                                     " has the wrong size");
+        }
+    };
+
+    const byte_t *in = data + HEADER_SIZE;
+    const byte_t *end = data + data_size;
+    while (in < end) {
+        ChunkHeader header {};
+        if ((size_t)(end - in) < sizeof(header)) {
+            throw std::runtime_error("Save state is truncated");
+        }
+        std::memcpy(&header, in, sizeof(header));
+        in += sizeof(header);
+
+        if ((size_t)(end - in) < header.size) {
+            throw std::runtime_error("Save state is truncated");
+        }
+
+        auto is = [&header](const char (&tag)[4]) {
+            return std::memcmp(header.tag, tag, sizeof(tag)) == 0;
+        };
+
+        if (is(CPU_TAG)) {
+            expect(header, sizeof(CPUState));
+            cpu = in;
+        } else if (is(MEMORY_TAG)) {
+            expect(header, processor.program_memory->size());
+            memory = in;
+        } else if (is(STACK_TAG)) {
+            expect(header, processor.stack->size());
+            stack = in;
+        } else if (is(PPU_TAG)) {
+            expect(header, sizeof(PPUState));
+            ppu = in;
+        } else if (is(FRAMEBUFFER_TAG)) {
+            expect(header, sizeof(framebuffer_t));
+            framebuffer = in;
+        } else if (is(JOYPAD_TAG)) {
+            expect(header, sizeof(JoypadState));
+            joypad = in;
+        } else if (is(SCHEDULER_TAG)) {
+            if (header.size % sizeof(SavedEvent) != 0) {
+                throw std::runtime_error(
+                    "Save state chunk SCHD has the wrong size");
+            }
+            events = in;
+            event_bytes = header.size;
+        }
+
+        in += header.size;
+    }
+
+    if (!cpu || !memory || !stack || !ppu || !events) {
+        throw std::runtime_error("Save state is missing a chunk");
+    }
+
+    std::vector<Event> pending {};
+    for (size_t offset = 0; offset < event_bytes; offset += sizeof(SavedEvent)) {
+        SavedEvent saved {};
+        std::memcpy(&saved, events + offset, sizeof(saved));
+        if (saved.type >= (uint32_t)EventType::NumberOfEventTypes) {
+            throw std::runtime_error("Save state has an unknown event");
+        }
+        pending.push_back({ saved.cycle, (EventType)saved.type });
+    }
+
+    CPUState cpu_state {};
+    std::memcpy(&cpu_state, cpu, sizeof(cpu_state));
+    processor.setCPUState(cpu_state);
+
+    processor.program_memory->copyFrom(memory);
+    processor.stack->copyFrom(stack);
+
+    PPUState ppu_state {};
+    std::memcpy(&ppu_state, ppu, sizeof(ppu_state));
+    processor.ppu->restoreState(ppu_state);
+
+    if (framebuffer) {
+        framebuffer_t pixels {};
+        std::memcpy(pixels.data(), framebuffer, sizeof(pixels));
+        processor.ppu->restoreFramebuffer(pixels);
+    }
+
+    if (joypad) {
+        JoypadState joypad_state {};
+        std::memcpy(&joypad_state, joypad, sizeof(joypad_state));
+        processor.joypad->restoreState(joypad_state);
+    }
+
+    processor.scheduler.restoreEvents(pending);
+}
+
+}  // namespace SaveState
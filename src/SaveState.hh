@@ -0,0 +1,56 @@
+#pragma once
+
+// System headers
+#include <cstddef>
+#include <cstdint>
+
+// User headers
+#include "Constants.hh"
+
+class Processor;
+
+/**
+ *  Save states of the whole machine: CPU registers, memory, PPU and pending
+ *  scheduler events.
+ *
+ *  The format is a header (MAGIC, then VERSION as uint32) followed by chunks,
+ *  each a four character tag, a uint32 payload size and the payload. Payloads
+ *  are the plain structs and memory copied as they are, so saving and loading
+ *  is a handful of memcpy calls. Loaders skip chunks they don't know, and
+ *  reject known chunks of the wrong size, so chunks can be added without
+ *  breaking older states. All values are in host byte order.
+ *
+ *  The framebuffer chunk is optional. States without it are smaller and
+ *  compress better, and the picture comes back with the next frame. States
+ *  from before the joypad chunk keep the current joypad state.
+ *
+ *  The FIFO renderer's progress through the current line isn't saved. A
+ *  state saved during pixel transfer, such as at a breakpoint, carries on
+ *  that line with whatever the loading renderer had, so the rest of it may
+ *  come out wrong; the next line starts afresh. States saved between frames
+ *  are not affected.
+ */
+namespace SaveState {
+
+constexpr char MAGIC[8] = { 'G', 'B', 'S', 'T', 'A', 'T', 'E', 0 };
+constexpr uint32_t VERSION = 1;
+
+/**
+ *  Bytes needed to save the current state of processor.
+ */
+size_t size(const Processor &processor, bool with_framebuffer = true);
+
+/**
+ *  Writes the state of processor to buffer. Returns the number of bytes
+ *  written. Throws std::runtime_error if the buffer is too small.
+ */
+size_t save(const Processor &processor, byte_t *buffer, size_t buffer_size,
+            bool with_framebuffer = true);
+
+/**
+ *  Restores a state written by save(). Throws std::runtime_error, without
+ *  changing anything, if data isn't a complete state this version can load.
+ */
+void load(Processor &processor, const byte_t *data, size_t data_size);
+
+}  // namespace SaveState
@@ -0,0 +1,90 @@
+// System headers
+#include <algorithm>
+
+// User headers
+#include "ScanlineRenderer.hh"
+
+unsigned ScanlineRenderer::beginLine() {
+    state.line_x = 0;
+    return LCD::PIXEL_TRANSFER_DOTS;
+}
+
+void ScanlineRenderer::renderUpTo(unsigned dot) {
+    unsigned x_end = std::min(dot, LCD::SCREEN_WIDTH);
+    if (x_end <= state.line_x) return;
+
+    // Skipped pixels count as rendered too, so the state is the same
+    // whether or not anyone looks at them
+    if (state.output_wanted) {
+        renderSpan(state.line_x, x_end);
+    } else {
+        skipLine();
+    }
+    state.line_x = (byte_t)x_end;
+}
+
+void ScanlineRenderer::finishLine() { renderUpTo(LCD::SCREEN_WIDTH); }
+
+void ScanlineRenderer::renderSpan(unsigned x_begin, unsigned x_end) {
+    byte_t *row = &framebuffer[state.line * LCD::SCREEN_WIDTH];
+
+    bool bg_enabled = state.lcdc & LCD::LCDC_BG_ENABLE;
+    bool window_on_line = windowOnLine();
+    bool obj_enabled = state.lcdc & LCD::LCDC_OBJ_ENABLE;
+
+    // The tile row is only fetched again when the tile changes
+    register16_t cached_map = 0;
+    int cached_tile_x = -1;
+    TileRow tile_row {};
+
+    for (unsigned x = x_begin; x < x_end; ++x) {
+        byte_t color = 0;
+
+        if (bg_enabled) {
+            register16_t map;
+            byte_t px, py;
+            if (window_on_line && x + 7 >= state.wx) {
+                map = windowMap();
+                px = (byte_t)(x + 7 - state.wx);
+                py = state.window_line;
+                state.window_drawn = true;
+            } else {
+                map = backgroundMap();
+                px = (byte_t)(x + state.scx);
+                py = (byte_t)(state.line + state.scy);
+            }
+
+            if (map != cached_map || px / 8 != cached_tile_x) {
+                tile_row = fetchBackgroundRow(map, px / 8, py);
+                cached_map = map;
+                cached_tile_x = px / 8;
+            }
+
+            color = tileRowPixel(tile_row, 7 - px % 8);
+        }
+
+        row[x] = applyPalette(state.bgp, color);
+
+        if (!obj_enabled) continue;
+
+        // The first sprite (in priority order) with an opaque pixel wins
+        for (unsigned s = 0; s < state.sprite_count; ++s) {
+            register16_t entry = LCD::OAM_START + state.sprites[s] * 4;
+            int sprite_x = memory.peek(entry + 1) - 8;
+            if ((int)x < sprite_x || (int)x >= sprite_x + 8) continue;
+
+            byte_t attributes = memory.peek(entry + 3);
+            unsigned px = x - sprite_x;
+            unsigned bit = (attributes & 0x20) ? px : 7 - px;
+            byte_t sprite_color =
+                tileRowPixel(fetchSpriteRow(state.sprites[s]), bit);
+            if (sprite_color == 0) continue;
+
+            if (!(attributes & 0x80) || color == 0) {
+                byte_t palette = (attributes & 0x10) ? state.obp1 : state.obp0;
+                row[x] = applyPalette(palette, sprite_color);
+            }
+            break;
+        }
+    }
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+// User headers
+#include "PPURenderer.hh"
+
+/**
+ *  Fast renderer that draws whole scanlines (or spans of them, when a
+ *  register is written mid-line) with a fixed pixel transfer length. One dot
+ *  of pixel transfer is treated as one pixel.
+ */
+class ScanlineRenderer : public PPURenderer {
+   public:
+    using PPURenderer::PPURenderer;
+
+    unsigned beginLine() override;
+    void renderUpTo(unsigned dot) override;
+    void finishLine() override;
+
+   private:
+    void renderSpan(unsigned x_begin, unsigned x_end);
+};
@@ -0,0 +1,47 @@
+#include <algorithm>
+
+#include "Scheduler.hh"
+
+void Scheduler::setHandler(EventType type, event_handler handler) {
+    handlers[(size_t)type] = handler;
+}
+
+void Scheduler::schedule(EventType type, uint64_t cycle) {
+    deschedule(type);
+
+    auto position = std::upper_bound(
+        events.begin(), events.end(), cycle,
+        [](uint64_t c, const Event &event) { return c < event.cycle; });
+    events.insert(position, { cycle, type });
+
+    next_event = events.front().cycle;
+}
+
+void Scheduler::deschedule(EventType type) {
+    auto it = std::find_if(events.begin(), events.end(),
+                           [type](const Event &e) { return e.type == type; });
+    if (it == events.end()) return;
+
+    events.erase(it);
+    next_event = events.empty() ? NO_EVENT : events.front().cycle;
+}
+
+void Scheduler::restoreEvents(const std::vector<Event> &pending) {
+    events = pending;
+    std::stable_sort(events.begin(), events.end(),
+                     [](const Event &a, const Event &b) {
+                         return a.cycle < b.cycle;
+                     });
+    next_event = events.empty() ? NO_EVENT : events.front().cycle;
+}
+
+void Scheduler::runUntil(uint64_t now) {
+    while (!events.empty() && events.front().cycle <= now) {
+        Event event = events.front();
+        events.erase(events.begin());
+        next_event = events.empty() ? NO_EVENT : events.front().cycle;
+
+        // The handler may schedule new events, including its own type
+        handlers[(size_t)event.type](event.cycle);
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+// System headers
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+// User headers
+#include "Constants.hh"
+
+/**
+ *  Kinds of events that can be scheduled. Each type can only be pending once,
+ *  scheduling an already pending type moves it.
+ */
+enum class EventType : uint8_t {
+    PPULineStart,
+    PPUHBlank,
+    ProfilerSample,
+    NumberOfEventTypes
+};
+
+struct Event {
+    uint64_t cycle;
+    EventType type;
+};
+
+using event_handler = std::function<void(uint64_t)>;
+
+/**
+ *  Keeps track of hardware events in clock cycles so that the components only
+ *  do work when something observable happens, instead of being stepped after
+ *  every instruction. The instruction decoder only has to compare the current
+ *  clock cycle against nextEventCycle().
+ */
+class Scheduler {
+   public:
+    static constexpr uint64_t NO_EVENT = std::numeric_limits<uint64_t>::max();
+
+    /**
+     *  Sets the function that is called when an event of the given type is
+     *  due. The handler receives the cycle the event was scheduled at.
+     */
+    void setHandler(EventType type, event_handler handler);
+
+    /**
+     *  Schedules an event of the given type at the given clock cycle.
+     */
+    void schedule(EventType type, uint64_t cycle);
+
+    /**
+     *  Removes a pending event of the given type, if there is one.
+     */
+    void deschedule(EventType type);
+
+    /**
+     *  Dispatches all events that are due at or before now, in order.
+     */
+    void runUntil(uint64_t now);
+
+    uint64_t nextEventCycle() const { return next_event; }
+
+    const std::vector<Event> &pendingEvents() const { return events; }
+
+    /**
+     *  Replaces every pending event, for restoring a save state.
+     */
+    void restoreEvents(const std::vector<Event> &pending);
+
+   private:
+    // Sorted by cycle, the front is the next event to fire
+    std::vector<Event> events {};
+    uint64_t next_event { NO_EVENT };
+
+    std::array<event_handler, (size_t)EventType::NumberOfEventTypes>
+        handlers {};
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+// System headers
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/**
+ *  Single writer sequence lock for small plain data. The writer never waits;
+ *  readers retry if they raced with a write, and give up (keeping their old
+ *  copy) if they keep losing.
+ */
+template <typename T>
+class SeqLock {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "SeqLock values are copied with memcpy");
+
+   public:
+    void store(const T &value) {
+        uint32_t sequence = this->sequence.load(std::memory_order_relaxed);
+
+        // Odd while a write is in progress
+        this->sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        std::memcpy(&data, &value, sizeof(T));
+
+        this->sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    /**
+     *  Copies the latest complete value into out. Returns false (leaving out
+     *  untouched) if no consistent copy could be made.
+     */
+    bool load(T &out, unsigned attempts = 16) const {
+        T copy {};
+        for (unsigned i = 0; i < attempts; ++i) {
+            uint32_t before = sequence.load(std::memory_order_acquire);
+            if (before & 1) continue;
+
+            std::memcpy(&copy, &data, sizeof(T));
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            if (sequence.load(std::memory_order_relaxed) == before) {
+                out = copy;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+   private:
+    std::atomic<uint32_t> sequence { 0 };
+    T data {};
+};
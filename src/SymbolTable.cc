@@ -0,0 +1,70 @@
+// System headers
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+// User headers
+#include "SymbolTable.hh"
+
+bool SymbolTable::load(const std::string &filename) {
+    std::ifstream file { filename };
+    if (!file.is_open()) return false;
+
+    std::vector<Symbol> loaded {};
+
+    std::string line {};
+    while (std::getline(file, line)) {
+        line = line.substr(0, line.find(';'));
+
+        std::istringstream in { line };
+        std::string location {}, name {};
+        if (!(in >> location >> name)) continue;
+
+        size_t colon = location.find(':');
+        if (colon == std::string::npos) continue;
+
+        try {
+            unsigned bank = std::stoul(location.substr(0, colon), nullptr, 16);
+            unsigned address = std::stoul(location.substr(colon + 1), nullptr, 16);
+            if (address > PC_MAX) continue;
+
+            // Local labels belong to their parent
+            name = name.substr(0, name.find('.'));
+
+            loaded.push_back({ (byte_t)bank, (register16_t)address, name });
+        } catch (const std::exception &) {
+            continue;
+        }
+    }
+
+    std::sort(loaded.begin(), loaded.end(),
+              [](const Symbol &a, const Symbol &b) {
+                  return a.bank != b.bank ? a.bank < b.bank
+                                          : a.address < b.address;
+              });
+    symbols = std::move(loaded);
+
+    return true;
+}
+
+std::string SymbolTable::functionName(register16_t address) const {
+    byte_t bank = bankOf(address);
+
+    // Last symbol at or before the address, in the same bank
+    auto it = std::upper_bound(
+        symbols.begin(), symbols.end(), std::make_pair(bank, address),
+        [](const std::pair<byte_t, register16_t> &key, const Symbol &symbol) {
+            return key.first != symbol.bank ? key.first < symbol.bank
+                                            : key.second < symbol.address;
+        });
+
+    if (it != symbols.begin() && std::prev(it)->bank == bank) {
+        return std::prev(it)->name;
+    }
+
+    std::ostringstream location {};
+    location << std::hex << std::uppercase << std::setfill('0') << std::setw(2)
+             << (unsigned)bank << ":" << std::setw(4) << address;
+    return location.str();
+}
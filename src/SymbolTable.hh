@@ -0,0 +1,50 @@
+#pragma once
+
+// System headers
+#include <string>
+#include <vector>
+
+// User headers
+#include "Constants.hh"
+
+/**
+ *  Labels from an RGBDS .sym file ("BB:AAAA Label" lines), for naming guest
+ *  functions in profiles.
+ *
+ *  Without a memory bank controller the bank follows from the address (ROMX
+ *  is bank 1), so addresses map one to one to (bank, address) pairs.
+ */
+class SymbolTable {
+   public:
+    /**
+     *  Replaces the labels with the ones in filename. Local labels
+     *  (Parent.local) are counted towards their parent. Returns false, without
+     *  changing anything, if the file can't be read.
+     */
+    bool load(const std::string &filename);
+
+    bool empty() const { return symbols.empty(); }
+
+    /**
+     *  Name of the function address is in: the closest label at or before it
+     *  in the same bank, or "BB:AAAA" if there is none.
+     */
+    std::string functionName(register16_t address) const;
+
+    /**
+     *  Bank of an address, as used in symbol files.
+     */
+    static byte_t bankOf(register16_t address) {
+        return address >= 0x4000 && address < 0x8000 ? 1 : 0;
+    }
+
+   private:
+    struct Symbol {
+        byte_t bank;
+        register16_t address;
+        std::string name;
+    };
+
+    // Sorted by bank and address
+    std::vector<Symbol> symbols {};
+};
@@ -0,0 +1,283 @@
+// System headers
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+// User headers
+#include "Processor.hh"
+#include "TraceRecorder.hh"
+
+constexpr char TraceRecorder::MAGIC[8];
+
+namespace {
+
+constexpr size_t GROUP_SIZE = 8;
+constexpr size_t NUMBER_OF_GROUPS = sizeof(TraceRecord) / GROUP_SIZE;
+
+// Records are written to the file in batches of about this many bytes
+constexpr size_t WRITE_BATCH_SIZE = 1 << 16;
+
+/**
+ *  Decodes the record following previous, getting its bytes after the
+ *  group mask from next(), and makes it the new previous.
+ */
+template <typename Next>
+void decodeRecord(byte_t group_mask, Next next, TraceRecord &previous,
+                  uint64_t &previous_cycle, TraceRecord &record) {
+    byte_t bytes[sizeof(TraceRecord)];
+    std::memcpy(bytes, &previous, sizeof(TraceRecord));
+
+    for (size_t group = 0; group < NUMBER_OF_GROUPS; ++group) {
+        if (!(group_mask & (1 << group))) continue;
+
+        byte_t byte_mask = next();
+        for (size_t i = 0; i < GROUP_SIZE; ++i) {
+            if (byte_mask & (1 << i)) bytes[group * GROUP_SIZE + i] = next();
+        }
+    }
+
+    std::memcpy(&previous, bytes, sizeof(TraceRecord));
+    record = previous;
+    record.cycle = previous_cycle + previous.cycle;
+    previous_cycle = record.cycle;
+}
+
+[[noreturn]] void truncatedRecord() {
+    throw std::runtime_error("Trace ends in the middle of a record");
+}
+
+char *appendHex(char *out, unsigned value, unsigned digits) {
+    static const char hex[] = "0123456789ABCDEF";
+    for (unsigned i = digits; i > 0; --i) {
+        *out++ = hex[(value >> ((i - 1) * 4)) & 0x0F];
+    }
+    return out;
+}
+
+char *appendField(char *out, const char *name, unsigned value,
+                  unsigned digits) {
+    while (*name) *out++ = *name++;
+    *out++ = ':';
+    return appendHex(out, value, digits);
+}
+
+}  // namespace
+
+size_t formatTraceLine(const TraceRecord &record, char *buffer) {
+    char *out = buffer;
+    out = appendField(out, "A", record.af >> 8, 2);
+    out = appendField(out, " F", record.af & 0xFF, 2);
+    out = appendField(out, " B", record.bc >> 8, 2);
+    out = appendField(out, " C", record.bc & 0xFF, 2);
+    out = appendField(out, " D", record.de >> 8, 2);
+    out = appendField(out, " E", record.de & 0xFF, 2);
+    out = appendField(out, " H", record.hl >> 8, 2);
+    out = appendField(out, " L", record.hl & 0xFF, 2);
+    out = appendField(out, " SP", record.sp, 4);
+    out = appendField(out, " PC", record.pc, 4);
+    out = appendField(out, " PCMEM", record.pcmem[0], 2);
+    for (int i = 1; i < 4; ++i) {
+        *out++ = ',';
+        out = appendHex(out, record.pcmem[i], 2);
+    }
+    *out = '\0';
+
+    return out - buffer;
+}
+
+void TraceEncoder::encode(const TraceRecord &record, std::vector<byte_t> &out) {
+    TraceRecord delta = record;
+    delta.cycle = record.cycle - previous_cycle;
+
+    byte_t current[sizeof(TraceRecord)];
+    byte_t last[sizeof(TraceRecord)];
+    std::memcpy(current, &delta, sizeof(TraceRecord));
+    std::memcpy(last, &previous, sizeof(TraceRecord));
+
+    size_t group_mask_position = out.size();
+    out.push_back(0);
+
+    byte_t group_mask = 0;
+    for (size_t group = 0; group < NUMBER_OF_GROUPS; ++group) {
+        const byte_t *now = current + group * GROUP_SIZE;
+        const byte_t *before = last + group * GROUP_SIZE;
+        if (std::memcmp(now, before, GROUP_SIZE) == 0) continue;
+
+        group_mask |= 1 << group;
+        size_t byte_mask_position = out.size();
+        out.push_back(0);
+
+        byte_t byte_mask = 0;
+        for (size_t i = 0; i < GROUP_SIZE; ++i) {
+            if (now[i] == before[i]) continue;
+            byte_mask |= 1 << i;
+            out.push_back(now[i]);
+        }
+        out[byte_mask_position] = byte_mask;
+    }
+    out[group_mask_position] = group_mask;
+
+    previous = delta;
+    previous_cycle = record.cycle;
+}
+
+const byte_t *TraceDecoder::decode(const byte_t *in, const byte_t *end,
+                                   TraceRecord &record) {
+    byte_t group_mask = *in++;
+    decodeRecord(
+        group_mask,
+        [&in, end] {
+            if (in == end) truncatedRecord();
+            return *in++;
+        },
+        previous, previous_cycle, record);
+    return in;
+}
+
+void checkTraceHeader(const byte_t *header, size_t size,
+                      const std::string &filename) {
+    const size_t magic_size = sizeof(TraceRecorder::MAGIC);
+    if (size < TraceRecorder::HEADER_SIZE ||
+        std::memcmp(header, TraceRecorder::MAGIC, magic_size) != 0) {
+        throw std::runtime_error(filename + " is not a trace file");
+    }
+
+    uint32_t version = 0;
+    uint32_t record_size = 0;
+    std::memcpy(&version, header + magic_size, sizeof(version));
+    std::memcpy(&record_size, header + magic_size + sizeof(version),
+                sizeof(record_size));
+    if (version != TraceRecorder::VERSION ||
+        record_size != sizeof(TraceRecord)) {
+        throw std::runtime_error(filename + " has an unsupported version");
+    }
+}
+
+TraceReader::TraceReader(const std::string &filename)
+    : file { filename, std::ios::binary } {
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open trace " + filename);
+    }
+
+    char header[TraceRecorder::HEADER_SIZE];
+    file.read(header, sizeof(header));
+    checkTraceHeader(reinterpret_cast<const byte_t *>(header), file.gcount(),
+                     filename);
+}
+
+bool TraceReader::next(TraceRecord &record) {
+    int group_mask = file.get();
+    if (group_mask == EOF) return false;
+
+    decodeRecord(
+        group_mask,
+        [this] {
+            int value = file.get();
+            if (value == EOF) truncatedRecord();
+            return (byte_t)value;
+        },
+        previous, previous_cycle, record);
+    return true;
+}
+
+TraceRecorder::~TraceRecorder() { stop(); }
+
+bool TraceRecorder::start(const std::string &filename) {
+    stop();
+
+    file.open(filename, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) return false;
+
+    uint32_t version = VERSION;
+    uint32_t record_size = sizeof(TraceRecord);
+    file.write(MAGIC, sizeof(MAGIC));
+    file.write(reinterpret_cast<const char *>(&version), sizeof(version));
+    file.write(reinterpret_cast<const char *>(&record_size),
+               sizeof(record_size));
+
+    if (ring.empty()) ring.resize(RING_SIZE);
+    head.store(0);
+    tail.store(0);
+    writing.store(true);
+    writer = std::thread(&TraceRecorder::writeLoop, this);
+    recording = true;
+
+    return true;
+}
+
+void TraceRecorder::stop() {
+    if (!recording) return;
+
+    recording = false;
+    writing.store(false);
+    writer.join();
+    file.close();
+}
+
+void TraceRecorder::record(const Processor &processor) {
+    uint64_t index = head.load(std::memory_order_relaxed);
+
+    // Full, wait for the writer rather than dropping records
+    while (index - tail.load(std::memory_order_acquire) >= RING_SIZE) {
+        std::this_thread::yield();
+    }
+
+    TraceRecord &record = ring[index & RING_MASK];
+    register16_t pc = processor.PC->getValue();
+
+    record.cycle = processor.clock_cycles;
+    record.pc = pc;
+    record.sp = processor.SP->getValue();
+    record.af = processor.AF->getValue();
+    record.bc = processor.BC->getValue();
+    record.de = processor.DE->getValue();
+    record.hl = processor.HL->getValue();
+
+    // No bank switching, everything is in bank 0
+    record.bank = 0;
+    record.ime = processor.interrupts_enabled;
+
+    for (int i = 0; i < 4; ++i) {
+        record.pcmem[i] = processor.program_memory->peek(pc + i);
+    }
+    std::memset(record.reserved, 0, sizeof(record.reserved));
+
+    head.store(index + 1, std::memory_order_release);
+}
+
+void TraceRecorder::writeLoop() {
+    TraceEncoder encoder {};
+    std::vector<byte_t> buffer {};
+    buffer.reserve(WRITE_BATCH_SIZE + 8 * sizeof(TraceRecord));
+
+    for (;;) {
+        // Read the flag first, so that after it's cleared one more pass
+        // picks up everything that was recorded
+        bool stopping = !writing.load();
+
+        uint64_t end = head.load(std::memory_order_acquire);
+        uint64_t index = tail.load(std::memory_order_relaxed);
+
+        while (index != end) {
+            encoder.encode(ring[index & RING_MASK], buffer);
+            ++index;
+
+            if (buffer.size() >= WRITE_BATCH_SIZE) {
+                file.write(reinterpret_cast<const char *>(buffer.data()),
+                           buffer.size());
+                buffer.clear();
+            }
+
+            // Give room back regularly, the emulation thread may be waiting
+            if ((index & 0xFF) == 0) {
+                tail.store(index, std::memory_order_release);
+            }
+        }
+        tail.store(index, std::memory_order_release);
+
+        if (stopping) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    file.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+// System headers
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// User headers
+#include "Constants.hh"
+
+class Processor;
+
+/**
+ *  CPU state before one instruction, as stored in a trace.
+ */
+struct TraceRecord {
+    uint64_t cycle;
+    uint16_t pc, sp, af, bc, de, hl;
+    uint8_t bank;
+    uint8_t ime;
+
+    // Memory at PC: the opcode and its operands (and whatever follows)
+    uint8_t pcmem[4];
+
+    uint8_t reserved[6];
+};
+
+static_assert(sizeof(TraceRecord) == 32, "TraceRecord must stay packed");
+
+/**
+ *  Formats the record as one line in the format commonly used for reference
+ *  logs of other emulators:
+ *
+ *      A:01 F:B0 B:00 C:13 D:00 E:D8 H:01 L:4D SP:FFFE PC:0100 PCMEM:00,C3,..
+ *
+ *  buffer needs room for TRACE_LINE_SIZE characters. Returns the length,
+ *  without the terminating null.
+ */
+constexpr size_t TRACE_LINE_SIZE = 80;
+size_t formatTraceLine(const TraceRecord &record, char *buffer);
+
+/**
+ *  Delta compression of trace records. Each record is stored as the bytes
+ *  that differ from the previous one (with the cycle as a difference to the
+ *  previous cycle), behind a two level mask: one byte saying which 8 byte
+ *  groups changed, then one byte per changed group saying which bytes did.
+ *  Consecutive instructions usually differ in PC, a register or two and the
+ *  opcode bytes, so most records take around a dozen bytes.
+ */
+class TraceEncoder {
+   public:
+    void encode(const TraceRecord &record, std::vector<byte_t> &out);
+
+   private:
+    TraceRecord previous {};
+    uint64_t previous_cycle { 0 };
+};
+
+/**
+ *  Decodes the records of a TraceEncoder from memory, such as a mapped
+ *  trace file.
+ */
+class TraceDecoder {
+   public:
+    /**
+     *  Decodes the record at in, which must be before end. Returns the
+     *  position after it. Throws std::runtime_error if the record runs past
+     *  end.
+     */
+    const byte_t *decode(const byte_t *in, const byte_t *end,
+                         TraceRecord &record);
+
+   private:
+    TraceRecord previous {};
+    uint64_t previous_cycle { 0 };
+};
+
+/**
+ *  Checks the header at the start of a trace file, of which size bytes are
+ *  given. Throws std::runtime_error naming filename unless it's a trace of
+ *  this version.
+ */
+void checkTraceHeader(const byte_t *header, size_t size,
+                      const std::string &filename);
+
+/**
+ *  Reads a trace file written by TraceRecorder.
+ */
+class TraceReader {
+   public:
+    /**
+     *  Opens the file and checks its header. Throws std::runtime_error if
+     *  it's not a trace file.
+     */
+    explicit TraceReader(const std::string &filename);
+
+    /**
+     *  Reads the next record. Returns false at the end of the trace.
+     */
+    bool next(TraceRecord &record);
+
+   private:
+    std::ifstream file;
+    TraceRecord previous {};
+    uint64_t previous_cycle { 0 };
+};
+
+/**
+ *  Records the CPU state before every instruction to a compressed binary
+ *  file. The emulation thread only copies a fixed size record into a ring
+ *  buffer; a background thread compresses and writes them. If the writer
+ *  falls behind, the emulation thread waits for room so no records are lost.
+ *
+ *  Start and stop only while the emulator isn't running.
+ */
+class TraceRecorder {
+   public:
+    static constexpr char MAGIC[8] = { 'G', 'B', 'T', 'R', 'A', 'C', 'E', 0 };
+    static constexpr uint32_t VERSION = 1;
+
+    // Magic, version and record size, followed by the encoded records
+    static constexpr size_t HEADER_SIZE =
+        sizeof(MAGIC) + 2 * sizeof(uint32_t);
+
+    TraceRecorder() = default;
+    ~TraceRecorder();
+
+    // Weffc++
+    TraceRecorder(const TraceRecorder &) = delete;
+    void operator=(const TraceRecorder &) = delete;
+
+    /**
+     *  Starts recording to filename, replacing it. Returns false if the file
+     *  couldn't be created.
+     */
+    bool start(const std::string &filename);
+
+    /**
+     *  Writes out everything recorded so far and closes the file.
+     */
+    void stop();
+
+    bool isRecording() const { return recording; }
+
+    /**
+     *  Adds the current state of processor to the trace. Only called by the
+     *  thread running the emulator.
+     */
+    void record(const Processor &processor);
+
+    uint64_t recordedCount() const {
+        return head.load(std::memory_order_relaxed);
+    }
+
+   private:
+    static constexpr uint64_t RING_SIZE = 1 << 16;
+    static constexpr uint64_t RING_MASK = RING_SIZE - 1;
+
+    // Allocated by the first start(), most emulators never record
+    std::vector<TraceRecord> ring {};
+
+    // Records written by the emulation thread and taken by the writer
+    std::atomic<uint64_t> head { 0 };
+    std::atomic<uint64_t> tail { 0 };
+
+    bool recording { false };
+    std::atomic<bool> writing { false };
+    std::thread writer {};
+    std::ofstream file {};
+
+    void writeLoop();
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+// System headers
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/**
+ *  Lock free single producer, single consumer triple buffer. The writer
+ *  always has a buffer to fill and the reader always has a complete buffer
+ *  to read, so neither side ever waits for the other. Values published
+ *  while the reader is busy replace each other, the reader only sees the
+ *  latest.
+ */
+template <typename T>
+class TripleBuffer {
+   public:
+    /**
+     *  Buffer owned by the writer, to be filled before publish().
+     */
+    T &writeBuffer() { return buffers[back]; }
+
+    /**
+     *  Makes the write buffer the latest value and gives the writer a new
+     *  buffer to fill.
+     */
+    void publish() {
+        uint8_t previous =
+            middle.exchange(back | FRESH, std::memory_order_acq_rel);
+        back = previous & INDEX_MASK;
+    }
+
+    /**
+     *  Picks up the latest published value, if there is a new one. Returns
+     *  true if readBuffer() changed.
+     */
+    bool update() {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH)) return false;
+
+        uint8_t previous = middle.exchange(front, std::memory_order_acq_rel);
+        front = previous & INDEX_MASK;
+        return true;
+    }
+
+    /**
+     *  Buffer owned by the reader, valid until the next update().
+     */
+    const T &readBuffer() const { return buffers[front]; }
+
+   private:
+    static constexpr uint8_t INDEX_MASK = 0x03;
+    static constexpr uint8_t FRESH = 0x04;
+
+    std::array<T, 3> buffers {};
+
+    // Index of the buffer between writer and reader, with the FRESH bit set
+    // when it holds a value the reader hasn't seen
+    std::atomic<uint8_t> middle { 1 };
+
+    uint8_t back { 0 };
+    uint8_t front { 2 };
+};
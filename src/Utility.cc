@@ -28,4 +28,27 @@ std::string hexString(unsigned value, unsigned length) {
 
     return ss.str();
 }
+
+char *hexFormat(char *buffer, unsigned value, unsigned length) {
+    static const char digits[] = "0123456789ABCDEF";
+
+    *buffer++ = '0';
+    *buffer++ = 'x';
+    for (unsigned i = length; i > 0; --i) {
+        *buffer++ = digits[(value >> ((i - 1) * 4)) & 0x0F];
+    }
+    *buffer = '\0';
+
+    return buffer;
+}
+
+uint64_t hashBytes(const byte_t *data, size_t size) {
+    uint64_t hash = 0xCBF29CE484222325;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= data[i];
+        hash *= 0x100000001B3;
+    }
+
+    return hash;
+}
 }  // namespace Util
\ No newline at end of file
@@ -14,4 +14,35 @@ std::ostream &operator<<(std::ostream &os,
 void hexPrint(unsigned value, unsigned length, bool flush = false);
 std::string hexString(unsigned value, unsigned length);
 
+/**
+ *  Writes value as "0x" followed by length uppercase hex digits into buffer,
+ *  which must have room for length + 3 characters. Returns a pointer to the
+ *  terminating null, so calls can be chained. Doesn't allocate.
+ */
+char *hexFormat(char *buffer, unsigned value, unsigned length);
+
+/**
+ *  64 bit FNV-1a hash of the given bytes.
+ */
+uint64_t hashBytes(const byte_t *data, size_t size);
+
+/**
+ *  The splitmix64 finalizer: a cheap bijective scramble of x, good enough to
+ *  derive independent looking hash keys from counters or addresses.
+ */
+inline uint64_t splitmix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EB;
+    return x ^ (x >> 31);
+}
+
+/**
+ *  Combines value into hash, order dependent.
+ */
+inline uint64_t mixHash(uint64_t hash, uint64_t value) {
+    hash = (hash ^ value) * 0x9E3779B97F4A7C15;
+    return hash ^ (hash >> 32);
+}
+
 }  // namespace Util
\ No newline at end of file
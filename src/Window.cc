@@ -1,14 +1,28 @@
 #include <math.h>
+#include <algorithm>
+#include <array>
+#include <fstream>
 #include <sstream>
 
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
 
+#include "Emulator.hh"
+#include "EmulatorThread.hh"
 #include "InstructionDecoder.hh"
 #include "Processor.hh"
 #include "Window.hh"
 
+// Where traces started from the control box are written
+static const char* const TRACE_FILENAME = "emulator.gbtrace";
+
+// Save state slot of the F5 (save) and F8 (load) hotkeys
+static const char* const SAVE_STATE_FILENAME = "emulator.state";
+
+// Where the call graph box exports collapsed stacks
+static const char* const COLLAPSED_STACKS_FILENAME = "emulator.folded";
+
 static void glfw_error_callback(int error, const char* description) {
     std::cerr << "Glfw Error " << error << ": " << description << std::endl;
 }
@@ -51,19 +65,140 @@ bool Window::createMainWindow(int width, int height, std::string title) {
     ImGui_ImplGlfw_InitForOpenGL(m_window, true);
     ImGui_ImplOpenGL3_Init(glsl_version);
 
+    glGenTextures(1, &m_screen_texture);
+    glBindTexture(GL_TEXTURE_2D, m_screen_texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    update_screen_texture();
+
     return true;
 }
 
+void Window::update_screen_texture() {
+    TripleBuffer<FrameOutput>& frames = m_emulator_thread.frames();
+    if (!frames.update() && m_screen_texture_ready) return;
+    m_screen_texture_ready = true;
+
+    const framebuffer_t& pixels = frames.readBuffer().pixels;
+    std::array<uint32_t, LCD::SCREEN_WIDTH * LCD::SCREEN_HEIGHT> rgba {};
+    for (size_t i = 0; i < pixels.size(); ++i) {
+        rgba[i] = LCD::SHADE_COLORS[pixels[i] & 0x03];
+    }
+
+    glBindTexture(GL_TEXTURE_2D, m_screen_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, LCD::SCREEN_WIDTH,
+                 LCD::SCREEN_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                 rgba.data());
+}
+
+void Window::draw_screen_box() {
+    ImGui::Begin("Screen");
+
+    update_screen_texture();
+    ImGui::Image((void*)(intptr_t)m_screen_texture,
+                 ImVec2(LCD::SCREEN_WIDTH * 3, LCD::SCREEN_HEIGHT * 3));
+
+    ImGui::End();
+}
+
 void Window::draw_cpu_box() {
     ImGui::Begin("CPU info");
 
-    auto cpu_info = m_cpu.getCPUInfo();
+    if (m_emulator_thread.isParked()) {
+        // Nothing else touches the emulator, read it directly so stepping
+        // shows up immediately
+        m_debug_snapshot = m_emulator.processor->getDebugSnapshot();
+        if (!m_emulator_thread.getError().empty()) {
+            ImGui::Text("Stopped: %s", m_emulator_thread.getError().c_str());
+        }
+    } else {
+        m_emulator_thread.debugSnapshot().load(m_debug_snapshot);
+        ImGui::TextUnformatted("Running...");
+    }
 
-    for (auto& x : cpu_info.PM) {
-        if (x.address == cpu_info.PC->getValue()) {
-            ImGui::Text("---> %s", x.str().c_str());
-        } else {
-            ImGui::Text("     %s", x.str().c_str());
+    const DebugSnapshot& snapshot = m_debug_snapshot;
+
+    // Formatted into fixed buffers, nothing here allocates
+    char line[64];
+    char* end = line;
+
+    const char names[] = "ABCDEFHL";
+    const register8_t values[] = { snapshot.A, snapshot.B, snapshot.C,
+                                   snapshot.D, snapshot.E, snapshot.F,
+                                   snapshot.H, snapshot.L };
+    for (int i = 0; i < 8; ++i) {
+        end = line;
+        *end++ = names[i];
+        *end++ = ':';
+        *end++ = ' ';
+        end = Util::hexFormat(end, values[i], 2);
+        ImGui::TextUnformatted(line, end);
+        if (i % 4 != 3) ImGui::SameLine();
+    }
+
+    end = line;
+    end = std::copy_n("SP: ", 4, end);
+    end = Util::hexFormat(end, snapshot.SP, 4);
+    end = std::copy_n("  PC: ", 6, end);
+    end = Util::hexFormat(end, snapshot.PC, 4);
+    ImGui::TextUnformatted(line, end);
+
+    end = line;
+    const char flag_names[] = "ZNHC";
+    for (int i = 0; i < 4; ++i) {
+        bool set = snapshot.F & (0x80 >> i);
+        *end++ = set ? flag_names[i] : '-';
+    }
+    end = std::copy_n("  IME: ", 7, end);
+    *end++ = snapshot.interrupts_enabled ? '1' : '0';
+    ImGui::TextUnformatted(line, end);
+
+    ImGui::Text("Cycles: %llu (%llu M)",
+                (unsigned long long)snapshot.clock_cycles,
+                (unsigned long long)snapshot.machine_cycles);
+    ImGui::Text("Instructions: %llu  Frame: %llu",
+                (unsigned long long)snapshot.executed_instructions,
+                (unsigned long long)snapshot.frame_count);
+
+    ImGui::Separator();
+
+    // Clicking a line toggles a breakpoint on it, lines with one are shown
+    // as selected. Conditions of the ones toggled off while running are
+    // dropped once parked.
+    if (m_emulator_thread.isParked()) {
+        m_emulator.breakpoints.dropClearedConditions();
+    }
+    for (int i = 0; i < snapshot.PM_size; ++i) {
+        register16_t address = snapshot.PM_start + i;
+        byte_t value = snapshot.PM[i];
+        bool breakpoint = m_emulator.breakpoints.test(address);
+        bool conditional =
+            breakpoint && m_emulator.breakpoints.getCondition(address);
+
+        end = line;
+        *end++ = breakpoint ? (conditional ? '?' : '*') : ' ';
+        end = std::copy_n(address == snapshot.PC ? "---> " : "     ", 5, end);
+        end = Util::hexFormat(end, address, 4);
+        end = std::copy_n(": ", 2, end);
+        end = Util::hexFormat(end, value, 2);
+        *end++ = ' ';
+        *end++ = '(';
+
+        // TODO fix for CB instructions
+        const std::string& name = opcode_names[value];
+        size_t length = std::min(name.size(), sizeof(line) - (end - line) - 2);
+        end = std::copy_n(name.data(), length, end);
+        *end++ = ')';
+        *end = '\0';
+
+        if (ImGui::Selectable(line, breakpoint)) {
+            // Conditions can only be dropped while parked, while running
+            // this only flips the breakpoint bit
+            if (m_emulator_thread.isParked() && breakpoint) {
+                m_emulator.breakpoints.remove(address);
+            } else {
+                m_emulator.breakpoints.toggle(address);
+            }
         }
     }
 
@@ -106,15 +241,400 @@ void Window::draw_hello_box() {
     ImGui::End();
 }
 
+void Window::handle_state_hotkeys() {
+    bool save = ImGui::IsKeyPressed(GLFW_KEY_F5, false);
+    bool load = ImGui::IsKeyPressed(GLFW_KEY_F8, false);
+    if (!save && !load) return;
+
+    // The machine is only touched while the emulation thread is parked, and
+    // afterwards it goes on with whatever it was doing, run-to included
+    bool was_running = m_emulator_thread.pauseAndWait();
+
+    try {
+        if (save) {
+            m_emulator.saveStateFile(SAVE_STATE_FILENAME);
+            m_state_message = "Saved state";
+        } else if (m_emulator.movieMode() != MovieMode::None) {
+            // Jumping to another state can't be recorded or played back
+            m_state_message = "Can't load a state during a movie";
+        } else {
+            m_emulator.loadStateFile(SAVE_STATE_FILENAME);
+            m_state_message = "Loaded state";
+        }
+    } catch (const std::exception& ex) {
+        m_state_message = ex.what();
+    }
+
+    if (was_running) m_emulator_thread.unpark();
+}
+
+void Window::handle_joypad_keys() {
+    static const std::array<std::pair<int, byte_t>, 8> keys { {
+        { GLFW_KEY_RIGHT, Buttons::RIGHT },
+        { GLFW_KEY_LEFT, Buttons::LEFT },
+        { GLFW_KEY_UP, Buttons::UP },
+        { GLFW_KEY_DOWN, Buttons::DOWN },
+        { GLFW_KEY_Z, Buttons::A },
+        { GLFW_KEY_X, Buttons::B },
+        { GLFW_KEY_RIGHT_SHIFT, Buttons::SELECT },
+        { GLFW_KEY_ENTER, Buttons::START },
+    } };
+
+    byte_t pressed = 0;
+    if (!ImGui::GetIO().WantCaptureKeyboard) {
+        for (const auto& key : keys) {
+            if (ImGui::IsKeyDown(key.first)) pressed |= key.second;
+        }
+    }
+    m_emulator_thread.setButtons(pressed);
+}
+
 void Window::draw_control_box() {
     ImGui::Begin("CPU controls");
 
     ImGui::Text("Controls for the CPU");
+    ImGui::Text("F5 saves state, F8 loads it, hold Backspace to rewind");
+    if (!m_state_message.empty()) {
+        ImGui::TextUnformatted(m_state_message.c_str());
+    }
+
+    if (m_emulator_thread.isPaused()) {
+        if (ImGui::Button("Run")) m_emulator_thread.resume();
+    } else {
+        if (ImGui::Button("Pause")) m_emulator_thread.pause();
+    }
+
+    // Everything else needs the emulation thread parked
+    if (!m_emulator_thread.isParked()) {
+        ImGui::End();
+        return;
+    }
+
+    // Stepping is done on this thread, which is fine while the emulation
+    // thread is parked. Larger runs go to the emulation thread, which runs
+    // them in batches and pauses when done. Movie inputs belong to whole
+    // frames, so there are neither during a movie.
+    if (m_emulator.movieMode() != MovieMode::None) {
+        ImGui::Text("Can't step or run to a target during a movie");
+    } else {
+        ImGui::SameLine();
+        if (ImGui::Button("Step")) m_emulator_thread.step();
+        if (ImGui::Button("Run N")) {
+            m_emulator_thread.runTo(RunMode::Instructions,
+                                    std::max(1, m_run_instructions));
+        }
+        ImGui::SameLine();
+        ImGui::InputInt("instructions", &m_run_instructions, 100, 10000);
+
+        if (ImGui::Button("Run to PC")) {
+            m_emulator_thread.runTo(RunMode::ToPC, m_run_to_pc);
+        }
+        ImGui::SameLine();
+        ImGui::InputScalar("address", ImGuiDataType_U16, &m_run_to_pc,
+                           nullptr, nullptr, "%04X",
+                           ImGuiInputTextFlags_CharsHexadecimal);
+
+        if (ImGui::Button("Run to next frame")) {
+            m_emulator_thread.runTo(RunMode::ToFrame);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Run to next interrupt")) {
+            m_emulator_thread.runTo(RunMode::ToInterrupt);
+        }
+    }
+
+    // Tracing can only be started and stopped while parked
+    TraceRecorder& trace_recorder = *m_emulator.trace_recorder;
+    if (trace_recorder.isRecording()) {
+        if (ImGui::Button("Stop trace")) trace_recorder.stop();
+        ImGui::SameLine();
+        ImGui::Text("%llu instructions",
+                    (unsigned long long)trace_recorder.recordedCount());
+    } else if (ImGui::Button("Start trace")) {
+        trace_recorder.start(TRACE_FILENAME);
+    }
+
+    RunAhead& run_ahead = *m_emulator.run_ahead;
+    int run_ahead_frames = run_ahead.getFrames();
+    if (ImGui::SliderInt("run ahead", &run_ahead_frames, 0,
+                         RunAhead::MAX_FRAMES)) {
+        run_ahead.setFrames(run_ahead_frames);
+    }
+    bool second_instance = run_ahead.usesSecondInstance();
+    if (ImGui::Checkbox("run ahead on a second instance", &second_instance)) {
+        run_ahead.setSecondInstance(second_instance);
+    }
+
+    ImGui::Separator();
+
+    // Conditional breakpoint at the run to PC address
+    ImGui::InputText("condition", m_condition.data(), m_condition.size());
+    if (ImGui::Button("Set conditional breakpoint")) {
+        try {
+            m_emulator.breakpoints.setConditional(m_run_to_pc,
+                                                  m_condition.data());
+            m_condition_error.clear();
+        } catch (const std::exception& ex) {
+            m_condition_error = ex.what();
+        }
+    }
+    if (!m_condition_error.empty()) {
+        ImGui::TextUnformatted(m_condition_error.c_str());
+    }
+
+    ImGui::End();
+}
+
+void Window::draw_watchpoint_box() {
+    ImGui::Begin("Watchpoints");
+
+    // Watchpoints change the memory page table, so only touch them while
+    // the emulation thread is parked
+    if (!m_emulator_thread.isParked()) {
+        ImGui::TextUnformatted("Pause to edit watchpoints");
+        ImGui::End();
+        return;
+    }
+
+    Memory& memory = *m_emulator.processor->program_memory;
+
+    ImGui::InputScalar("start", ImGuiDataType_U16, &m_watch_start, nullptr,
+                       nullptr, "%04X", ImGuiInputTextFlags_CharsHexadecimal);
+    ImGui::InputScalar("end", ImGuiDataType_U16, &m_watch_end, nullptr,
+                       nullptr, "%04X", ImGuiInputTextFlags_CharsHexadecimal);
+    ImGui::Checkbox("read", &m_watch_read);
+    ImGui::SameLine();
+    ImGui::Checkbox("write", &m_watch_write);
+    ImGui::SameLine();
+    if (ImGui::Button("Add") && (m_watch_read || m_watch_write)) {
+        byte_t access = (m_watch_read ? WATCH_READ : 0) |
+                        (m_watch_write ? WATCH_WRITE : 0);
+        memory.addWatchpoint(m_watch_start, m_watch_end, access);
+    }
+
+    ImGui::Separator();
+
+    const std::vector<Watchpoint>& watchpoints = memory.getWatchpoints();
+    for (size_t i = 0; i < watchpoints.size(); ++i) {
+        const Watchpoint& watchpoint = watchpoints[i];
+
+        char line[32];
+        char* end = Util::hexFormat(line, watchpoint.start, 4);
+        end = std::copy_n(" - ", 3, end);
+        end = Util::hexFormat(end, watchpoint.end, 4);
+        *end++ = ' ';
+        *end++ = watchpoint.access & WATCH_READ ? 'R' : '-';
+        *end++ = watchpoint.access & WATCH_WRITE ? 'W' : '-';
+
+        ImGui::PushID((int)i);
+        ImGui::TextUnformatted(line, end);
+        ImGui::SameLine();
+        bool remove = ImGui::Button("Remove");
+        ImGui::PopID();
+
+        if (remove) {
+            memory.removeWatchpoint(i);
+            break;
+        }
+    }
+
+    ImGui::End();
+}
+
+void Window::draw_profiler_box() {
+    ImGui::Begin("Opcode profile");
+
+    bool profiling = m_emulator.isProfiling();
+    if (ImGui::Checkbox("Enabled", &profiling)) {
+        m_emulator.setProfiling(profiling);
+    }
+    ImGui::SameLine();
+    OpcodeProfiler& profiler = *m_emulator.opcode_profiler;
+    if (ImGui::Button("Reset")) profiler.reset();
+
+    // Executed opcodes, most cycles first. CB opcodes are 0x100 and up.
+    struct Row {
+        unsigned opcode;
+        uint64_t executions;
+        uint64_t cycles;
+    };
+    std::array<Row, NUMBER_OF_INSTRUCTIONS * 2> rows;
+    size_t row_count = 0;
+    uint64_t total_cycles = 0;
+
+    for (unsigned opcode = 0; opcode < rows.size(); ++opcode) {
+        const OpcodeProfiler::Counter& counter =
+            opcode < NUMBER_OF_INSTRUCTIONS
+                ? profiler.getCounter(opcode)
+                : profiler.getCBCounter(opcode - NUMBER_OF_INSTRUCTIONS);
+
+        uint64_t executions = counter.executions.load();
+        if (executions == 0) continue;
+
+        uint64_t cycles = counter.cycles.load();
+        rows[row_count++] = { opcode, executions, cycles };
+        total_cycles += cycles;
+    }
+
+    std::sort(rows.begin(), rows.begin() + row_count,
+              [](const Row& a, const Row& b) { return a.cycles > b.cycles; });
+
+    ImGui::Columns(4, "opcodes");
+    ImGui::TextUnformatted("Opcode");
+    ImGui::NextColumn();
+    ImGui::TextUnformatted("Executions");
+    ImGui::NextColumn();
+    ImGui::TextUnformatted("Cycles");
+    ImGui::NextColumn();
+    ImGui::TextUnformatted("% cycles");
+    ImGui::NextColumn();
+    ImGui::Separator();
+
+    for (size_t i = 0; i < row_count; ++i) {
+        const Row& row = rows[i];
+        bool cb = row.opcode >= NUMBER_OF_INSTRUCTIONS;
+        unsigned opcode = row.opcode % NUMBER_OF_INSTRUCTIONS;
+
+        ImGui::Text("%s%02X %s", cb ? "CB " : "", opcode,
+                    cb ? opcodes_cb_names[opcode].c_str()
+                       : opcode_names[opcode].c_str());
+        ImGui::NextColumn();
+        ImGui::Text("%llu", (unsigned long long)row.executions);
+        ImGui::NextColumn();
+        ImGui::Text("%llu", (unsigned long long)row.cycles);
+        ImGui::NextColumn();
+        ImGui::Text("%.2f", 100.0 * row.cycles / total_cycles);
+        ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+
+    ImGui::End();
+}
+
+void Window::draw_hot_spots_box() {
+    ImGui::Begin("Hot spots");
+
+    SamplingProfiler& profiler = *m_emulator.sampling_profiler;
+
+    // Sampling is a scheduler event, so it's only started and stopped while
+    // the emulation thread is parked
+    if (m_emulator_thread.isParked()) {
+        ImGui::InputInt("interval", &m_sample_interval);
+        if (m_sample_interval < 1) m_sample_interval = 1;
+
+        if (profiler.isRunning()) {
+            if (ImGui::Button("Stop sampling")) profiler.stop();
+        } else if (ImGui::Button("Start sampling")) {
+            profiler.start(m_sample_interval);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Reset")) profiler.reset();
+
+        ImGui::InputText("symbols", m_symbol_file.data(),
+                         m_symbol_file.size());
+        ImGui::SameLine();
+        if (ImGui::Button("Load")) {
+            bool loaded = m_emulator.symbols->load(m_symbol_file.data());
+            m_symbol_error = loaded ? "" : "Could not read symbol file";
+            m_hot_spots_renamed = true;
+        }
+        if (!m_symbol_error.empty()) {
+            ImGui::TextUnformatted(m_symbol_error.c_str());
+        }
+    } else {
+        ImGui::Text("%s, pause to change", profiler.isRunning()
+                                               ? "Sampling"
+                                               : "Not sampling");
+    }
+
+    // Ranking scans every address, which is too slow for every GUI frame
+    uint64_t samples = profiler.totalSamples();
+    double now = ImGui::GetTime();
+    if (m_hot_spots_renamed ||
+        (samples != m_hot_spots_samples &&
+         now - m_hot_spots_time >= HOT_SPOTS_REFRESH)) {
+        m_hot_spots = profiler.topFunctions(20);
+        m_hot_spots_samples = samples;
+        m_hot_spots_time = now;
+        m_hot_spots_renamed = false;
+    }
+
+    uint64_t total_cycles = m_hot_spots_samples * profiler.getInterval();
+    ImGui::Text("%llu samples", (unsigned long long)samples);
+    ImGui::Separator();
+
+    ImGui::Columns(3, "hot spots");
+    ImGui::TextUnformatted("Function");
+    ImGui::NextColumn();
+    ImGui::TextUnformatted("Cycles");
+    ImGui::NextColumn();
+    ImGui::TextUnformatted("% cycles");
+    ImGui::NextColumn();
+    ImGui::Separator();
+
+    for (const SamplingProfiler::HotSpot& spot : m_hot_spots) {
+        ImGui::TextUnformatted(spot.name.c_str());
+        ImGui::NextColumn();
+        ImGui::Text("%llu", (unsigned long long)spot.cycles);
+        ImGui::NextColumn();
+        ImGui::Text("%.2f", 100.0 * spot.cycles / total_cycles);
+        ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+
+    ImGui::End();
+}
 
-    if (ImGui::Button("Step")) {
-        m_instruction_decoder.step();
+void Window::draw_call_graph_box() {
+    ImGui::Begin("Call graph");
+
+    // The shadow stack is only read while the emulation thread is parked
+    if (!m_emulator_thread.isParked()) {
+        ImGui::Text("%s, pause to view", m_emulator.isCallProfiling()
+                                             ? "Profiling"
+                                             : "Not profiling");
+        ImGui::End();
+        return;
     }
 
+    CallProfiler& profiler = *m_emulator.call_profiler;
+    if (profiler.isRunning()) {
+        if (ImGui::Button("Stop")) m_emulator.setCallProfiling(false);
+    } else if (ImGui::Button("Start")) {
+        m_emulator.setCallProfiling(true);
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Export collapsed stacks")) {
+        std::ofstream collapsed { COLLAPSED_STACKS_FILENAME };
+        profiler.writeCollapsed(collapsed, *m_emulator.symbols);
+    }
+    ImGui::Separator();
+
+    ImGui::Columns(4, "functions");
+    ImGui::TextUnformatted("Function");
+    ImGui::NextColumn();
+    ImGui::TextUnformatted("Calls");
+    ImGui::NextColumn();
+    ImGui::TextUnformatted("Inclusive");
+    ImGui::NextColumn();
+    ImGui::TextUnformatted("Exclusive");
+    ImGui::NextColumn();
+    ImGui::Separator();
+
+    for (const CallProfiler::FunctionProfile& function :
+         profiler.topFunctions(20)) {
+        ImGui::TextUnformatted(
+            m_emulator.symbols->functionName(function.address).c_str());
+        ImGui::NextColumn();
+        ImGui::Text("%llu", (unsigned long long)function.calls);
+        ImGui::NextColumn();
+        ImGui::Text("%llu", (unsigned long long)function.inclusive_cycles);
+        ImGui::NextColumn();
+        ImGui::Text("%llu", (unsigned long long)function.exclusive_cycles);
+        ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+
     ImGui::End();
 }
 
@@ -123,9 +643,22 @@ void Window::imgui() {
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
 
+    handle_state_hotkeys();
+
+    handle_joypad_keys();
+
+    // Rewinds for as long as the key is held
+    m_emulator_thread.setRewinding(ImGui::IsKeyDown(GLFW_KEY_BACKSPACE) &&
+                                   !ImGui::GetIO().WantCaptureKeyboard);
+
     draw_hello_box();
+    draw_screen_box();
     draw_cpu_box();
     draw_control_box();
+    draw_watchpoint_box();
+    draw_profiler_box();
+    draw_hot_spots_box();
+    draw_call_graph_box();
 
     // Rendering
     ImGui::Render();
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <string>
 
 #include <GLFW/glfw3.h>
@@ -7,18 +8,28 @@
 #include <glad/glad.h>
 #include <iostream>
 #include <vector>
+#include "Processor.hh"
+#include "SamplingProfiler.hh"
 #include "imgui.h"
 
-class Processor;
-class InstructionDecoder;
+class Emulator;
+class EmulatorThread;
 
 /**
  * Window utilites.
+ *
+ * The window runs on the main thread and never drives emulation itself. It
+ * shows the latest frame published by the emulation thread, and only looks
+ * at emulator state while that thread is parked.
  */
 class Window {
    public:
-    Window(const Processor& cpu, InstructionDecoder& instruction_decoder)
-        : m_cpu { cpu }, m_instruction_decoder { instruction_decoder } {}
+    Window(Emulator& emulator, EmulatorThread& emulator_thread)
+        : m_emulator { emulator }, m_emulator_thread { emulator_thread } {}
+
+    // Weffc++
+    Window(const Window&) = delete;
+    void operator=(const Window&) = delete;
 
     /**
      * Create main game window.
@@ -38,9 +49,25 @@ class Window {
 
     void finish_render();
 
+    /**
+     * Saves (F5) or loads (F8) the state, pausing emulation meanwhile.
+     */
+    void handle_state_hotkeys();
+
+    /**
+     * Passes the held joypad keys (arrows, Z = A, X = B, Enter = Start,
+     * Right Shift = Select) to the emulation thread.
+     */
+    void handle_joypad_keys();
+
     void draw_hello_box();
     void draw_control_box();
     void draw_cpu_box();
+    void draw_screen_box();
+    void draw_watchpoint_box();
+    void draw_profiler_box();
+    void draw_hot_spots_box();
+    void draw_call_graph_box();
 
     /**
      * Destroy.
@@ -48,11 +75,55 @@ class Window {
     void destroy();
 
    private:
-    const Processor& m_cpu;
-    InstructionDecoder& m_instruction_decoder;
+    Emulator& m_emulator;
+    EmulatorThread& m_emulator_thread;
 
     GLFWwindow* m_window { nullptr };
 
+    // Texture holding the latest frame from the emulation thread
+    GLuint m_screen_texture { 0 };
+    bool m_screen_texture_ready { false };
+
+    /**
+     * Uploads the latest published frame, if there is a new one.
+     */
+    void update_screen_texture();
+
+    // Latest CPU state shown in the CPU box. Kept between frames so a failed
+    // read just shows the previous state.
+    DebugSnapshot m_debug_snapshot {};
+
+    // Arguments of the run buttons in the control box
+    int m_run_instructions { 1000 };
+    uint16_t m_run_to_pc { 0x0100 };
+
+    // Expression for a conditional breakpoint at m_run_to_pc
+    std::array<char, 128> m_condition {};
+    std::string m_condition_error {};
+
+    // New watchpoint in the watchpoint box
+    uint16_t m_watch_start { 0xC000 };
+    uint16_t m_watch_end { 0xC000 };
+    bool m_watch_read { false };
+    bool m_watch_write { true };
+
+    // Result of the last save state hotkey
+    std::string m_state_message {};
+
+    // Sampling profiler settings in the hot spots box
+    int m_sample_interval { (int)SamplingProfiler::DEFAULT_INTERVAL };
+    std::array<char, 256> m_symbol_file {};
+    std::string m_symbol_error {};
+
+    // Functions shown in the hot spots box, ranked again at most every
+    // HOT_SPOTS_REFRESH seconds, and only when there are new samples or
+    // new symbols
+    static constexpr double HOT_SPOTS_REFRESH { 0.5 };
+    std::vector<SamplingProfiler::HotSpot> m_hot_spots {};
+    uint64_t m_hot_spots_samples { 0 };
+    double m_hot_spots_time { 0 };
+    bool m_hot_spots_renamed { false };
+
     bool m_show_window { true };
     bool m_show_another_window { true };
 
@@ -0,0 +1,242 @@
+// System headers
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// User headers
+#include "Emulator.hh"
+#include "Environment.hh"
+#include "gbc.h"
+
+static_assert(GBC_SCREEN_WIDTH == LCD::SCREEN_WIDTH &&
+                  GBC_SCREEN_HEIGHT == LCD::SCREEN_HEIGHT,
+              "Screen size of the C interface is out of date");
+static_assert(GBC_BUTTON_RIGHT == Buttons::RIGHT &&
+                  GBC_BUTTON_START == Buttons::START,
+              "Buttons of the C interface are out of date");
+static_assert(GBC_OBS_DOWNSAMPLED ==
+                  static_cast<int>(ObservationFormat::Downsampled) &&
+                  GBC_OBS_SHADES == static_cast<int>(ObservationFormat::Shades),
+              "Observation formats of the C interface are out of date");
+
+struct gbc_emulator {
+    ptr<Emulator> emulator {};
+
+    // Set by every call that can fail, so it's changed by const calls too
+    mutable std::string error {};
+};
+
+struct gbc_env {
+    gbc_emulator *emulator { nullptr };
+    ptr<Environment> environment {};
+};
+
+namespace {
+
+/**
+ *  Runs call, keeping exceptions from reaching the caller. Returns 0, or
+ *  -1 with the error of emulator set.
+ */
+template <typename Call>
+int guarded(const gbc_emulator *emulator, Call call) {
+    try {
+        call();
+        emulator->error.clear();
+        return 0;
+    } catch (const std::exception &ex) {
+        emulator->error = ex.what();
+    } catch (...) {
+        emulator->error = "Unknown error";
+    }
+    return -1;
+}
+
+}  // namespace
+
+int gbc_api_version(void) { return GBC_API_VERSION; }
+
+gbc_emulator *gbc_create(void) {
+    try {
+        gbc_emulator *emulator = new gbc_emulator {};
+        emulator->emulator = std::make_shared<Emulator>();
+        return emulator;
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+gbc_emulator *gbc_clone(gbc_emulator *emulator) {
+    gbc_emulator *copy = nullptr;
+    try {
+        copy = new gbc_emulator {};
+        copy->emulator = emulator->emulator->clone();
+        return copy;
+    } catch (const std::exception &ex) {
+        emulator->error = ex.what();
+    } catch (...) {
+        emulator->error = "Unknown error";
+    }
+    delete copy;
+    return nullptr;
+}
+
+void gbc_destroy(gbc_emulator *emulator) { delete emulator; }
+
+const char *gbc_last_error(const gbc_emulator *emulator) {
+    return emulator ? emulator->error.c_str() : "";
+}
+
+int gbc_load_rom(gbc_emulator *emulator, const char *path) {
+    return guarded(emulator, [&] {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error(std::string("Error reading file ") +
+                                     path);
+        }
+
+        std::vector<uint8_t> data { std::istreambuf_iterator<char>(file),
+                                    std::istreambuf_iterator<char>() };
+        emulator->emulator->loadROM(data.data(), data.size());
+    });
+}
+
+int gbc_load_rom_mem(gbc_emulator *emulator, const uint8_t *data,
+                     size_t size) {
+    return guarded(emulator,
+                   [&] { emulator->emulator->loadROM(data, size); });
+}
+
+void gbc_set_input(gbc_emulator *emulator, uint8_t buttons) {
+    emulator->emulator->setButtons(buttons);
+}
+
+int gbc_run_frame(gbc_emulator *emulator) {
+    return guarded(emulator, [&] { emulator->emulator->runFrame(); });
+}
+
+const uint8_t *gbc_framebuffer(const gbc_emulator *emulator, unsigned *width,
+                               unsigned *height) {
+    if (width) *width = LCD::SCREEN_WIDTH;
+    if (height) *height = LCD::SCREEN_HEIGHT;
+    return emulator->emulator->getFramebuffer().data();
+}
+
+const int16_t *gbc_audio(const gbc_emulator *, size_t *samples) {
+    if (samples) *samples = 0;
+    return nullptr;
+}
+
+size_t gbc_state_size(const gbc_emulator *emulator) {
+    return emulator->emulator->stateSize();
+}
+
+size_t gbc_save_state(const gbc_emulator *emulator, uint8_t *buffer,
+                      size_t size) {
+    size_t written = 0;
+    guarded(emulator, [&] {
+        written = emulator->emulator->saveState(buffer, size);
+    });
+    return written;
+}
+
+int gbc_load_state(gbc_emulator *emulator, const uint8_t *data,
+                   size_t size) {
+    return guarded(emulator,
+                   [&] { emulator->emulator->loadState(data, size); });
+}
+
+void gbc_set_fingerprinting(gbc_emulator *emulator, int enabled) {
+    emulator->emulator->setFingerprinting(enabled != 0);
+}
+
+uint64_t gbc_fingerprint(const gbc_emulator *emulator) {
+    return emulator->emulator->fingerprint();
+}
+
+uint64_t gbc_frame_count(const gbc_emulator *emulator) {
+    return emulator->emulator->processor->ppu->getFrameCount();
+}
+
+uint8_t gbc_peek(const gbc_emulator *emulator, uint16_t address) {
+    return emulator->emulator->processor->program_memory->peek(address);
+}
+
+gbc_env *gbc_env_create(gbc_emulator *emulator, int format,
+                        unsigned frames_per_step) {
+    gbc_env *env = nullptr;
+    int result = guarded(emulator, [&] {
+        if (format < GBC_OBS_RGBA || format > GBC_OBS_SHADES) {
+            throw std::runtime_error("Unknown observation format " +
+                                     std::to_string(format));
+        }
+
+        env = new gbc_env {};
+        env->emulator = emulator;
+        env->environment = std::make_shared<Environment>(
+            emulator->emulator, static_cast<ObservationFormat>(format),
+            frames_per_step);
+    });
+    if (result == 0) return env;
+
+    delete env;
+    return nullptr;
+}
+
+void gbc_env_destroy(gbc_env *env) { delete env; }
+
+void gbc_env_set_reward(gbc_env *env, gbc_reward_fn reward, void *user) {
+    if (!reward) {
+        env->environment->setReward(nullptr);
+        return;
+    }
+    const gbc_emulator *emulator = env->emulator;
+    env->environment->setReward(
+        [=](const Emulator &) { return reward(emulator, user); });
+}
+
+void gbc_env_set_done(gbc_env *env, gbc_done_fn done, void *user) {
+    if (!done) {
+        env->environment->setDone(nullptr);
+        return;
+    }
+    const gbc_emulator *emulator = env->emulator;
+    env->environment->setDone(
+        [=](const Emulator &) { return done(emulator, user) != 0; });
+}
+
+int gbc_env_set_start_state(gbc_env *env) {
+    return guarded(env->emulator, [&] { env->environment->setStartState(); });
+}
+
+const uint8_t *gbc_env_reset(gbc_env *env) {
+    if (guarded(env->emulator, [&] { env->environment->reset(); }) != 0) {
+        return nullptr;
+    }
+    return env->environment->observation();
+}
+
+const uint8_t *gbc_env_step(gbc_env *env, uint8_t action, double *reward,
+                            int *done) {
+    Environment::Step step {};
+    if (guarded(env->emulator,
+                [&] { step = env->environment->step(action); }) != 0) {
+        return nullptr;
+    }
+
+    if (reward) *reward = step.reward;
+    if (done) *done = step.done;
+    return env->environment->observation();
+}
+
+const uint8_t *gbc_env_observation(const gbc_env *env, size_t *size,
+                                   unsigned *width, unsigned *height,
+                                   unsigned *channels) {
+    const Environment &environment = *env->environment;
+    if (size) *size = environment.observationSize();
+    if (width) *width = environment.width();
+    if (height) *height = environment.height();
+    if (channels) *channels = environment.channels();
+    return environment.observation();
+}
@@ -0,0 +1,199 @@
+/*
+ *  C interface to the emulator core, for driving it in-process from other
+ *  programs and languages (training harnesses, test tooling, bindings).
+ *
+ *  Exported from libgbc. Every function taking a gbc_emulator is safe to
+ *  call on different instances from different threads, but not on the same
+ *  instance concurrently. gbc_clone() counts as a call on the instance
+ *  cloned, see there. Functions that can fail return -1 (or 0 where a size
+ *  is returned) and leave a description in gbc_last_error(); nothing ever
+ *  throws across the interface.
+ */
+#ifndef GBC_H
+#define GBC_H
+
+/* System headers */
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GNUC__)
+#define GBC_API __attribute__((visibility("default")))
+#else
+#define GBC_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bumped whenever a function changes in an incompatible way */
+#define GBC_API_VERSION 1
+
+/* Buttons bits for gbc_set_input(), the same as Buttons in Joypad.hh */
+#define GBC_BUTTON_RIGHT 0x01
+#define GBC_BUTTON_LEFT 0x02
+#define GBC_BUTTON_UP 0x04
+#define GBC_BUTTON_DOWN 0x08
+#define GBC_BUTTON_A 0x10
+#define GBC_BUTTON_B 0x20
+#define GBC_BUTTON_SELECT 0x40
+#define GBC_BUTTON_START 0x80
+
+#define GBC_SCREEN_WIDTH 160
+#define GBC_SCREEN_HEIGHT 144
+
+typedef struct gbc_emulator gbc_emulator;
+
+/*
+ *  GBC_API_VERSION of the library, to check against the header.
+ */
+GBC_API int gbc_api_version(void);
+
+/*
+ *  A new machine without a ROM, or NULL if it can't be created.
+ */
+GBC_API gbc_emulator *gbc_create(void);
+
+/*
+ *  A new machine in the same state as emulator, sharing memory pages until
+ *  either writes to them (see Emulator::clone()). NULL on failure. Sharing
+ *  changes how emulator writes its memory, so this is a call on emulator
+ *  like any other: no other call on it, gbc_clone() included, may run at
+ *  the same time. Once it returns, both machines are independent.
+ */
+GBC_API gbc_emulator *gbc_clone(gbc_emulator *emulator);
+
+GBC_API void gbc_destroy(gbc_emulator *emulator);
+
+/*
+ *  Description of the last failure on emulator, or an empty string. Valid
+ *  until the next call on emulator.
+ */
+GBC_API const char *gbc_last_error(const gbc_emulator *emulator);
+
+/*
+ *  Loads a ROM from a file, or from size bytes at data, which are copied.
+ *  A machine takes one ROM, at power-on: loading another fails with -1, so
+ *  use a new gbc_create() for every ROM.
+ */
+GBC_API int gbc_load_rom(gbc_emulator *emulator, const char *path);
+GBC_API int gbc_load_rom_mem(gbc_emulator *emulator, const uint8_t *data,
+                             size_t size);
+
+/*
+ *  Buttons (GBC_BUTTON_* bits) held from the next frame on.
+ */
+GBC_API void gbc_set_input(gbc_emulator *emulator, uint8_t buttons);
+
+/*
+ *  Runs until the next frame is finished.
+ */
+GBC_API int gbc_run_frame(gbc_emulator *emulator);
+
+/*
+ *  The framebuffer of the machine itself, one byte per pixel holding the
+ *  shade 0 (lightest) to 3, row by row. Stays valid as long as emulator and
+ *  is updated in place by every frame run. width and height may be NULL.
+ */
+GBC_API const uint8_t *gbc_framebuffer(const gbc_emulator *emulator,
+                                       unsigned *width, unsigned *height);
+
+/*
+ *  Audio samples produced by the last frame, in place like the framebuffer.
+ *  There is no APU yet, so this is always NULL with no samples.
+ */
+GBC_API const int16_t *gbc_audio(const gbc_emulator *emulator,
+                                 size_t *samples);
+
+/*
+ *  Save states, see SaveState. gbc_save_state() returns the bytes written,
+ *  or 0 if size is less than gbc_state_size(). A failed load leaves the
+ *  machine as it was.
+ */
+GBC_API size_t gbc_state_size(const gbc_emulator *emulator);
+GBC_API size_t gbc_save_state(const gbc_emulator *emulator,
+                              uint8_t *buffer, size_t size);
+GBC_API int gbc_load_state(gbc_emulator *emulator, const uint8_t *data,
+                           size_t size);
+
+/*
+ *  Hash of the machine state, see Emulator::fingerprint(). Enabling
+ *  fingerprinting makes it O(1).
+ */
+GBC_API void gbc_set_fingerprinting(gbc_emulator *emulator, int enabled);
+GBC_API uint64_t gbc_fingerprint(const gbc_emulator *emulator);
+
+/*
+ *  Frames finished by the PPU since power on.
+ */
+GBC_API uint64_t gbc_frame_count(const gbc_emulator *emulator);
+
+/*
+ *  Reads memory without side effects, for rewards and game state.
+ */
+GBC_API uint8_t gbc_peek(const gbc_emulator *emulator, uint16_t address);
+
+/*
+ *  Reinforcement learning environments, see Environment. An environment
+ *  steps an emulator, which must outlive it, and reports failures in
+ *  gbc_last_error() of that emulator.
+ */
+typedef struct gbc_env gbc_env;
+
+/* Observation formats */
+#define GBC_OBS_RGBA 0        /* 160x144, 4 bytes per pixel */
+#define GBC_OBS_GRAYSCALE 1   /* 160x144, 1 byte per pixel */
+#define GBC_OBS_DOWNSAMPLED 2 /* 84x84 grayscale, area averaged */
+#define GBC_OBS_SHADES 3      /* 160x144 shades 0-3, the framebuffer */
+
+/*
+ *  Hooks called once the frames of every step have run, with the user
+ *  pointer they were set with.
+ */
+typedef double (*gbc_reward_fn)(const gbc_emulator *emulator, void *user);
+typedef int (*gbc_done_fn)(const gbc_emulator *emulator, void *user);
+
+/*
+ *  Steps emulator frames_per_step frames at a time, starting episodes from
+ *  its current state. NULL on failure.
+ */
+GBC_API gbc_env *gbc_env_create(gbc_emulator *emulator, int format,
+                                unsigned frames_per_step);
+GBC_API void gbc_env_destroy(gbc_env *env);
+
+GBC_API void gbc_env_set_reward(gbc_env *env, gbc_reward_fn reward,
+                                void *user);
+GBC_API void gbc_env_set_done(gbc_env *env, gbc_done_fn done, void *user);
+
+/*
+ *  Starts episodes from the current state of the emulator from now on.
+ */
+GBC_API int gbc_env_set_start_state(gbc_env *env);
+
+/*
+ *  Goes back to the start state. Returns the observation of it, or NULL on
+ *  failure.
+ */
+GBC_API const uint8_t *gbc_env_reset(gbc_env *env);
+
+/*
+ *  Holds action (GBC_BUTTON_* bits) for the frames of a step. Returns the
+ *  observation of the last frame, or NULL on failure. reward and done may
+ *  be NULL.
+ */
+GBC_API const uint8_t *gbc_env_step(gbc_env *env, uint8_t action,
+                                    double *reward, int *done);
+
+/*
+ *  The last observation, valid until the next step or reset, and its shape.
+ *  Any of the out parameters may be NULL.
+ */
+GBC_API const uint8_t *gbc_env_observation(const gbc_env *env, size_t *size,
+                                           unsigned *width, unsigned *height,
+                                           unsigned *channels);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,5 +1,6 @@
 // System headers
 #include <assert.h>
+#include <chrono>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
@@ -11,6 +12,9 @@
 
 // User headers
 #include "Constants.hh"
+#include "DeterminismChecker.hh"
+#include "Emulator.hh"
+#include "EmulatorThread.hh"
 #include "InstructionDecoder.hh"
 #include "Metadata.hh"
 #include "Processor.hh"
@@ -25,8 +29,55 @@
 ArgumentParser parseArgs(int argc, char** argv) {
     ArgumentParser parser("CLI argument parser");
     parser.add_argument("--rom", "The filename of the ROM", true);
+    parser.add_argument("--ppu", "PPU accuracy, fast (default) or fifo");
+    parser.add_argument("--frameskip",
+                        "Render one of every N + 1 frames, or auto");
+    parser.add_argument("--trace",
+                        "Record every instruction to a binary trace file");
+    parser.add_argument("--profile-opcodes",
+                        "Count executions and cycles per opcode, written "
+                        "as CSV to the given file at exit");
+    parser.add_argument("--sample-profile",
+                        "Sample PC every N cycles and print the functions "
+                        "taking the most cycles at exit");
+    parser.add_argument("--call-profile",
+                        "Attribute cycles to guest functions through a shadow "
+                        "call stack, written as collapsed stacks to the "
+                        "given file at exit");
+    parser.add_argument("--symbols", "RGBDS .sym file naming the functions");
+    parser.add_argument("--run-ahead",
+                        "Show frames N frames ahead to hide input latency");
+    parser.add_argument("--run-ahead-thread",
+                        "Run the run-ahead frames on a second emulator "
+                        "instance on its own thread");
+    parser.add_argument("--record",
+                        "Record the input of every frame from power-on, "
+                        "written as a movie to the given file at exit");
+    parser.add_argument("--play",
+                        "Play a movie back without a window, as fast as "
+                        "possible, and print the speed and frame hash");
+    parser.add_argument("--verify-determinism",
+                        "With --play, also play the movie on a reference "
+                        "instance and report the first frame where the two "
+                        "differ");
+
+    // Allow --option=value as well as --option value
+    std::vector<std::string> args {};
+    for (int i = 0; i < argc; ++i) {
+        std::string arg { argv[i] };
+        size_t equals = arg.find('=');
+        if (arg.rfind("--", 0) == 0 && equals != std::string::npos) {
+            args.push_back(arg.substr(0, equals));
+            args.push_back(arg.substr(equals + 1));
+        } else {
+            args.push_back(arg);
+        }
+    }
+    std::vector<char*> split_argv {};
+    for (std::string& arg : args) split_argv.push_back(arg.data());
+
     try {
-        parser.parse(argc, argv);
+        parser.parse((int)split_argv.size(), split_argv.data());
     } catch (const ArgumentParser::ArgumentNotFound& ex) {
         std::cerr << ex.what() << std::endl;
         exit(EXIT_FAILURE);
@@ -37,26 +88,190 @@ ArgumentParser parseArgs(int argc, char** argv) {
     return parser;
 }
 
+/**
+ *  Plays a movie back headless and unthrottled. Returns false if it can't be
+ *  played to the end.
+ */
+bool playMovie(Emulator& emulator, const std::string& filename) {
+    try {
+        Movie movie {};
+        movie.load(filename);
+        emulator.startPlayback(movie);
+
+        auto start = std::chrono::steady_clock::now();
+        while (emulator.movieMode() == MovieMode::Playing) {
+            emulator.runFrame();
+        }
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+        size_t frames = emulator.movieFrame();
+        std::cout << "Played " << frames << " frames in " << std::fixed
+                  << std::setprecision(3) << elapsed.count() << " s ("
+                  << std::setprecision(1) << frames / elapsed.count()
+                  << " fps)" << std::endl;
+        std::cout << "Frame hash: " << std::hex << std::setfill('0')
+                  << std::setw(16) << emulator.frameHash() << std::dec
+                  << std::endl;
+    } catch (const std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ *  Plays a movie on emulator, as set up by the options, and on a reference
+ *  instance that renders every frame through the instrumented run loop, in
+ *  lockstep. Returns false if they diverge.
+ */
+bool verifyDeterminism(Emulator& emulator, const std::string& rom,
+                       const std::string& filename) {
+    try {
+        Movie movie {};
+        movie.load(filename);
+
+        Emulator reference {};
+        reference.loadROM(rom);
+        reference.setProfiling(true);
+
+        DeterminismChecker checker { emulator, reference };
+        DeterminismChecker::Result result = checker.run(movie);
+
+        if (result.diverged) {
+            std::cout << "Diverged after frame " << result.frame << ": "
+                      << result.component << std::endl;
+            return false;
+        }
+        std::cout << "Deterministic for " << result.frames << " frames"
+                  << std::endl;
+    } catch (const std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
 int main(int argc, char** argv) {
     ArgumentParser parser = parseArgs(argc, argv);
 
-    ptr<Processor> processor { std::make_shared<Processor>() };
-    ptr<InstructionDecoder> instructionDecoder {
-        std::make_shared<InstructionDecoder>(processor)
-    };
+    Emulator emulator {};
+
+    std::string ppu { parser.get<std::string>("ppu") };
+    if (ppu == "fifo") {
+        emulator.setPPUAccuracy(PPUAccuracy::Fifo);
+    } else if (!ppu.empty() && ppu != "fast") {
+        std::cerr << "Unknown PPU accuracy: " << ppu << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    std::string frameskip { parser.get<std::string>("frameskip") };
+    if (frameskip == "auto") {
+        emulator.setAutoFrameSkip(true);
+    } else if (!frameskip.empty()) {
+        emulator.setFrameSkip(parser.get<unsigned>("frameskip"));
+    }
 
     std::string filename { parser.get<std::string>("rom") };
-    processor->readInstructions(filename, true);
+    emulator.loadROM(filename, true);
 
-    Util::ROM_Metadata metadata { processor->rom_data };
+    Util::ROM_Metadata metadata { emulator.processor->rom_data };
     metadata.dump();
 
-    Window window { *processor, *instructionDecoder };
+    // Rewinding isn't needed without a window, and would slow playback down
+    std::string play { parser.get<std::string>("play") };
+    emulator.setRewindEnabled(play.empty());
+
+    if (parser.exists("run-ahead")) {
+        emulator.run_ahead->setFrames(parser.get<unsigned>("run-ahead"));
+        emulator.run_ahead->setSecondInstance(
+            parser.get<bool>("run-ahead-thread"));
+    }
+
+    std::string trace { parser.get<std::string>("trace") };
+    if (!trace.empty() && !emulator.trace_recorder->start(trace)) {
+        std::cerr << "Could not create trace file " << trace << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    std::string profile { parser.get<std::string>("profile-opcodes") };
+    if (!profile.empty()) emulator.setProfiling(true);
+
+    std::string sample_profile { parser.get<std::string>("sample-profile") };
+    if (!sample_profile.empty()) {
+        emulator.sampling_profiler->start(
+            parser.get<uint64_t>("sample-profile"));
+    }
+
+    std::string call_profile { parser.get<std::string>("call-profile") };
+    if (!call_profile.empty()) emulator.setCallProfiling(true);
+
+    std::string symbols { parser.get<std::string>("symbols") };
+    if (!symbols.empty() && !emulator.symbols->load(symbols)) {
+        std::cerr << "Could not read symbol file " << symbols << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    std::string record { parser.get<std::string>("record") };
+
+    if (!play.empty()) {
+        bool ok = parser.get<bool>("verify-determinism")
+                      ? verifyDeterminism(emulator, filename, play)
+                      : playMovie(emulator, play);
+        if (!ok) exit(EXIT_FAILURE);
+    } else {
+        if (!record.empty()) emulator.startRecording();
+
+        // Emulation runs on its own thread, starting paused
+        EmulatorThread emulator_thread { emulator };
+        emulator_thread.start();
+
+        Window window { emulator, emulator_thread };
+
+        window.createMainWindow(1280, 720, "Gameboy Color emulator");
+
+        while (window.shouldRemainOpen()) {
+            window.update();
+        }
+
+        emulator_thread.stop();
+    }
+
+    if (!record.empty() && play.empty()) {
+        emulator.stopMovie();
+        try {
+            emulator.movie->save(record);
+        } catch (const std::exception& ex) {
+            std::cerr << ex.what() << std::endl;
+        }
+    }
+
+    if (!profile.empty()) {
+        std::ofstream csv { profile };
+        emulator.opcode_profiler->writeCSV(csv);
+    }
+
+    if (!call_profile.empty()) {
+        emulator.setCallProfiling(false);
+        std::ofstream collapsed { call_profile };
+        emulator.call_profiler->writeCollapsed(collapsed, *emulator.symbols);
+    }
 
-    window.createMainWindow(1280, 720, "Gameboy Color emulator");
+    if (!sample_profile.empty()) {
+        SamplingProfiler& profiler = *emulator.sampling_profiler;
+        uint64_t total = profiler.totalSamples() * profiler.getInterval();
 
-    while (window.shouldRemainOpen()) {
-        window.update();
+        std::cout << "Hot spots (" << profiler.totalSamples() << " samples)"
+                  << std::endl;
+        for (const SamplingProfiler::HotSpot& spot :
+             profiler.topFunctions(20)) {
+            std::cout << std::setw(10) << spot.cycles << std::setw(8)
+                      << std::fixed << std::setprecision(2)
+                      << 100.0 * spot.cycles / total << "%  " << spot.name
+                      << std::endl;
+        }
     }
 
     // while (inputHandler.getInput()) {
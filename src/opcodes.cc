@@ -683,8 +683,7 @@ void InstructionDecoder::OPCode0x75() {
 
 void InstructionDecoder::OPCode0x76() {
     // HALT
-    // TODO stop??
-    throw std::runtime_error("0x76");
+    cpu->halted = true;
 }
 
 void InstructionDecoder::OPCode0x77() {
@@ -1107,6 +1106,7 @@ void InstructionDecoder::OPCode0xC0() {
     // TODO double check logic when branch isn't taken
     if (!cpu->getFlagZ()) {
         popStack(PC);
+        returnedFromFunction();
     }
 }
 
@@ -1141,6 +1141,7 @@ void InstructionDecoder::OPCode0xC4() {
 
         PC->getLowRegister()->setValue(data_low);
         PC->getHighRegister()->setValue(data_high);
+        calledFunction();
     } else {
         PC->increment();
         PC->increment();
@@ -1167,18 +1168,21 @@ void InstructionDecoder::OPCode0xC7() {
     // RST 00H
     pushStack(PC);
     PC->setValue(0x0000);
+    calledFunction();
 }
 
 void InstructionDecoder::OPCode0xC8() {
     // RET Z
     if (cpu->getFlagZ()) {
         popStack(PC);
+        returnedFromFunction();
     }
 }
 
 void InstructionDecoder::OPCode0xC9() {
     // RET
     popStack(PC);
+    returnedFromFunction();
 }
 
 void InstructionDecoder::OPCode0xCA() {
@@ -1206,6 +1210,7 @@ void InstructionDecoder::OPCode0xCC() {
 
         PC->getLowRegister()->setValue(data_low);
         PC->getHighRegister()->setValue(data_high);
+        calledFunction();
     } else {
         PC->increment();
         PC->increment();
@@ -1221,6 +1226,7 @@ void InstructionDecoder::OPCode0xCD() {
 
     PC->getLowRegister()->setValue(data_low);
     PC->getHighRegister()->setValue(data_high);
+    calledFunction();
 }
 
 void InstructionDecoder::OPCode0xCE() {
@@ -1235,12 +1241,14 @@ void InstructionDecoder::OPCode0xCF() {
     // RST 08H
     pushStack(PC);
     PC->setValue(0x0008);
+    calledFunction();
 }
 
 void InstructionDecoder::OPCode0xD0() {
     // RET NC
     if (!cpu->getFlagC()) {
         popStack(PC);
+        returnedFromFunction();
     }
 }
 
@@ -1274,6 +1282,7 @@ void InstructionDecoder::OPCode0xD4() {
 
         PC->getLowRegister()->setValue(data_low);
         PC->getHighRegister()->setValue(data_high);
+        calledFunction();
     } else {
         PC->increment();
         PC->increment();
@@ -1297,19 +1306,22 @@ void InstructionDecoder::OPCode0xD7() {
     // RST 10H
     pushStack(PC);
     PC->setValue(0x0010);
+    calledFunction();
 }
 
 void InstructionDecoder::OPCode0xD8() {
     // RET C
     if (cpu->getFlagC()) {
         popStack(PC);
+        returnedFromFunction();
     }
 }
 
 void InstructionDecoder::OPCode0xD9() {
     // RETI
-    // TODO fix interupts
-    throw std::runtime_error("0xD9");
+    popStack(PC);
+    returnedFromFunction();
+    cpu->interrupts_enabled = true;
 }
 
 void InstructionDecoder::OPCode0xDA() {
@@ -1337,6 +1349,7 @@ void InstructionDecoder::OPCode0xDC() {
 
         PC->getLowRegister()->setValue(data_low);
         PC->getHighRegister()->setValue(data_high);
+        calledFunction();
     } else {
         PC->increment();
         PC->increment();
@@ -1360,6 +1373,7 @@ void InstructionDecoder::OPCode0xDF() {
     // RST 18H
     pushStack(PC);
     PC->setValue(0x0018);
+    calledFunction();
 }
 
 void InstructionDecoder::OPCode0xE0() {
@@ -1403,6 +1417,7 @@ void InstructionDecoder::OPCode0xE7() {
     // RST 20H
     pushStack(PC);
     PC->setValue(0x0020);
+    calledFunction();
 }
 
 void InstructionDecoder::OPCode0xE8() {
@@ -1453,6 +1468,7 @@ void InstructionDecoder::OPCode0xEF() {
     // RST 28H
     pushStack(PC);
     PC->setValue(0x0028);
+    calledFunction();
 }
 
 void InstructionDecoder::OPCode0xF0() {
@@ -1476,8 +1492,8 @@ void InstructionDecoder::OPCode0xF2() {
 
 void InstructionDecoder::OPCode0xF3() {
     // DI
-    // TODO disable interupts according to manual
-    throw std::runtime_error("0xF3");
+    cpu->interrupts_enabled = false;
+    cpu->interrupt_enable_pending = false;
 }
 
 void InstructionDecoder::OPCode0xF4() {
@@ -1499,6 +1515,7 @@ void InstructionDecoder::OPCode0xF7() {
     // RST 30H
     pushStack(PC);
     PC->setValue(0x0030);
+    calledFunction();
 }
 
 void InstructionDecoder::OPCode0xF8() {
@@ -1531,8 +1548,8 @@ void InstructionDecoder::OPCode0xFA() {
 
 void InstructionDecoder::OPCode0xFB() {
     // EI
-    // TODO enable interupts according to manual
-    throw std::runtime_error("0xFB");
+    // Takes effect after the next instruction
+    cpu->interrupt_enable_pending = true;
 }
 
 void InstructionDecoder::OPCode0xFC() {
@@ -1557,4 +1574,5 @@ void InstructionDecoder::OPCode0xFF() {
     // RST 38H
     pushStack(PC);
     PC->setValue(0x0038);
+    calledFunction();
 }
@@ -0,0 +1,138 @@
+#include <cstring>
+#include <iostream>
+#include <random>
+#include "Emulator.hh"
+#include "TestBatchEmulator.hh"
+#include "TestInterrupts.hh"
+
+namespace {
+
+/**
+ *  Gives every lane its own registers, to run the kernels on many values
+ *  at once. Where HL is jumped to, it is kept at PC_START.
+ */
+void randomizeRegisters(BatchEmulator &batch, std::mt19937 &random,
+                        bool keep_hl) {
+    for (const ptr<Emulator> &lane : batch.lanes) {
+        CPUState state = lane->processor->getCPUState();
+        state.A = random();
+        state.B = random();
+        state.C = random();
+        state.D = random();
+        state.E = random();
+        state.F = random() & 0xF0;
+        state.H = keep_hl ? PC_START >> 8 : random();
+        state.L = keep_hl ? PC_START & 0xFF : random();
+        state.SP = random();
+        lane->processor->setCPUState(state);
+    }
+}
+
+/**
+ *  Runs frames on the batch and on a clone of every lane stepped by the
+ *  decoder alone, and checks that they end up in the same state. Returns
+ *  the number of lane instructions run in lockstep, or -1 on a mismatch.
+ *  Nothing is rendered, the states are what's compared.
+ */
+int64_t compareWithDecoder(BatchEmulator &batch, unsigned frames) {
+    std::vector<ptr<Emulator>> references {};
+    for (const ptr<Emulator> &lane : batch.lanes) {
+        references.push_back(lane->clone());
+    }
+    batch.setOutputWanted(false);
+
+    std::array<byte_t, BatchEmulator::MAX_LANES> buttons {};
+    for (unsigned frame = 0; frame < frames; ++frame) {
+        batch.runFrame(buttons.data());
+        for (unsigned i = 0; i < batch.size(); ++i) {
+            references[i]->skipNextFrames(1);
+            references[i]->runFrame();
+
+            CPUState expected = references[i]->processor->getCPUState();
+            CPUState actual = batch.lanes[i]->processor->getCPUState();
+            if (std::memcmp(&expected, &actual, sizeof(CPUState)) != 0 ||
+                references[i]->fingerprint() != batch.lanes[i]->fingerprint()) {
+                std::cout << "Lane " << i << " differs after frame " << frame
+                          << std::endl;
+                return -1;
+            }
+        }
+    }
+
+    return batch.getStats().lockstep_lanes;
+}
+
+}  // namespace
+
+bool TestBatchEmulator::testEveryKernelMatchesDecoder() {
+    std::mt19937 random { 1 };
+    unsigned kernels = 0;
+
+    for (unsigned opcode = 0; opcode < NUMBER_OF_INSTRUCTIONS; ++opcode) {
+        unsigned length = BatchEmulator::lockstepLength(opcode);
+        if (length == 0) continue;
+        ++kernels;
+
+        // The instruction with random operands, then JP PC_START. Jumps go
+        // back to the start instead, JR through the decoder's offset quirk.
+        std::vector<byte_t> program { (byte_t)opcode };
+        for (unsigned i = 1; i < length; ++i) program.push_back(random());
+        if (opcode == 0x18 || opcode == 0x20) program[1] = 0xFF;
+        if (length == 3 && (opcode & 0xC0) == 0xC0) {
+            program[1] = PC_START & 0xFF;
+            program[2] = PC_START >> 8;
+        }
+        program.insert(program.end(),
+                       { 0xC3, PC_START & 0xFF, PC_START >> 8 });
+
+        // A few lanes are enough for one kernel
+        auto prototype = TestInterrupts::emulatorWith(program);
+        BatchEmulator batch { *prototype, 4 };
+        randomizeRegisters(batch, random, opcode == 0xE9);
+
+        int64_t lockstep = compareWithDecoder(batch, 1);
+        if (lockstep <= 0) {
+            std::cout << "Opcode 0x" << std::hex << opcode << std::dec
+                      << " doesn't match the decoder" << std::endl;
+            return false;
+        }
+    }
+
+    return kernels > 0;
+}
+
+bool TestBatchEmulator::testMixedProgramMatchesDecoder() {
+    std::mt19937 random { 2 };
+
+    // Straight runs of instructions that take the kernels through each
+    // other's results, with conditional jumps splitting the lanes up
+    std::vector<byte_t> program {};
+    while (program.size() < 0x200) {
+        opcode_t opcode = random();
+        unsigned length = BatchEmulator::lockstepLength(opcode);
+        bool jump = opcode == 0x18 || opcode == 0xE9 ||
+                    (length == 3 && (opcode & 0xC0) == 0xC0);
+        if (length == 0 || jump) continue;
+
+        program.push_back(opcode);
+        for (unsigned i = 1; i < length; ++i) program.push_back(random());
+
+        // Conditional JR skips nothing, to keep the lanes on the program
+        if (opcode == 0x20) program.back() = 0x01;
+    }
+    program.insert(program.end(), { 0xC3, PC_START & 0xFF, PC_START >> 8 });
+
+    auto prototype = TestInterrupts::emulatorWith(program);
+    BatchEmulator batch { *prototype, BatchEmulator::MAX_LANES };
+    randomizeRegisters(batch, random, false);
+
+    return compareWithDecoder(batch, 2) > 0;
+}
+
+void TestBatchEmulator::runAllTests() {
+    TestUtils::runTestNoArg(testEveryKernelMatchesDecoder,
+                            "TestBatchEmulator::testEveryKernelMatchesDecoder");
+    TestUtils::runTestNoArg(
+        testMixedProgramMatchesDecoder,
+        "TestBatchEmulator::testMixedProgramMatchesDecoder");
+}
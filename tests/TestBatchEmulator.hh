@@ -0,0 +1,9 @@
+#pragma once
+#include "BatchEmulator.hh"
+#include "TestUtils.hh"
+
+namespace TestBatchEmulator {
+void runAllTests();
+bool testEveryKernelMatchesDecoder();
+bool testMixedProgramMatchesDecoder();
+}  // namespace TestBatchEmulator
@@ -0,0 +1,102 @@
+#include <stdexcept>
+#include "Emulator.hh"
+#include "TestBreakCondition.hh"
+#include "TestInterrupts.hh"
+
+namespace {
+
+bool compiles(const std::string &expression) {
+    try {
+        BreakCondition condition { expression };
+        return true;
+    } catch (const std::runtime_error &) {
+        return false;
+    }
+}
+
+bool holds(const std::string &expression, const Processor &processor) {
+    return BreakCondition { expression }.evaluate(processor);
+}
+
+}  // namespace
+
+bool TestBreakCondition::testEvaluate() {
+    // NOP
+    auto emulator = TestInterrupts::emulatorWith({ 0x00 });
+    Processor &cpu = *emulator->processor;
+    cpu.A->setValue(0x3F);
+    cpu.F->setValue(bit_z | bit_c);
+    cpu.H->setValue(0xC0);
+    cpu.L->setValue(0x10);
+    cpu.program_memory->setData(0xC010, 0x42);
+
+    return holds("A==0x3F", cpu) && holds("a == $3f", cpu) &&
+           holds("A==63", cpu) && !holds("A!=0x3F", cpu) &&
+           holds("HL==0xC010", cpu) && holds("[HL]==0x42", cpu) &&
+           holds("[HL+1-1]>0x41", cpu) && holds("fZ && fC", cpu) &&
+           !holds("fN || fH", cpu) && holds("PC==0x100", cpu) &&
+           holds("!fN && ~A&0xFF==0xC0", cpu) && holds("-A+A==0", cpu);
+}
+
+bool TestBreakCondition::testLargeOperands() {
+    auto emulator = TestInterrupts::emulatorWith({ 0x00 });
+    Processor &cpu = *emulator->processor;
+    cpu.clock_cycles = 100000;
+
+    return holds("cycles>70224", cpu) && !holds("cycles>100000", cpu) &&
+           holds("cycles+0x1000000000000>0x1000000000000", cpu);
+}
+
+bool TestBreakCondition::testPrecedence() {
+    auto emulator = TestInterrupts::emulatorWith({ 0x00 });
+    Processor &cpu = *emulator->processor;
+
+    // Sums bind tighter than bitwise operators, which bind tighter than
+    // comparisons
+    return holds("1+2&3==3", cpu) && holds("1|2==3", cpu) &&
+           holds("(1||0)&&1", cpu) && holds("0&&0||1", cpu) &&
+           holds("!0==1", cpu) && holds("(((1+1)))==2", cpu);
+}
+
+bool TestBreakCondition::testNumberLimits() {
+    return compiles("A==0xFFFF") && compiles("cycles>70224") &&
+           compiles("cycles>100000") && compiles("frame>4294967296") &&
+           compiles("cycles<0x1000000000000") &&
+           compiles("cycles<281474976710656") &&
+           !compiles("cycles<0x1000000000001") &&
+           !compiles("cycles<281474976710657") &&
+           !compiles("A==99999999999999999999999");
+}
+
+bool TestBreakCondition::testNestingLimit() {
+    // Deep enough to overflow the stack if the parser recursed that far
+    constexpr size_t DEEP = 100000;
+
+    std::string nested = std::string(30, '(') + "1" + std::string(30, ')');
+    std::string deep = std::string(DEEP, '(') + "1" + std::string(DEEP, ')');
+    std::string unary = std::string(DEEP, '!') + "1";
+    std::string loads = std::string(DEEP, '[') + "1" + std::string(DEEP, ']');
+
+    return compiles(nested) && !compiles(deep) && !compiles(unary) &&
+           !compiles(loads);
+}
+
+bool TestBreakCondition::testSyntaxErrors() {
+    return !compiles("") && !compiles("A==") && !compiles("(A==1") &&
+           !compiles("[HL") && !compiles("A==1)") && !compiles("Q==1") &&
+           !compiles("A==0x") && !compiles("A 1");
+}
+
+void TestBreakCondition::runAllTests() {
+    TestUtils::runTestNoArg(testEvaluate, "TestBreakCondition::testEvaluate");
+    TestUtils::runTestNoArg(testLargeOperands,
+                            "TestBreakCondition::testLargeOperands");
+    TestUtils::runTestNoArg(testPrecedence,
+                            "TestBreakCondition::testPrecedence");
+    TestUtils::runTestNoArg(testNumberLimits,
+                            "TestBreakCondition::testNumberLimits");
+    TestUtils::runTestNoArg(testNestingLimit,
+                            "TestBreakCondition::testNestingLimit");
+    TestUtils::runTestNoArg(testSyntaxErrors,
+                            "TestBreakCondition::testSyntaxErrors");
+}
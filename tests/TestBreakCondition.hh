@@ -0,0 +1,13 @@
+#pragma once
+#include "BreakCondition.hh"
+#include "TestUtils.hh"
+
+namespace TestBreakCondition {
+void runAllTests();
+bool testEvaluate();
+bool testLargeOperands();
+bool testPrecedence();
+bool testNumberLimits();
+bool testNestingLimit();
+bool testSyntaxErrors();
+}  // namespace TestBreakCondition
@@ -0,0 +1,87 @@
+#include <string>
+#include <vector>
+#include "Constants.hh"
+#include "TestCApi.hh"
+
+namespace {
+
+/**
+ *  A ROM looping over a write of A to 0xC000 and an increment of A, so
+ *  every frame changes memory.
+ */
+std::vector<uint8_t> counterROM() {
+    // LD (0xC000),A; INC A; JP 0x100
+    std::vector<uint8_t> rom(PC_START, 0x00);
+    rom.insert(rom.end(), { 0xEA, 0x00, 0xC0, 0x3C, 0xC3, 0x00, 0x01 });
+    return rom;
+}
+
+}  // namespace
+
+bool TestCApi::testRunAndSaveState() {
+    std::vector<uint8_t> rom = counterROM();
+    gbc_emulator *emulator = gbc_create();
+    bool ok = gbc_load_rom_mem(emulator, rom.data(), rom.size()) == 0 &&
+              gbc_run_frame(emulator) == 0 &&
+              gbc_frame_count(emulator) == 1;
+
+    std::vector<uint8_t> state(gbc_state_size(emulator));
+    ok = ok && gbc_save_state(emulator, state.data(), state.size()) > 0;
+    uint64_t saved = gbc_fingerprint(emulator);
+    uint8_t counter = gbc_peek(emulator, 0xC000);
+
+    ok = ok && gbc_run_frame(emulator) == 0 &&
+         gbc_peek(emulator, 0xC000) != counter;
+    ok = ok && gbc_load_state(emulator, state.data(), state.size()) == 0 &&
+         gbc_fingerprint(emulator) == saved &&
+         gbc_peek(emulator, 0xC000) == counter;
+
+    gbc_destroy(emulator);
+    return ok;
+}
+
+bool TestCApi::testSecondROMRefused() {
+    std::vector<uint8_t> rom = counterROM();
+    std::vector<uint8_t> other(0x150, 0x76);
+
+    gbc_emulator *emulator = gbc_create();
+    gbc_load_rom_mem(emulator, rom.data(), rom.size());
+    gbc_run_frame(emulator);
+    uint64_t before = gbc_fingerprint(emulator);
+
+    // Refused, leaving the machine running the first ROM
+    bool ok = gbc_load_rom_mem(emulator, other.data(), other.size()) == -1;
+    std::string error = gbc_last_error(emulator);
+    ok = ok && error == "A ROM is already loaded" &&
+         gbc_fingerprint(emulator) == before &&
+         gbc_peek(emulator, PC_START) == 0xEA;
+
+    gbc_destroy(emulator);
+    return ok;
+}
+
+bool TestCApi::testErrors() {
+    gbc_emulator *emulator = gbc_create();
+    bool ok = gbc_load_rom(emulator, "/nonexistent.gb") == -1 &&
+              *gbc_last_error(emulator) != '\0';
+
+    uint8_t junk[16] = {};
+    ok = ok && gbc_load_state(emulator, junk, sizeof(junk)) == -1 &&
+         gbc_env_create(emulator, 7, 4) == nullptr;
+
+    // Errors are cleared by the next call that succeeds
+    std::vector<uint8_t> rom = counterROM();
+    ok = ok && gbc_load_rom_mem(emulator, rom.data(), rom.size()) == 0 &&
+         *gbc_last_error(emulator) == '\0';
+
+    gbc_destroy(emulator);
+    return ok && gbc_api_version() == GBC_API_VERSION;
+}
+
+void TestCApi::runAllTests() {
+    TestUtils::runTestNoArg(testRunAndSaveState,
+                            "TestCApi::testRunAndSaveState");
+    TestUtils::runTestNoArg(testSecondROMRefused,
+                            "TestCApi::testSecondROMRefused");
+    TestUtils::runTestNoArg(testErrors, "TestCApi::testErrors");
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include "TestUtils.hh"
+#include "gbc.h"
+
+namespace TestCApi {
+void runAllTests();
+bool testRunAndSaveState();
+bool testSecondROMRefused();
+bool testErrors();
+}  // namespace TestCApi
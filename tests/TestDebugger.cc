@@ -0,0 +1,116 @@
+#include "TestDebugger.hh"
+#include "TestInterrupts.hh"
+
+namespace {
+
+// LD (0xC000),A; JP 0x100
+const std::vector<byte_t> WRITE_LOOP { 0xEA, 0x00, 0xC0, 0xC3, 0x00, 0x01 };
+
+/**
+ *  Whether a debug run of a few steps stops for a watchpoint. The
+ *  breakpoint is never reached and only keeps the checks on.
+ */
+bool debugRunStopsAtWatchpoint(Emulator &emulator) {
+    emulator.breakpoints.set(0x4000);
+    RunTarget target = emulator.makeRunTarget(RunMode::Instructions, 4);
+    emulator.runTowards(target, 4);
+    emulator.breakpoints.clear(0x4000);
+    return emulator.stopReason() == StopReason::Watchpoint;
+}
+
+}  // namespace
+
+bool TestDebugger::testNoStaleWatchpointAfterRewind() {
+    auto emulator = TestInterrupts::emulatorWith(WRITE_LOOP);
+    emulator->setRewindEnabled(true);
+    for (unsigned i = 0; i < 8; ++i) emulator->runFrame();
+
+    // Rewinding runs a frame without checks, which hits the watchpoint
+    Memory &memory = *emulator->processor->program_memory;
+    memory.addWatchpoint(0xC000, 0xC000, WATCH_WRITE);
+    if (!emulator->rewindFrame()) return false;
+    memory.removeWatchpoint(0);
+
+    return !debugRunStopsAtWatchpoint(*emulator);
+}
+
+bool TestDebugger::testNoStaleWatchpointAfterStep() {
+    auto emulator = TestInterrupts::emulatorWith(WRITE_LOOP);
+    Memory &memory = *emulator->processor->program_memory;
+    memory.addWatchpoint(0xC000, 0xC000, WATCH_WRITE);
+
+    // Stepped outside of a run, like the Step button does
+    emulator->instruction_decoder->step();
+    memory.removeWatchpoint(0);
+
+    return !debugRunStopsAtWatchpoint(*emulator);
+}
+
+bool TestDebugger::testBreakAfterHaltOnWake() {
+    // HALT, NOP
+    auto emulator = TestInterrupts::emulatorWith({ 0x76, 0x00 });
+    Processor &cpu = *emulator->processor;
+    emulator->breakpoints.set(PC_START + 1);
+
+    // Halted at the breakpoint, with nothing to wake up for
+    RunTarget target = emulator->makeRunTarget(RunMode::Instructions, 20);
+    emulator->runTowards(target, 20);
+    if (!cpu.halted || emulator->stopReason() != StopReason::None) {
+        return false;
+    }
+
+    // Waking up stops there once, before the NOP runs
+    cpu.program_memory->setData(IE_ADDRESS, INTERRUPT_TIMER);
+    cpu.program_memory->setData(IF_ADDRESS, INTERRUPT_TIMER);
+    target = emulator->makeRunTarget(RunMode::Instructions, 20);
+    emulator->runTowards(target, 20);
+    return !cpu.halted && emulator->stopReason() == StopReason::Breakpoint &&
+           cpu.PC->getValue() == PC_START + 1;
+}
+
+bool TestDebugger::testResumedFrameKeepsSkip() {
+    auto emulator = TestInterrupts::emulatorWith(WRITE_LOOP);
+    emulator->setFrameSkip(1);
+    Memory &memory = *emulator->processor->program_memory;
+
+    // The first frame is rendered, and stops at the watchpoint
+    memory.addWatchpoint(0xC000, 0xC000, WATCH_WRITE);
+    emulator->runFrame();
+    memory.removeWatchpoint(0);
+    if (emulator->stopReason() != StopReason::Watchpoint) return false;
+
+    // Finishing it doesn't count as another frame for frame skipping
+    emulator->runFrame();
+    bool resumed_rendered = emulator->frameRendered();
+    emulator->runFrame();
+    return resumed_rendered && !emulator->frameRendered() &&
+           emulator->processor->ppu->getFrameCount() == 2;
+}
+
+bool TestDebugger::testToggledOffConditionDropped() {
+    Breakpoints breakpoints {};
+    breakpoints.setConditional(0x150, "A==1");
+    breakpoints.setConditional(0x160, "A==2");
+
+    // Toggled off while running, so only the bit changes
+    breakpoints.toggle(0x150);
+    if (!breakpoints.getCondition(0x150)) return false;
+
+    breakpoints.dropClearedConditions();
+    breakpoints.toggle(0x150);
+    return breakpoints.test(0x150) && !breakpoints.getCondition(0x150) &&
+           breakpoints.getCondition(0x160);
+}
+
+void TestDebugger::runAllTests() {
+    TestUtils::runTestNoArg(testNoStaleWatchpointAfterRewind,
+                            "TestDebugger::testNoStaleWatchpointAfterRewind");
+    TestUtils::runTestNoArg(testNoStaleWatchpointAfterStep,
+                            "TestDebugger::testNoStaleWatchpointAfterStep");
+    TestUtils::runTestNoArg(testBreakAfterHaltOnWake,
+                            "TestDebugger::testBreakAfterHaltOnWake");
+    TestUtils::runTestNoArg(testResumedFrameKeepsSkip,
+                            "TestDebugger::testResumedFrameKeepsSkip");
+    TestUtils::runTestNoArg(testToggledOffConditionDropped,
+                            "TestDebugger::testToggledOffConditionDropped");
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include "Emulator.hh"
+#include "TestUtils.hh"
+
+namespace TestDebugger {
+void runAllTests();
+bool testNoStaleWatchpointAfterRewind();
+bool testNoStaleWatchpointAfterStep();
+bool testBreakAfterHaltOnWake();
+bool testResumedFrameKeepsSkip();
+bool testToggledOffConditionDropped();
+}  // namespace TestDebugger
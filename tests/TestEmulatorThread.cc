@@ -0,0 +1,101 @@
+#include "TestEmulatorThread.hh"
+#include "TestInterrupts.hh"
+
+bool TestEmulatorThread::testParkedAfterQuickResume() {
+    // JP 0x100
+    auto emulator = TestInterrupts::emulatorWith({ 0xC3, 0x00, 0x01 });
+    EmulatorThread thread { *emulator };
+    thread.setThrottled(false);
+    thread.start();
+    thread.pauseAndWait();
+
+    // Resuming and pausing right away races the thread parking; whenever
+    // pauseAndWait() returns, the emulator must stay untouched
+    for (unsigned i = 0; i < 50; ++i) {
+        thread.resume();
+        if (i % 2) std::this_thread::sleep_for(std::chrono::microseconds(i));
+        thread.pauseAndWait();
+
+        uint64_t cycles = emulator->processor->clock_cycles;
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        if (!thread.isParked() ||
+            emulator->processor->clock_cycles != cycles) {
+            thread.stop();
+            return false;
+        }
+    }
+
+    thread.stop();
+    return true;
+}
+
+bool TestEmulatorThread::testNoRunToDuringMovie() {
+    auto emulator = TestInterrupts::emulatorWith({ 0xC3, 0x00, 0x01 });
+    EmulatorThread thread { *emulator };
+    thread.start();
+    thread.pauseAndWait();
+
+    emulator->startRecording();
+    uint64_t cycles = emulator->processor->clock_cycles;
+    bool refused = false;
+    try {
+        thread.runTo(RunMode::ToFrame);
+    } catch (const std::runtime_error &) {
+        refused = true;
+    }
+    bool step_refused = false;
+    try {
+        thread.step();
+    } catch (const std::runtime_error &) {
+        step_refused = true;
+    }
+    bool stayed_parked = thread.isParked() &&
+                         emulator->processor->clock_cycles == cycles;
+
+    // Allowed again once the movie is over
+    emulator->stopMovie();
+    thread.runTo(RunMode::ToFrame);
+    while (!thread.isParked()) std::this_thread::yield();
+    bool ran = emulator->processor->ppu->getFrameCount() == 1;
+
+    thread.stop();
+    return refused && step_refused && stayed_parked && ran;
+}
+
+bool TestEmulatorThread::testUnparkKeepsRunTarget() {
+    constexpr uint64_t STEPS = 2000000;
+
+    // JP 0x100, 16 cycles a step
+    auto emulator = TestInterrupts::emulatorWith({ 0xC3, 0x00, 0x01 });
+    EmulatorThread thread { *emulator };
+    thread.setThrottled(false);
+    thread.start();
+    thread.pauseAndWait();
+
+    // Interrupted halfway, like the state hotkeys do
+    uint64_t start = emulator->processor->clock_cycles;
+    thread.runTo(RunMode::Instructions, STEPS);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    bool interrupted = thread.pauseAndWait();
+    if (interrupted) thread.unpark();
+
+    auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!thread.isParked() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+    bool parked = thread.isParked();
+    thread.stop();
+
+    return parked &&
+           emulator->processor->clock_cycles - start == 16 * STEPS;
+}
+
+void TestEmulatorThread::runAllTests() {
+    TestUtils::runTestNoArg(testParkedAfterQuickResume,
+                            "TestEmulatorThread::testParkedAfterQuickResume");
+    TestUtils::runTestNoArg(testNoRunToDuringMovie,
+                            "TestEmulatorThread::testNoRunToDuringMovie");
+    TestUtils::runTestNoArg(testUnparkKeepsRunTarget,
+                            "TestEmulatorThread::testUnparkKeepsRunTarget");
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include "EmulatorThread.hh"
+#include "TestUtils.hh"
+
+namespace TestEmulatorThread {
+void runAllTests();
+bool testParkedAfterQuickResume();
+bool testNoRunToDuringMovie();
+bool testUnparkKeepsRunTarget();
+}  // namespace TestEmulatorThread
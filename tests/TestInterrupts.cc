@@ -0,0 +1,134 @@
+#include "TestInterrupts.hh"
+
+ptr<Emulator> TestInterrupts::emulatorWith(
+    const std::vector<byte_t> &program) {
+    std::vector<byte_t> rom(PC_START, 0x00);
+    rom.insert(rom.end(), program.begin(), program.end());
+
+    auto emulator = std::make_shared<Emulator>();
+    emulator->loadROM(rom.data(), rom.size());
+    return emulator;
+}
+
+namespace {
+
+void step(Emulator &emulator, unsigned steps = 1) {
+    for (unsigned i = 0; i < steps; ++i) emulator.instruction_decoder->step();
+}
+
+void request(Emulator &emulator, byte_t enabled, byte_t requested) {
+    Memory &memory = *emulator.processor->program_memory;
+    memory.setData(IE_ADDRESS, enabled);
+    memory.setData(IF_ADDRESS, requested);
+}
+
+}  // namespace
+
+bool TestInterrupts::testEIDelayed() {
+    // EI, NOP
+    auto emulator = emulatorWith({ 0xFB, 0x00 });
+    Processor &cpu = *emulator->processor;
+
+    step(*emulator);
+    if (cpu.interrupts_enabled) return false;
+
+    step(*emulator);
+    return cpu.interrupts_enabled && !cpu.interrupt_enable_pending;
+}
+
+bool TestInterrupts::testDICancelsEI() {
+    // EI, DI, NOP, NOP
+    auto emulator = emulatorWith({ 0xFB, 0xF3, 0x00, 0x00 });
+    step(*emulator, 4);
+
+    Processor &cpu = *emulator->processor;
+    return !cpu.interrupts_enabled && !cpu.interrupt_enable_pending;
+}
+
+bool TestInterrupts::testDispatch() {
+    // EI, NOP
+    auto emulator = emulatorWith({ 0xFB, 0x00 });
+    Processor &cpu = *emulator->processor;
+    step(*emulator);
+    request(*emulator, INTERRUPT_TIMER, INTERRUPT_TIMER);
+
+    // The interrupt is taken right after the NOP
+    step(*emulator);
+    CPUState state = cpu.getCPUState();
+    return state.PC == 0x50 && !state.interrupts_enabled &&
+           state.SP == SP_START - 2 && state.serviced_interrupts == 1 &&
+           cpu.stack->peek(SP_START - 1) == 0x01 &&
+           cpu.stack->peek(SP_START - 2) == 0x02 &&
+           (cpu.program_memory->peek(IF_ADDRESS) & INTERRUPT_TIMER) == 0;
+}
+
+bool TestInterrupts::testDispatchPriority() {
+    // EI, NOP
+    auto emulator = emulatorWith({ 0xFB, 0x00 });
+    step(*emulator);
+    request(*emulator, 0x1F, INTERRUPT_SERIAL | INTERRUPT_LCD_STAT);
+    step(*emulator);
+
+    Processor &cpu = *emulator->processor;
+    return cpu.getCPUState().PC == 0x48 &&
+           (cpu.program_memory->peek(IF_ADDRESS) & 0x1F) == INTERRUPT_SERIAL;
+}
+
+bool TestInterrupts::testNoDispatchWithIMEOff() {
+    // NOP, NOP
+    auto emulator = emulatorWith({ 0x00, 0x00 });
+    request(*emulator, INTERRUPT_TIMER, INTERRUPT_TIMER);
+    step(*emulator, 2);
+
+    return emulator->processor->getCPUState().PC == PC_START + 2;
+}
+
+bool TestInterrupts::testHaltWakesWithIMEOff() {
+    // HALT, NOP
+    auto emulator = emulatorWith({ 0x76, 0x00 });
+    Processor &cpu = *emulator->processor;
+    step(*emulator);
+    if (!cpu.halted) return false;
+
+    // Halted steps only let time pass
+    step(*emulator);
+    if (!cpu.halted || cpu.getCPUState().PC != PC_START + 1) return false;
+
+    // A pending interrupt ends HALT without being dispatched
+    request(*emulator, INTERRUPT_TIMER, INTERRUPT_TIMER);
+    step(*emulator);
+    if (cpu.halted) return false;
+
+    step(*emulator);
+    return cpu.getCPUState().PC == PC_START + 2 &&
+           cpu.getCPUState().serviced_interrupts == 0;
+}
+
+bool TestInterrupts::testRETI() {
+    // EI, NOP, NOP
+    auto emulator = emulatorWith({ 0xFB, 0x00, 0x00 });
+    Processor &cpu = *emulator->processor;
+    cpu.program_memory->setData(0x50, 0xD9);
+    step(*emulator);
+    request(*emulator, INTERRUPT_TIMER, INTERRUPT_TIMER);
+
+    // NOP and dispatch, then RETI back to the second NOP
+    step(*emulator, 2);
+    CPUState state = cpu.getCPUState();
+    return state.PC == PC_START + 2 && state.SP == SP_START &&
+           state.interrupts_enabled;
+}
+
+void TestInterrupts::runAllTests() {
+    TestUtils::runTestNoArg(testEIDelayed, "TestInterrupts::testEIDelayed");
+    TestUtils::runTestNoArg(testDICancelsEI,
+                            "TestInterrupts::testDICancelsEI");
+    TestUtils::runTestNoArg(testDispatch, "TestInterrupts::testDispatch");
+    TestUtils::runTestNoArg(testDispatchPriority,
+                            "TestInterrupts::testDispatchPriority");
+    TestUtils::runTestNoArg(testNoDispatchWithIMEOff,
+                            "TestInterrupts::testNoDispatchWithIMEOff");
+    TestUtils::runTestNoArg(testHaltWakesWithIMEOff,
+                            "TestInterrupts::testHaltWakesWithIMEOff");
+    TestUtils::runTestNoArg(testRETI, "TestInterrupts::testRETI");
+}
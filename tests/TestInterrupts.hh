@@ -0,0 +1,21 @@
+#pragma once
+#include <vector>
+#include "Emulator.hh"
+#include "TestUtils.hh"
+
+namespace TestInterrupts {
+void runAllTests();
+
+/**
+ *  Loads program at PC_START into a fresh emulator.
+ */
+ptr<Emulator> emulatorWith(const std::vector<byte_t> &program);
+
+bool testEIDelayed();
+bool testDICancelsEI();
+bool testDispatch();
+bool testDispatchPriority();
+bool testNoDispatchWithIMEOff();
+bool testHaltWakesWithIMEOff();
+bool testRETI();
+}  // namespace TestInterrupts
@@ -0,0 +1,131 @@
+#include <vector>
+#include "Memory.hh"
+#include "Processor.hh"
+#include "TestInterrupts.hh"
+#include "TestMemory.hh"
+
+namespace {
+
+/**
+ *  An emulator pushing to the stack and filling WRAM over and over with
+ *  an incrementing A, so every frame writes to most pages.
+ */
+ptr<Emulator> fillingEmulator() {
+    // PUSH AF; POP AF; LD HL,0xC000
+    // loop: LD (HL+),A; INC A; BIT 5,H; JR NZ,done; JP loop
+    // done: JP 0x100
+    return TestInterrupts::emulatorWith({ 0xF5, 0xF1, 0x21, 0x00, 0xC0,
+                                          0x22, 0x3C, 0xCB, 0x6C, 0x20, 0x03,
+                                          0xC3, 0x05, 0x01, 0xC3, 0x00, 0x01 });
+}
+
+bool hashesMatch(const Emulator &emulator) {
+    const Memory &memory = *emulator.processor->program_memory;
+    const Memory &stack = *emulator.processor->stack;
+    return memory.isHashing() && stack.isHashing() &&
+           memory.contentHash() == memory.fullHash() &&
+           stack.contentHash() == stack.fullHash();
+}
+
+}  // namespace
+
+bool TestMemory::testIncrementalHash() {
+    auto emulator = fillingEmulator();
+    emulator->setFingerprinting(true);
+    emulator->runFrame();
+    emulator->runFrame();
+    bool ok = hashesMatch(*emulator);
+
+    // Both sides of a clone write to shared pages, copying them
+    auto clone = emulator->clone();
+    emulator->runFrame();
+    clone->runFrame();
+    clone->runFrame();
+    ok = ok && hashesMatch(*emulator) && hashesMatch(*clone);
+
+    // Loading a state rewrites memory behind the hash
+    std::vector<byte_t> state(clone->stateSize());
+    clone->saveState(state.data(), state.size());
+    uint64_t saved = clone->fingerprint();
+    clone->runFrame();
+    clone->loadState(state.data(), state.size());
+    emulator->loadState(state.data(), state.size());
+    ok = ok && hashesMatch(*emulator) && hashesMatch(*clone) &&
+         clone->fingerprint() == saved && emulator->fingerprint() == saved;
+
+    // Without fingerprinting memory is hashed in full, to the same result
+    emulator->setFingerprinting(false);
+    return ok && emulator->fingerprint() == saved;
+}
+
+bool TestMemory::testCloneCopyOnWrite() {
+    auto emulator = fillingEmulator();
+    emulator->setFingerprinting(true);
+    emulator->runFrame();
+    Memory &memory = *emulator->processor->program_memory;
+    const byte_t *written = memory.pageData(0xC0);
+    const byte_t *untouched = memory.pageData(0xC1);
+    byte_t value = memory.peek(0xC000);
+    byte_t ours = value + 1, theirs = value + 2;
+    uint64_t fingerprint = emulator->fingerprint();
+
+    bool ok;
+    {
+        auto clone = emulator->clone();
+        Memory &copy = *clone->processor->program_memory;
+        ok = copy.pageData(0xC0) == written &&
+             clone->fingerprint() == fingerprint;
+
+        // Sharing took the page out of the source's write table, so this
+        // copies it rather than writing through to the clone
+        memory.setData(0xC000, ours);
+        ok = ok && memory.pageData(0xC0) != written &&
+             copy.peek(0xC000) == value &&
+             clone->fingerprint() == fingerprint;
+
+        copy.setData(0xC000, theirs);
+        clone->processor->stack->setData(0xFFF0, 0x55);
+        ok = ok && copy.pageData(0xC0) == written &&
+             memory.peek(0xC000) == ours &&
+             emulator->processor->stack->peek(0xFFF0) != 0x55 &&
+             emulator->fingerprint() != fingerprint &&
+             clone->fingerprint() != fingerprint &&
+             clone->fingerprint() != emulator->fingerprint() &&
+             hashesMatch(*emulator) && hashesMatch(*clone);
+    }
+
+    // With the clone gone the page is only the source's again, and written
+    // in place
+    memory.setData(0xC100, memory.peek(0xC100) + 1);
+    ok = ok && memory.pageData(0xC1) == untouched;
+    memory.setData(0xC100, memory.peek(0xC100) - 1);
+    memory.setData(0xC000, value);
+    return ok && emulator->fingerprint() == fingerprint &&
+           hashesMatch(*emulator);
+}
+
+bool TestMemory::testFingerprintIgnoresCounters() {
+    auto emulator = fillingEmulator();
+    emulator->runFrame();
+    uint64_t fingerprint = emulator->fingerprint();
+
+    CPUState state = emulator->processor->getCPUState();
+    state.machine_cycles += 100;
+    state.executed_instructions += 10;
+    state.serviced_interrupts += 1;
+    emulator->processor->setCPUState(state);
+    bool ok = emulator->fingerprint() == fingerprint;
+
+    state.A ^= 1;
+    emulator->processor->setCPUState(state);
+    return ok && emulator->fingerprint() != fingerprint;
+}
+
+void TestMemory::runAllTests() {
+    TestUtils::runTestNoArg(testIncrementalHash,
+                            "TestMemory::testIncrementalHash");
+    TestUtils::runTestNoArg(testCloneCopyOnWrite,
+                            "TestMemory::testCloneCopyOnWrite");
+    TestUtils::runTestNoArg(testFingerprintIgnoresCounters,
+                            "TestMemory::testFingerprintIgnoresCounters");
+}
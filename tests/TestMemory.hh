@@ -0,0 +1,10 @@
+#pragma once
+#include "Emulator.hh"
+#include "TestUtils.hh"
+
+namespace TestMemory {
+void runAllTests();
+bool testIncrementalHash();
+bool testCloneCopyOnWrite();
+bool testFingerprintIgnoresCounters();
+}  // namespace TestMemory
@@ -0,0 +1,92 @@
+#include <algorithm>
+#include <random>
+#include "TestRewindBuffer.hh"
+
+namespace {
+
+using State = std::vector<byte_t>;
+
+/**
+ *  States like a running game makes: each one the last with a few bytes
+ *  and runs changed, now and then growing or shrinking, and sometimes
+ *  entirely new.
+ */
+std::vector<State> makeStates(unsigned count, std::mt19937 &random) {
+    std::vector<State> states { State(4096) };
+    for (byte_t &byte : states.back()) byte = random();
+
+    while (states.size() < count) {
+        State state = states.back();
+        switch (random() % 4) {
+            case 0:
+                // Smaller, so the pushed state gets padded
+                if (state.size() > 1024) {
+                    state.resize(state.size() - 1 - random() % 512);
+                }
+                break;
+            case 1:
+                state.resize(state.size() + 1 + random() % 512, 0xA5);
+                break;
+            case 2:
+                for (byte_t &byte : state) byte = random();
+                break;
+            default:
+                break;
+        }
+
+        for (unsigned i = random() % 32; i > 0; --i) {
+            size_t at = random() % state.size();
+            size_t run = std::min<size_t>(1 + random() % 64, state.size() - at);
+            for (size_t j = at; j < at + run; ++j) state[j] ^= random() | 1;
+        }
+        states.push_back(std::move(state));
+    }
+    return states;
+}
+
+bool newestIs(const RewindBuffer &buffer, const State &state) {
+    return buffer.newestSize() == state.size() &&
+           std::equal(state.begin(), state.end(), buffer.newestState());
+}
+
+}  // namespace
+
+bool TestRewindBuffer::testRoundTrip() {
+    std::mt19937 random { 3 };
+    std::vector<State> states = makeStates(100, random);
+
+    // Room for all of them
+    RewindBuffer buffer { 1, 2 };
+    for (const State &state : states) {
+        buffer.push(state.data(), state.size());
+        if (!newestIs(buffer, state)) return false;
+    }
+    if (buffer.snapshotCount() != states.size()) return false;
+
+    for (size_t i = states.size() - 1; i > 0; --i) {
+        if (!buffer.rewind() || !newestIs(buffer, states[i - 1])) {
+            return false;
+        }
+    }
+    return !buffer.rewind() && newestIs(buffer, states.front());
+}
+
+bool TestRewindBuffer::testDropsOldest() {
+    std::mt19937 random { 4 };
+    std::vector<State> states = makeStates(100, random);
+
+    // One second of snapshots every frame
+    RewindBuffer buffer { 1, 1 };
+    for (const State &state : states) buffer.push(state.data(), state.size());
+    if (buffer.snapshotCount() != 60) return false;
+
+    while (buffer.rewind()) {
+    }
+    return newestIs(buffer, states[states.size() - 60]);
+}
+
+void TestRewindBuffer::runAllTests() {
+    TestUtils::runTestNoArg(testRoundTrip, "TestRewindBuffer::testRoundTrip");
+    TestUtils::runTestNoArg(testDropsOldest,
+                            "TestRewindBuffer::testDropsOldest");
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include "RewindBuffer.hh"
+#include "TestUtils.hh"
+
+namespace TestRewindBuffer {
+void runAllTests();
+bool testRoundTrip();
+bool testDropsOldest();
+}  // namespace TestRewindBuffer
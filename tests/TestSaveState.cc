@@ -0,0 +1,103 @@
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include "Emulator.hh"
+#include "TestInterrupts.hh"
+#include "TestSaveState.hh"
+
+namespace {
+
+/**
+ *  An emulator changing memory, stack and registers every step.
+ */
+ptr<Emulator> countingEmulator() {
+    // PUSH AF; POP AF; LD (0xC000),A; INC A; JP 0x100
+    return TestInterrupts::emulatorWith(
+        { 0xF5, 0xF1, 0xEA, 0x00, 0xC0, 0x3C, 0xC3, 0x00, 0x01 });
+}
+
+std::vector<byte_t> saved(const Emulator &emulator) {
+    std::vector<byte_t> state(emulator.stateSize());
+    state.resize(emulator.saveState(state.data(), state.size()));
+    return state;
+}
+
+bool loads(Emulator &emulator, const std::vector<byte_t> &state) {
+    try {
+        emulator.loadState(state.data(), state.size());
+    } catch (const std::runtime_error &) {
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+bool TestSaveState::testRoundTrip() {
+    auto emulator = countingEmulator();
+    emulator->runFrame();
+    std::vector<byte_t> state = saved(*emulator);
+    uint64_t hash = emulator->stateHash();
+    framebuffer_t picture = emulator->getFramebuffer();
+
+    emulator->runFrame();
+    emulator->runFrame();
+    uint64_t later = emulator->stateHash();
+    if (later == hash) return false;
+
+    // Loading goes back exactly, and runs on to the same place again
+    bool ok = loads(*emulator, state) && emulator->stateHash() == hash &&
+              emulator->getFramebuffer() == picture;
+    emulator->runFrame();
+    emulator->runFrame();
+    ok = ok && emulator->stateHash() == later;
+
+    // Also into an emulator that has never run
+    auto other = countingEmulator();
+    return ok && loads(*other, state) && other->stateHash() == hash;
+}
+
+bool TestSaveState::testRejectsTruncated() {
+    auto emulator = countingEmulator();
+    emulator->runFrame();
+    std::vector<byte_t> state = saved(*emulator);
+
+    auto target = countingEmulator();
+    uint64_t hash = target->stateHash();
+
+    // Cut in the header, in a chunk header and in a payload
+    for (size_t size : { size_t(0), size_t(5), size_t(16), state.size() / 2,
+                         state.size() - 1 }) {
+        std::vector<byte_t> cut(state.begin(), state.begin() + size);
+        if (loads(*target, cut) || target->stateHash() != hash) return false;
+    }
+    return true;
+}
+
+bool TestSaveState::testSkipsUnknownChunks() {
+    auto emulator = countingEmulator();
+    emulator->runFrame();
+    std::vector<byte_t> state = saved(*emulator);
+    uint64_t hash = emulator->stateHash();
+
+    // A chunk from some later version, right after the header
+    const char tag[4] = { 'N', 'E', 'W', ' ' };
+    uint32_t size = 5;
+    std::vector<byte_t> chunk(sizeof(tag) + sizeof(size) + size, 0xA5);
+    std::memcpy(chunk.data(), tag, sizeof(tag));
+    std::memcpy(chunk.data() + sizeof(tag), &size, sizeof(size));
+
+    size_t header = sizeof(SaveState::MAGIC) + sizeof(uint32_t);
+    state.insert(state.begin() + header, chunk.begin(), chunk.end());
+
+    auto other = countingEmulator();
+    return loads(*other, state) && other->stateHash() == hash;
+}
+
+void TestSaveState::runAllTests() {
+    TestUtils::runTestNoArg(testRoundTrip, "TestSaveState::testRoundTrip");
+    TestUtils::runTestNoArg(testRejectsTruncated,
+                            "TestSaveState::testRejectsTruncated");
+    TestUtils::runTestNoArg(testSkipsUnknownChunks,
+                            "TestSaveState::testSkipsUnknownChunks");
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include "SaveState.hh"
+#include "TestUtils.hh"
+
+namespace TestSaveState {
+void runAllTests();
+bool testRoundTrip();
+bool testRejectsTruncated();
+bool testSkipsUnknownChunks();
+}  // namespace TestSaveState
@@ -0,0 +1,27 @@
+#include "TestBatchEmulator.hh"
+#include "TestBreakCondition.hh"
+#include "TestCApi.hh"
+#include "TestDebugger.hh"
+#include "TestEmulatorThread.hh"
+#include "TestInterrupts.hh"
+#include "TestMemory.hh"
+#include "TestRewindBuffer.hh"
+#include "TestSaveState.hh"
+#include "TestUtils.hh"
+
+// The tests of the emulator core, built as core-tests and run by ctest. The
+// older suites in test_main.cc predate the current Processor interface.
+int main() {
+    TestInterrupts::runAllTests();
+    TestEmulatorThread::runAllTests();
+    TestDebugger::runAllTests();
+    TestBatchEmulator::runAllTests();
+    TestBreakCondition::runAllTests();
+    TestRewindBuffer::runAllTests();
+    TestMemory::runAllTests();
+    TestSaveState::runAllTests();
+    TestCApi::runAllTests();
+
+    TestUtils::printResults();
+    return TestUtils::failed_tests == 0 ? 0 : 1;
+}
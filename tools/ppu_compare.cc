@@ -0,0 +1,92 @@
+/*
+    Runs ROMs with both PPU backends side by side and reports, per ROM, the
+    frames where the framebuffer hashes diverge.
+
+    Usage: ppu-compare --roms a.gb b.gb [--frames 600]
+*/
+
+// System headers
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// User headers
+#include "Emulator.hh"
+#include "Utility.hh"
+
+// Lib headers
+#include "argparse.h"
+
+struct ComparisonResult {
+    unsigned frames_run { 0 };
+    unsigned diverged_frames { 0 };
+    long first_divergence { -1 };
+    std::string error {};
+};
+
+ComparisonResult compareROM(const std::string &filename, unsigned frames) {
+    ComparisonResult result {};
+
+    Emulator fast {};
+    Emulator fifo {};
+    fifo.setPPUAccuracy(PPUAccuracy::Fifo);
+
+    fast.loadROM(filename);
+    fifo.loadROM(filename);
+
+    try {
+        for (unsigned frame = 0; frame < frames; ++frame) {
+            fast.runFrame();
+            fifo.runFrame();
+            result.frames_run++;
+
+            if (fast.frameHash() != fifo.frameHash()) {
+                result.diverged_frames++;
+                if (result.first_divergence < 0)
+                    result.first_divergence = frame;
+            }
+        }
+    } catch (const std::exception &ex) {
+        result.error = ex.what();
+    }
+
+    return result;
+}
+
+int main(int argc, char **argv) {
+    ArgumentParser parser("Compares frame hashes of the fast and FIFO PPU");
+    parser.add_argument("--roms", "ROM files to compare", true);
+    parser.add_argument("--frames", "Number of frames to run (default 600)");
+
+    try {
+        parser.parse(argc, argv);
+    } catch (const ArgumentParser::ArgumentNotFound &ex) {
+        std::cerr << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (parser.is_help()) return EXIT_SUCCESS;
+
+    unsigned frames = 600;
+    if (parser.exists("frames")) frames = parser.get<unsigned>("frames");
+
+    bool any_divergence = false;
+
+    for (const std::string &rom : parser.getv<std::string>("roms")) {
+        ComparisonResult result = compareROM(rom, frames);
+
+        std::cout << rom << ": " << result.diverged_frames << "/"
+                  << result.frames_run << " frames diverged";
+        if (result.first_divergence >= 0)
+            std::cout << " (first at frame " << result.first_divergence << ")";
+        if (!result.error.empty())
+            std::cout << ", stopped: " << result.error;
+        std::cout << std::endl;
+
+        if (result.diverged_frames > 0) any_divergence = true;
+    }
+
+    return any_divergence ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,126 @@
+/*
+    Prints a binary trace recorded with --trace in the same format as the
+    verbose instruction decoder (Processor::dump), one block per instruction,
+    or as one line per instruction in the common reference log format.
+
+    Usage: trace-decode --trace session.gbtrace [--count N] [--format line]
+*/
+
+// System headers
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+// User headers
+#include "TraceRecorder.hh"
+#include "opcode_names.hh"
+
+// Lib headers
+#include "argparse.h"
+
+static void printHex(const char *name, unsigned value, unsigned length) {
+    std::cout << name << ": 0x" << std::setfill('0') << std::setw(length)
+              << std::uppercase << std::hex << value << std::dec;
+}
+
+static void printRecord(const TraceRecord &record, uint64_t index) {
+    unsigned a = record.af >> 8, f = record.af & 0xFF;
+    unsigned b = record.bc >> 8, c = record.bc & 0xFF;
+    unsigned d = record.de >> 8, e = record.de & 0xFF;
+    unsigned h = record.hl >> 8, l = record.hl & 0xFF;
+
+    std::cout << "Printing processor" << std::endl;
+    std::cout << std::setfill('-') << std::setw(40) << "-" << std::endl;
+
+    std::cout << "\t";
+    printHex("A", a, 2);
+    std::cout << "\t\t";
+    printHex("B", b, 2);
+    std::cout << std::endl << "\t";
+    printHex("D", d, 2);
+    std::cout << "\t\t";
+    printHex("C", c, 2);
+    std::cout << std::endl << "\t";
+    printHex("E", e, 2);
+    std::cout << "\t\t";
+    printHex("F", f, 2);
+    std::cout << std::endl << "\t";
+    printHex("H", h, 2);
+    std::cout << "\t\t";
+    printHex("L", l, 2);
+    std::cout << std::endl;
+
+    std::cout << "\t";
+    printHex("AF", record.af, 4);
+    std::cout << "\t";
+    printHex("BC", record.bc, 4);
+    std::cout << std::endl << "\t";
+    printHex("DE", record.de, 4);
+    std::cout << "\t";
+    printHex("HL", record.hl, 4);
+    std::cout << std::endl << "\t";
+    printHex("SP", record.sp, 4);
+    std::cout << "\t";
+    printHex("PC", record.pc, 4);
+    std::cout << std::endl;
+
+    std::cout << "\tC: " << ((f & bit_c) != 0);
+    std::cout << "\tH: " << ((f & bit_h) != 0) << std::endl;
+    std::cout << "\tN: " << ((f & bit_n) != 0);
+    std::cout << "\tZ: " << ((f & bit_z) != 0) << std::endl;
+
+    std::cout << "\tOpcode: " << opcode_names[record.pcmem[0]] << std::endl;
+    std::cout << "\tCPU cycles: " << record.cycle << std::endl;
+    std::cout << "\tMachine cycles: " << record.cycle / 4 << std::endl;
+    std::cout << "\tExecuted instructions: " << index << std::endl;
+    std::cout << std::setfill('-') << std::setw(40) << "-" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    ArgumentParser parser("Prints a binary instruction trace");
+    parser.add_argument("--trace", "Trace file to print", true);
+    parser.add_argument("--count", "Stop after this many instructions");
+    parser.add_argument("--format", "dump (default) or line");
+
+    try {
+        parser.parse(argc, argv);
+    } catch (const ArgumentParser::ArgumentNotFound &ex) {
+        std::cerr << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (parser.is_help()) return EXIT_SUCCESS;
+
+    uint64_t count = UINT64_MAX;
+    if (parser.exists("count")) count = parser.get<uint64_t>("count");
+
+    std::string format { parser.get<std::string>("format") };
+    bool lines = format == "line";
+    if (!lines && !format.empty() && format != "dump") {
+        std::cerr << "Unknown format: " << format << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    try {
+        TraceReader reader { parser.get<std::string>("trace") };
+
+        TraceRecord record {};
+        for (uint64_t index = 0; index < count && reader.next(record);
+             ++index) {
+            if (lines) {
+                char line[TRACE_LINE_SIZE];
+                size_t length = formatTraceLine(record, line);
+                line[length] = '\n';
+                std::cout.write(line, length + 1);
+            } else {
+                printRecord(record, index);
+            }
+        }
+    } catch (const std::exception &ex) {
+        std::cerr << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,358 @@
+/*
+    Streams two instruction traces side by side and stops at the first
+    instruction where they differ, printing the instructions leading up to
+    it. Each trace is either a binary trace recorded with --trace, or a text
+    log with one line per instruction in the common reference format:
+
+        A:01 F:B0 B:00 C:13 D:00 E:D8 H:01 L:4D SP:FFFE PC:0100 PCMEM:00,C3,..
+
+    Both are memory mapped and decoded in place, and text logs are split
+    into lines with SIMD, so multi GB traces stream at disk speed.
+
+    Usage: trace-diff --trace ours.gbtrace --reference reference.log
+                      [--context 10]
+*/
+
+// System headers
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// User headers
+#include "TraceRecorder.hh"
+
+// Lib headers
+#include "argparse.h"
+
+/**
+ *  Read only memory mapping of a whole file.
+ */
+class MappedFile {
+   public:
+    explicit MappedFile(const std::string &filename) {
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("Could not open " + filename);
+
+        struct stat info {};
+        fstat(fd, &info);
+        size = info.st_size;
+
+        if (size > 0) {
+            void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error("Could not map " + filename);
+            }
+            data = static_cast<const char *>(mapped);
+            madvise(mapped, size, MADV_SEQUENTIAL);
+        }
+        close(fd);
+    }
+
+    ~MappedFile() {
+        if (data) munmap(const_cast<char *>(data), size);
+    }
+
+    // Weffc++
+    MappedFile(const MappedFile &) = delete;
+    void operator=(const MappedFile &) = delete;
+
+    const char *begin() const { return data; }
+    const char *end() const { return data + size; }
+
+   private:
+    const char *data { nullptr };
+    size_t size { 0 };
+};
+
+/**
+ *  Returns the first newline in [p, end), or end.
+ */
+static const char *findNewline(const char *p, const char *end) {
+#ifdef __SSE2__
+    const __m128i newline = _mm_set1_epi8('\n');
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+        if (mask) return p + __builtin_ctz(mask);
+        p += 16;
+    }
+#endif
+    const void *found = std::memchr(p, '\n', end - p);
+    return found ? static_cast<const char *>(found) : end;
+}
+
+static int hexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+/**
+ *  One of the traces being compared.
+ */
+class TraceSource {
+   public:
+    virtual ~TraceSource() = default;
+
+    /**
+     *  Reads the next instruction. Returns false at the end of the trace.
+     */
+    virtual bool next(TraceRecord &record) = 0;
+};
+
+class BinaryTraceSource : public TraceSource {
+   public:
+    BinaryTraceSource(std::unique_ptr<MappedFile> mapped,
+                      const std::string &filename)
+        : file { std::move(mapped) },
+          position { reinterpret_cast<const byte_t *>(file->begin()) },
+          end { reinterpret_cast<const byte_t *>(file->end()) } {
+        checkTraceHeader(position, end - position, filename);
+        position += TraceRecorder::HEADER_SIZE;
+    }
+
+    // Weffc++
+    BinaryTraceSource(const BinaryTraceSource &) = delete;
+    void operator=(const BinaryTraceSource &) = delete;
+
+    bool next(TraceRecord &record) override {
+        if (position == end) return false;
+        position = decoder.decode(position, end, record);
+        return true;
+    }
+
+   private:
+    std::unique_ptr<MappedFile> file;
+    const byte_t *position;
+    const byte_t *end;
+    TraceDecoder decoder {};
+};
+
+class TextTraceSource : public TraceSource {
+   public:
+    explicit TextTraceSource(std::unique_ptr<MappedFile> mapped)
+        : file { std::move(mapped) }, position { file->begin() } {}
+
+    // Weffc++
+    TextTraceSource(const TextTraceSource &) = delete;
+    void operator=(const TextTraceSource &) = delete;
+
+    bool next(TraceRecord &record) override {
+        while (position < file->end()) {
+            const char *line_end = findNewline(position, file->end());
+            const char *line = position;
+            position = line_end + 1;
+
+            record = {};
+            if (parseLine(line, line_end, record)) return true;
+        }
+
+        return false;
+    }
+
+   private:
+    std::unique_ptr<MappedFile> file;
+    const char *position;
+
+    /**
+     *  Parses NAME:VALUE fields separated by spaces. Returns false for lines
+     *  without a PC field (blank lines, comments, ...).
+     */
+    bool parseLine(const char *p, const char *end, TraceRecord &record) {
+        bool has_pc = false;
+
+        while (p < end) {
+            while (p < end && (*p == ' ' || *p == '\r' || *p == '\t')) ++p;
+
+            const char *name = p;
+            while (p < end && *p != ':' && *p != ' ') ++p;
+            size_t name_length = p - name;
+            if (p >= end || *p != ':') continue;
+            ++p;
+
+            // Values are hex, PCMEM has several separated by commas
+            unsigned values[4] = {};
+            int count = 0;
+            while (p < end && count < 4) {
+                unsigned value = 0;
+                int digit;
+                while (p < end && (digit = hexDigit(*p)) >= 0) {
+                    value = value * 16 + digit;
+                    ++p;
+                }
+                values[count++] = value;
+                if (p < end && *p == ',') {
+                    ++p;
+                } else {
+                    break;
+                }
+            }
+
+            auto is = [name, name_length](const char *field) {
+                return std::strlen(field) == name_length &&
+                       std::memcmp(name, field, name_length) == 0;
+            };
+
+            if (name_length == 1) {
+                // Single register, high or low byte of a pair
+                uint16_t *pair = nullptr;
+                bool high = false;
+                switch (*name) {
+                    case 'A': pair = &record.af; high = true; break;
+                    case 'F': pair = &record.af; break;
+                    case 'B': pair = &record.bc; high = true; break;
+                    case 'C': pair = &record.bc; break;
+                    case 'D': pair = &record.de; high = true; break;
+                    case 'E': pair = &record.de; break;
+                    case 'H': pair = &record.hl; high = true; break;
+                    case 'L': pair = &record.hl; break;
+                }
+                if (pair && high) {
+                    *pair = (*pair & 0x00FF) | (values[0] & 0xFF) << 8;
+                } else if (pair) {
+                    *pair = (*pair & 0xFF00) | (values[0] & 0xFF);
+                }
+            } else if (is("SP")) {
+                record.sp = values[0];
+            } else if (is("PC")) {
+                record.pc = values[0];
+                has_pc = true;
+            } else if (is("PCMEM")) {
+                for (int i = 0; i < count; ++i) record.pcmem[i] = values[i];
+            }
+
+            // Skip whatever is left of an unknown or malformed value
+            while (p < end && *p != ' ') ++p;
+        }
+
+        return has_pc;
+    }
+};
+
+static std::unique_ptr<TraceSource> openTrace(const std::string &filename) {
+    auto file = std::make_unique<MappedFile>(filename);
+    size_t magic_size = sizeof(TraceRecorder::MAGIC);
+
+    if (file->end() - file->begin() >= (long)magic_size &&
+        std::memcmp(file->begin(), TraceRecorder::MAGIC, magic_size) == 0) {
+        return std::make_unique<BinaryTraceSource>(std::move(file), filename);
+    }
+    return std::make_unique<TextTraceSource>(std::move(file));
+}
+
+/**
+ *  Names of the fields that differ, empty if the instructions match. The
+ *  lower nibble of F doesn't exist on hardware, so it's not compared.
+ */
+static std::string differences(const TraceRecord &a, const TraceRecord &b) {
+    std::string names {};
+    auto check = [&names](bool differs, const char *name) {
+        if (!differs) return;
+        if (!names.empty()) names += ' ';
+        names += name;
+    };
+
+    check((a.af ^ b.af) & 0xFF00, "A");
+    check((a.af ^ b.af) & 0x00F0, "F");
+    check((a.bc ^ b.bc) & 0xFF00, "B");
+    check((a.bc ^ b.bc) & 0x00FF, "C");
+    check((a.de ^ b.de) & 0xFF00, "D");
+    check((a.de ^ b.de) & 0x00FF, "E");
+    check((a.hl ^ b.hl) & 0xFF00, "H");
+    check((a.hl ^ b.hl) & 0x00FF, "L");
+    check(a.sp != b.sp, "SP");
+    check(a.pc != b.pc, "PC");
+    check(std::memcmp(a.pcmem, b.pcmem, sizeof(a.pcmem)) != 0, "PCMEM");
+
+    return names;
+}
+
+static void printLine(const char *label, const TraceRecord &record) {
+    char line[TRACE_LINE_SIZE];
+    formatTraceLine(record, line);
+    std::cout << label << line << std::endl;
+}
+
+int main(int argc, char **argv) {
+    ArgumentParser parser("Finds the first difference between two traces");
+    parser.add_argument("--trace", "Trace to check", true);
+    parser.add_argument("--reference", "Trace or log to compare against",
+                        true);
+    parser.add_argument("--context",
+                        "Matching instructions shown before the difference");
+
+    try {
+        parser.parse(argc, argv);
+    } catch (const ArgumentParser::ArgumentNotFound &ex) {
+        std::cerr << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (parser.is_help()) return EXIT_SUCCESS;
+
+    size_t context = 10;
+    if (parser.exists("context")) context = parser.get<size_t>("context");
+
+    try {
+        std::unique_ptr<TraceSource> ours =
+            openTrace(parser.get<std::string>("trace"));
+        std::unique_ptr<TraceSource> reference =
+            openTrace(parser.get<std::string>("reference"));
+
+        // Last matching instructions, as a ring
+        std::vector<TraceRecord> history(context);
+        uint64_t index = 0;
+
+        TraceRecord a {}, b {};
+        for (;; ++index) {
+            bool has_ours = ours->next(a);
+            bool has_reference = reference->next(b);
+
+            if (!has_ours && !has_reference) {
+                std::cout << "Traces match (" << index << " instructions)"
+                          << std::endl;
+                return EXIT_SUCCESS;
+            }
+
+            if (!has_ours || !has_reference) {
+                std::cout << (has_ours ? "Reference" : "Trace")
+                          << " ends after " << index << " instructions"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            std::string differing = differences(a, b);
+            if (!differing.empty()) break;
+
+            if (context > 0) history[index % context] = a;
+        }
+
+        std::cout << "Traces differ at instruction " << index << " ("
+                  << differences(a, b) << ")" << std::endl;
+
+        uint64_t shown = std::min<uint64_t>(context, index);
+        for (uint64_t i = index - shown; i < index; ++i) {
+            printLine("            ", history[i % context]);
+        }
+        printLine("trace:      ", a);
+        printLine("reference:  ", b);
+    } catch (const std::exception &ex) {
+        std::cerr << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_FAILURE;
+}